@@ -29,6 +29,8 @@
 
 // Revision history:
 // 1.0 initial release MDG 2013/4/1
+// 1.1 playable files are recognized by their content rather than
+//     their extension
 
 
 // We'll need a few libraries to access all this hardware!
@@ -69,6 +71,7 @@ SFEMP3Shield MP3player;
 SdFat sd;
 SdFile file;
 char track[13];
+audio_format_m track_format; // Format of track, as found from its content
 
 // If you would like debugging information sent to the
 // serial port, set debugging = true. This will require
@@ -241,7 +244,7 @@ void errorBlink(int blinks)
 
 void getNextTrack()
 {
-  // Get the next playable track (check extension to be
+  // Get the next playable track (check the content to be
   // sure it's an audio file)
   
   do
@@ -266,33 +269,27 @@ void getNextFile()
     return;
   }
   file.getFilename(track);  
+
+  // Only look inside files, directories are never playable:
+
+  if (file.isFile())
+    sniffFormat(&file, &track_format);
+  else
+    track_format.format = fmt_unknown;
   file.close();
 }
 
 
 boolean isPlayable()
 {
-  // Check to see if a filename has a "playable" extension.
+  // Check to see if the track's content is a "playable" format.
   // This is to keep the VS1053 from locking up if it is sent
-  // unplayable data.
+  // unplayable data. The library's sniffFormat() looked at the
+  // first bytes of the file, for the marks each format starts
+  // with, as it was found. (Directories and other files are
+  // fmt_unknown.)
 
-  char *extension;
-  
-  extension = strrchr(track,'.');
-  extension++;
-  if (
-    (strcasecmp(extension,"MP3") == 0) ||
-    (strcasecmp(extension,"WAV") == 0) ||
-    (strcasecmp(extension,"MID") == 0) ||
-    (strcasecmp(extension,"MP4") == 0) ||
-    (strcasecmp(extension,"WMA") == 0) ||
-    (strcasecmp(extension,"FLA") == 0) ||
-    (strcasecmp(extension,"OGG") == 0) ||
-    (strcasecmp(extension,"AAC") == 0)
-  )
-    return true;
-  else
-    return false;
+  return (track_format.format != fmt_unknown);
 }
 
 
@@ -307,7 +304,7 @@ void startPlaying()
     Serial.print(F("..."));
   }  
 
-  result = MP3player.playMP3(track);
+  result = MP3player.playMP3(track, 0, &track_format);
 
   if (debugging)
   {
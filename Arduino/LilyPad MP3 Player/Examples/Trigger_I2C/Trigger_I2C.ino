@@ -31,6 +31,22 @@
 // are normally open (not grounded) and remain ungrounded while the
 // serial port is in use.
 
+// Each trigger can have its own amplifier settings, so a loud
+// effect and quiet narration can share the card without editing
+// their levels. Put a text file named AMP.TXT in the root of the
+// card, with a line for each trigger that needs one:
+
+//   trigger gain limiter compression attack release
+
+// For example "2 24 20 2 1 11". Gain is the fixed gain in dB
+// (-28 to 30), limiter the output limiter level (0-31), compression
+// the AGC compression ratio (0 = AGC off, 1-3 = 2:1, 4:1, 8:1) and
+// attack and release the AGC times (0-63); see the TPA2016D2
+// datasheet for the units. Lines starting with # are ignored.
+// Triggers without a line use default_profile below. The settings
+// are sent to the amplifier in one I2C transaction just before the
+// file starts, so they apply from its first sound.
+
 // Uses the SdFat library by William Greiman, which is supplied
 // with this archive, or download from http://code.google.com/p/sdfatlib/
 
@@ -48,6 +64,8 @@
 
 // Revision history:
 // 1.0 initial release MDG 2012/11/01
+// 1.1 the amplifier is configured with one I2C transaction
+// 1.2 per-trigger amplifier settings from AMP.TXT
 
 
 // We'll need a few libraries to access all this hardware!
@@ -107,6 +125,26 @@ boolean interruptself = false;
 char filename[5][13];
 SFE_TPA2016D2 amp;
 
+// Amplifier settings for a trigger's file (see AMP.TXT above):
+
+struct AmpProfile
+{
+  signed char gain;           // fixed gain, -28 to 30 dB
+  unsigned char limiter;      // output limiter level, 0-31
+  unsigned char compression;  // AGC compression ratio, 0-3 (0 = off)
+  unsigned char attack;       // AGC attack time, 0-63
+  unsigned char release;      // AGC release time, 0-63
+};
+
+// Used by triggers without a line in AMP.TXT: 18dB fixed gain,
+// full power, AGC off:
+
+const AmpProfile default_profile = {18, 31, 0, 1, 1};
+
+// We'll store the five profiles alongside the filenames:
+
+AmpProfile profile[5];
+
 void setup()
 {
   int x, index;
@@ -243,6 +281,10 @@ void setup()
     }
   }
 
+  // Read the optional amplifier settings for each trigger:
+
+  readProfiles();
+
   // Set the VS1053 volume. 0 is loudest, 255 is lowest (off):
 
   MP3player.setVolume(20,20);
@@ -313,10 +355,14 @@ void loop()
           MP3player.stopTrack();
         }
         
-        // Turn on the amplifier
-  
-        ampOn();
-        
+        // Turn on the amplifier and load this file's settings.
+        // (Done just before playMP3(), so it lands before the
+        //  first frame is decoded. If a file is still playing,
+        //  leave its settings alone, the new one won't start.)
+
+        if (!MP3player.isPlaying())
+          ampOn(t-1);
+
         // Play the filename associated with the trigger number.
         // (If a file is already playing, this command will fail
         //  with error #2).
@@ -372,35 +418,137 @@ void errorBlink(int blinks)
 }
 
 
-void ampOn()
+void readProfiles()
+{
+  // Fill profile[] from AMP.TXT in the root directory, if it exists.
+  // Each line is a trigger number and five values (see the top of
+  // this sketch), separated by spaces or commas.
+
+  SdFile file;
+  int value[6];
+  int count, c, x;
+  boolean digits, negative, comment;
+
+  for (x = 0; x <= 4; x++)
+    profile[x] = default_profile;
+
+  if (!file.open("AMP.TXT",O_READ))
+    return;
+  if (debugging) Serial.println(F("reading AMP.TXT"));
+
+  count = 0;
+  digits = false;
+  negative = false;
+  comment = false;
+  do
+  {
+    c = file.read(); // -1 at the end of the file
+
+    if (comment)
+    {
+      // skip to the end of the line
+    }
+    else if (c >= '0' && c <= '9')
+    {
+      if (!digits && count < 6)
+        value[count] = 0;
+      if (count < 6)
+        value[count] = value[count] * 10 + (c - '0');
+      digits = true;
+    }
+    else
+    {
+      // Anything else ends a number
+
+      if (digits)
+      {
+        if (negative && count < 6)
+          value[count] = -value[count];
+        count++;
+      }
+      digits = false;
+      negative = (c == '-');
+      if (c == '#' && count == 0)
+        comment = true;
+    }
+
+    if (c == '\n' || c == -1)
+    {
+      // A whole line: store it if it has a valid trigger
+      // number and all five values.
+
+      if (count == 6 && value[0] >= 1 && value[0] <= 5)
+      {
+        x = value[0] - 1;
+        profile[x].gain = constrain(value[1],-28,30);
+        profile[x].limiter = value[2];
+        profile[x].compression = value[3];
+        profile[x].attack = value[4];
+        profile[x].release = value[5];
+
+        if (debugging)
+        {
+          Serial.print(F("amp settings for trigger "));
+          Serial.println(x+1);
+        }
+      }
+      count = 0;
+      negative = false;
+      comment = false;
+    }
+  }
+  while (c != -1);
+
+  file.close();
+}
+
+
+void ampOn(int index)
 {
-  // Turn the amplifier chip on and configure it.
+  // Turn the amplifier chip on and configure it with the
+  // settings for trigger (index + 1).
   
   byte result;
+  const AmpProfile *p = &profile[index];
  
   if (debugging)
     Serial.println(F("turning amp on"));
   
-  digitalWrite(EN_GPIO1,HIGH);
-  delay(2);
-  
+  // If the amplifier was off, its registers are back to their
+  // defaults. Make the changes below to the library's copy of
+  // the registers, then send only the changed ones, all in one
+  // I2C transaction. (If it was already on and configured,
+  // nothing is sent at all.)
+
+  if (digitalRead(EN_GPIO1) == LOW)
+  {
+    digitalWrite(EN_GPIO1,HIGH);
+    delay(2);
+    amp.resetConfig();
+  }
+  amp.beginConfig();
+
   // Set compression ratio
-  amp.writeCompressionRatio(0); // turn off AGC
+  amp.writeCompressionRatio(p->compression); // 0 turns off AGC
   // Set attack time
-  amp.writeAttack(1); // 1.28 ms
+  amp.writeAttack(p->attack); // 1 = 1.28 ms
   // Set release time
-  amp.writeRelease(1); // 164.4 ms
-  // Set gain
-  amp.writeHold(0); // 164.4 ms
+  amp.writeRelease(p->release); // 1 = 164.4 ms
+  // Set hold time
+  amp.writeHold(0); // off
   // Set fixed gain  
-  amp.writeFixedGain(18); // 18db
+  amp.writeFixedGain(p->gain); // in dB
   // Set max gain
-  amp.writeMaxGain(0); // 18db
-  // Disable limiter
+  amp.writeMaxGain(p->gain > 18 ? p->gain - 18 : 0); // 18db, or up to the fixed gain
+  // Enable limiter
   amp.enableLimiter(); // optional speaker protection
   // Set output limiter
-  amp.writeOutputLimiterLevel(31); // full power, reduce
-  // this if you want speaker protection, see datasheet.
+  amp.writeOutputLimiterLevel(p->limiter); // 31 = full power,
+  // reduce this if you want speaker protection, see datasheet.
+
+  result = amp.applyConfig();
+  if (debugging && !result)
+    Serial.println(F("amp config failed"));
 }
 
 
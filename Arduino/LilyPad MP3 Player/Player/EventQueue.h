@@ -0,0 +1,99 @@
+// EventQueue.h, part of the "Player" example sketch for Lilypad MP3 Player
+
+// A queue of timestamped input events, passed from interrupt
+// request functions (IRQs) to loop().
+
+// Exactly one producer (the IRQs) calls push(), and exactly one
+// consumer (loop()) calls pop(). Each side only writes its own
+// index, and the indexes are single bytes, which the AVR reads and
+// writes in one instruction. So neither side ever needs to turn
+// interrupts off, and no event is torn or lost while the queue has
+// room. When it is full, push() returns false and counts the event
+// in overflows(), so the caller can keep its own tally instead.
+
+// The size must be a power of two, no more than 128, so the free
+// running indexes wrap cleanly and the slot is found with a mask.
+
+#ifndef EventQueue_h
+#define EventQueue_h
+
+#include <Arduino.h>
+
+// One input event. The meaning of type and value is up to the
+// sketch; time is when it happened, in ms from millis().
+
+struct InputEvent
+{
+  unsigned char type;
+  signed char value;
+  unsigned long time;
+};
+
+// Keep the compiler from moving memory accesses across this point,
+// so a slot is completely written before the index publishes it,
+// and completely read before the index releases it.
+
+#define EVENT_QUEUE_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+template <class T, unsigned char N>
+class EventQueue
+{
+  public:
+    EventQueue() : head(0), tail(0), lost(0) {}
+
+    // Add an event, called by the producer only.
+    // Returns false, and the event is dropped, if the queue is full.
+
+    boolean push(const T &event)
+    {
+      unsigned char h = head;
+      if ((unsigned char)(h - tail) >= N)
+      {
+        lost++;
+        return false;
+      }
+      slots[h & (N - 1)] = event;
+      EVENT_QUEUE_BARRIER();
+      head = h + 1;
+      return true;
+    }
+
+    // Take the oldest event, called by the consumer only.
+    // Returns false if the queue is empty.
+
+    boolean pop(T &event)
+    {
+      unsigned char t = tail;
+      if (t == head)
+        return false;
+      event = slots[t & (N - 1)];
+      EVENT_QUEUE_BARRIER();
+      tail = t + 1;
+      return true;
+    }
+
+    // Number of events waiting. Safe from either side, though
+    // the other side may change it right after.
+
+    unsigned char available() { return (unsigned char)(head - tail); }
+
+    // Number of free slots.
+
+    unsigned char room() { return N - available(); }
+
+    // Number of events dropped because the queue was full
+    // (wraps around after 255).
+
+    unsigned char overflows() { return lost; }
+
+  private:
+    // Fails to compile if N is not a power of two up to 128.
+    typedef char size_must_be_power_of_two[((N & (N - 1)) == 0 && N && N <= 128) ? 1 : -1];
+
+    T slots[N];
+    volatile unsigned char head; // written by the producer only
+    volatile unsigned char tail; // written by the consumer only
+    volatile unsigned char lost; // written by the producer only
+};
+
+#endif
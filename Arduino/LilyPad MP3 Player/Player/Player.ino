@@ -29,12 +29,10 @@
 // BASIC OPERATION:
 
 // Place your audio files in the root directory of the SD card.
-// Your files MUST have one of the following extensions: MP3, WAV,
-// MID (MIDI), MP4, WMA, AAC, FLA, OGG. Note that this is solely to
-// prevent the VS1053 from locking up from being fed non-audio data
-// (files without one of the above extensions are quietly skipped).
-// You can rename any playable file to any of the above extensions,
-// or add additional extensions to the isPlayable() function below.
+// Files are recognized by their content, not their extension: MP3,
+// WAV, MIDI, MP4, WMA, AAC, FLAC and OGG files are played, whatever
+// they are named. This is to prevent the VS1053 from locking up from
+// being fed non-audio data (anything else is quietly skipped).
 // See the VS1053 datasheet for the audio file types it can play.
 
 // The player has two modes, TRACK and VOLUME. In TRACK mode, turning
@@ -76,6 +74,14 @@
 
 // Revision history:
 // 1.0 initial release MDG 2013/1/31
+// 1.1 IRQs pass timestamped input events to loop() through a queue,
+//     so no knob step or button press is lost however fast it comes
+// 1.2 table driven quadrature decoding of both encoder channels, with
+//     acceleration so a fast spin skips many tracks
+// 1.3 volume changes glide, and tracks fade in and out, with the
+//     library's volume ramps instead of jumps
+// 1.4 playable files are recognized by their content rather than
+//     their extension, and the format found is kept for playMP3()
 
 // Required libraries:
 
@@ -84,6 +90,8 @@
 #include <SdFatUtil.h>
 #include <SFEMP3Shield.h>
 #include <PinChangeInt.h>
+#include "EventQueue.h"
+#include "RotaryEncoder.h"
 
 // Set debugging to true to get serial messages:
 
@@ -109,6 +117,12 @@ unsigned char rotary_mode = TRACK;
 
 unsigned char volume = 40;
 
+// Milliseconds for the volume to glide to a new setting, so
+// turning the knob doesn't click. The glide needs USE_VOLUME_RAMP
+// set to 1 in SFEMP3ShieldConfig.h, else the volume jumps:
+
+#define VOLUME_GLIDE 40
+
 // Start up *not* playing:
 
 boolean playing = false;
@@ -155,15 +169,29 @@ boolean loop_all = true;
 #define CYAN B001
 #define WHITE B000
 
-// Global variables and flags for interrupt request functions:
+// Input event types passed from the interrupt request functions
+// to loop(). The event's value is the number of knob steps, positive
+// for CW and negative for CCW (more than one when turned quickly),
+// and 1 for a button press and 0 for a release:
+
+#define ROTARY_EVENT 0
+#define BUTTON_EVENT 1
+
+// Knob steps leave this many slots free for the button, so a press
+// or release always has room even while the knob floods the queue:
+
+#define BUTTON_RESERVE 2
 
-volatile int rotary_counter = 0; // Current "position" of rotary encoder (increments CW) 
-volatile boolean rotary_change = false; // Will turn true if rotary_counter has changed
-volatile boolean rotary_direction; // Direction rotary encoder was turned (true = CW)
-volatile boolean button_pressed = false; // Will turn true if the button has been pushed
-volatile boolean button_released = false; // Will turn true if the button has been released (sets button_downtime)
-volatile unsigned long button_downtime = 0L; // ms the button was pushed before release
+// Global variables for interrupt request functions:
+
+EventQueue<InputEvent, 16> input_events; // Events waiting for loop()
+volatile int rotary_lost = 0; // Knob steps that found the queue full, + for CW
+volatile unsigned char button_lost = 0; // Button edges that found the queue full
+volatile unsigned char button_caught = 0; // Of those, how many loop() has handled
+volatile unsigned long button_lost_time[2]; // Time of the last release [0] and press [1] tallied
+RotaryEncoder encoder; // Quadrature decoder for the knob
 char track[13];
+audio_format_m track_format; // Format of track, as found from its content
 
 // Library objects:
 
@@ -258,10 +286,12 @@ void setup()
     if (debugging) Serial.println(F("OK"));
   
   // Set up interrupts. We'll use the standard external interrupt
-  // pin for the rotary, but we'll use the pin change interrupt
-  // library for the button:
+  // pin for rotary channel A, but we'll use the pin change interrupt
+  // library for rotary channel B and the button:
 
+  encoder.begin(ROT_A, ROT_B);
   attachInterrupt(1,rotaryIRQ,CHANGE);
+  PCintPort::attachInterrupt(ROT_B, &rotaryBIRQ, CHANGE);
   PCintPort::attachInterrupt(ROT_SW, &buttonIRQ, CHANGE);
 
   // Get initial track:
@@ -292,6 +322,28 @@ void setup()
 }
 
 
+void queueButton(signed char value, unsigned long time)
+{
+  // Queue a button press (value 1) or release (value 0) for loop().
+
+  // If the queue is full, the edge is tallied in button_lost instead,
+  // and its time kept in button_lost_time. Once one edge is tallied, the
+  // following ones are too, until loop() has caught up, so presses and
+  // releases are still handled in order.
+
+  InputEvent event;
+
+  event.type = BUTTON_EVENT;
+  event.value = value;
+  event.time = time;
+  if ((button_caught != button_lost) || !input_events.push(event))
+  {
+    button_lost_time[value] = time;
+    button_lost++;
+  }
+}
+
+
 void buttonIRQ()
 {
   // Button press interrupt request function (IRQ).
@@ -301,12 +353,9 @@ void buttonIRQ()
   // Process rotary encoder button presses and releases, including
   // debouncing (extra "presses" from noisy switch contacts).
 
-  // If button is pressed, the button_pressed flag is set to true.
-  // (Manually set this to false after handling the change.)
-
-  // If button is released, the button_released flag is set to true,
-  // and button_downtime will contain the duration of the button
-  // press in ms. (Set this to false after handling the change.)
+  // Each press and release is queued as a BUTTON_EVENT with the
+  // time it happened, so loop() can tell how long it was held.
+  // If the queue is full, it's tallied in button_lost instead.
 
   // Raw information from PinChangeInt library:
   
@@ -326,7 +375,7 @@ void buttonIRQ()
     if (start > (end + 10)) // 10ms debounce timer
     {
       button_state = true;
-      button_pressed = true;
+      queueButton(1, start);
     }
   }
   else if ((PCintPort::pinState == LOW) && (button_state == true))
@@ -337,8 +386,7 @@ void buttonIRQ()
     if (end > (start + 10)) // 10ms debounce timer
     {
       button_state = false;
-      button_released = true;
-      button_downtime = end - start;
+      queueButton(0, end);
     }
   }
 }
@@ -346,50 +394,49 @@ void buttonIRQ()
 
 void rotaryIRQ()
 {
-  // Rotary encoder interrupt request function (IRQ).
-  // This function is called *automatically* when the
-  // rotary encoder changes state.
+  // Rotary encoder interrupt request function (IRQ) for channel A.
+  // This function is called *automatically* when input A of the
+  // rotary encoder transitions in either direction (low to high
+  // or high to low).
 
-  // Process input from the rotary encoder.
-  // The rotary "position" is held in rotary_counter, increasing
-  // for CW rotation (changes by one per detent).
-  
-  // If the position changes, rotary_change will be set true.
-  // (You may manually set this to false after handling the change).
+  rotaryEvent(encoder.changeA());
+}
 
-  // This function will automatically run when rotary encoder input A
-  // transitions in either direction (low to high or high to low).
-  // By saving the state of the A and B pins through two interrupts,
-  // we'll determine the direction of rotation.
-  
-  // Int rotary_counter will be updated with the new value, and boolean
-  // rotary_change will be true if there was a value change.
-  
-  // Based on concepts from Oleg at circuits@home (http://www.circuitsathome.com/mcu/rotary-encoder-interrupt-service-routine-for-avr-micros)
-  // Unlike Oleg's original code, this code uses only one interrupt and
-  // has only two transition states; it has less resolution but needs only
-  // one interrupt, is very smooth, and handles switchbounce well.
-  
-  static unsigned char rotary_state = 0; // Current and previous encoder states
-  
-  rotary_state <<= 2;  // Remember previous state
-  rotary_state |= (digitalRead(ROT_A) | (digitalRead(ROT_B) << 1));  // Mask in current state
-  rotary_state &= 0x0F; // Zero upper nybble
 
-  //Serial.println(rotary_state,HEX);
+void rotaryBIRQ()
+{
+  // Rotary encoder interrupt request function (IRQ) for channel B.
+  // This function is called by the pin change interrupt library
+  // when input B transitions, which has already read B's port
+  // for us (PCintPort::curr).
 
-  if (rotary_state == 0x09) // From 10 to 01, increment counter. Also try 0x06 if unreliable.
-  {
-    rotary_counter++;
-    rotary_direction = true;
-    rotary_change = true;
-  }
-  else if (rotary_state == 0x03) // From 00 to 11, decrement counter. Also try 0x0C if unreliable.
-  {
-    rotary_counter--;
-    rotary_direction = false;
-    rotary_change = true;
-  }
+  rotaryEvent(encoder.changeB(PCintPort::curr));
+}
+
+
+void rotaryEvent(signed char steps)
+{
+  // Queue the knob steps decoded by either rotary IRQ.
+
+  // The decoder (see RotaryEncoder.h) watches every edge of both
+  // channels, and returns the number of steps once a whole detent
+  // ("click") has turned, positive for CW rotation and negative for
+  // CCW. When the knob is turned quickly, one detent is worth
+  // several steps.
+
+  // If the queue is too full, the detent's steps are added to
+  // rotary_lost instead, and loop() catches up from those.
+
+  InputEvent event;
+
+  if (steps == 0)
+    return;
+
+  event.type = ROTARY_EVENT;
+  event.value = steps;
+  event.time = millis();
+  if ((input_events.room() <= BUTTON_RESERVE) || !input_events.push(event))
+    rotary_lost += steps;
 }
 
 
@@ -401,95 +448,108 @@ void loop()
   
   static boolean button_down = false;
   static unsigned long int button_down_start, button_down_time;
-  
-  // rotaryIRQ() sets the flag rotary_counter to true
-  // if the knob position has changed. We can use this flag
-  // to do something in the main loop() each time there's
-  // a change. We'll clear this flag when we're done, which
-  // lets us run this if() once for each change.
-  
-  if (rotary_change)
+  static unsigned long int button_press_time;
+  InputEvent event;
+  int steps = 0;
+  int lost;
+
+  // The IRQs queue an event for every knob step and every button
+  // press and release, with the time it happened. We handle them
+  // all here, oldest first. Knob steps and button edges that found
+  // the queue full were tallied instead; once the queue is empty we
+  // catch up on those too, so none is lost however fast they come.
+
+  // Consecutive knob steps are added up in "steps" and acted on
+  // together, so a quick spin skips several tracks but restarts
+  // playback only once:
+
+  while (true)
   {
-    switch (rotary_mode)
+    if (!input_events.pop(event))
     {
-      case TRACK:
-      
-        // Before switching to a new audio file, we MUST
-        // stop playing before accessing the SD directory:
-       
-        if (playing)
-          stopPlaying();
-      
-        // Get the next file:
-      
-        if (rotary_direction)
-          getNextTrack();
-        else
-          getPrevTrack();
-      
-        // If we were previously playing, let's start again!
-      
-        if (playing) startPlaying(); 
-
-        if (debugging)
-        {
-          Serial.print(F("current track "));
-          Serial.println(track);
-        }
-        break;
-      
-      case VOLUME:
-
-        // Change the volume. Easy.
-        
-        changeVolume(rotary_direction);
-        break;
+      // rotary_lost is two bytes, so read and clear it with the
+      // interrupts off:
+
+      noInterrupts();
+      lost = rotary_lost;
+      rotary_lost = 0;
+      interrupts();
+      if (lost)
+      {
+        steps += lost;
+        continue;
+      }
+      if (button_caught != button_lost)
+      {
+        // Presses and releases alternate, so a tallied edge is
+        // always the opposite of the last one handled. Only the
+        // last press and release tallied have their times kept, so
+        // any earlier pairs are dropped rather than given made up
+        // times (which would turn a long hold into a quick press):
+
+        noInterrupts();
+        while ((unsigned char)(button_lost - button_caught) > 2)
+          button_caught += 2;
+        button_caught++;
+        event.type = BUTTON_EVENT;
+        event.value = !button_down;
+        event.time = button_lost_time[event.value];
+        interrupts();
+      }
+      else
+        break; // Nothing left to handle
     }
-    rotary_change = false; // Clear flag
-  }
 
-  // The button IRQ also sets several flags to true, one for
-  // button_pressed, one for button_released. Like the rotary
-  // flag, we'll clear these when we're done handling them:
+    if (event.type == ROTARY_EVENT)
+    {
+      steps += event.value;
+      continue;
+    }
 
-  if (button_pressed)
-  {
-    if (debugging) Serial.println(F("button press"));
+    // A button event, first act on the knob steps before it:
 
-    button_pressed = false; // Clear flag
+    rotaryTurn(steps);
+    steps = 0;
 
-    // We'll set another flag saying the button is now down
-    // this is so we can keep track of how long the button
-    // is being held down. (We can't do this in interrupts,
-    // because the button state doesn't change while it's
-    // being held down):
+    if (event.value) // Button pressed
+    {
+      if (debugging) Serial.println(F("button press"));
 
-    button_down = true;
-    button_down_start = millis();
-  }
+      // We'll set a flag saying the button is now down
+      // this is so we can keep track of how long the button
+      // is being held down. (We can't do this in interrupts,
+      // because the button state doesn't change while it's
+      // being held down):
 
-  if (button_released)
-  {
-    if (debugging)
-    {
-      Serial.print(F("button release, downtime: "));
-      Serial.println(button_downtime,DEC);
+      button_down = true;
+      button_down_start = event.time;
+      button_press_time = event.time;
     }
-    
-    // For quick button presses, start or stop playback:
-    
-    if (button_downtime < 1000)
+    else // Button released
     {
-      playing = !playing;
-      if (playing)
-        startPlaying();
-      else
-        stopPlaying();
-    }
+      button_down_time = event.time - button_press_time;
+
+      if (debugging)
+      {
+        Serial.print(F("button release, downtime: "));
+        Serial.println(button_down_time,DEC);
+      }
+
+      // For quick button presses, start or stop playback:
+
+      if (button_down_time < 1000)
+      {
+        playing = !playing;
+        if (playing)
+          startPlaying();
+        else
+          stopPlaying();
+      }
 
-    button_released = false; // Clear flags
-    button_down = false;
+      button_down = false;
+    }
   }
+  rotaryTurn(steps);
 
   // Now we can keep track of how long the button is being
   // held down, and perform actions based on that time.
@@ -549,19 +609,73 @@ void loop()
 }
 
 
-void changeVolume(boolean direction)
+void rotaryTurn(int steps)
 {
-  // Increment or decrement the volume.
+  // Act on a number of knob steps, positive for CW and negative
+  // for CCW, according to the current mode.
+
+  if (steps == 0)
+    return;
+
+  switch (rotary_mode)
+  {
+    case TRACK:
+    
+      // The MP3 library holds off refilling the VS1053 while
+      // we read the SD directory, so the current track can
+      // keep playing while we look for the next one:
+
+      SdSpiBus::clearStats();
+
+      if (steps > 0)
+        for (; steps > 0; steps--)
+          getNextTrack();
+      else
+        getPrevTrack(-steps);
+    
+      // If we were previously playing, switch to the new track:
+    
+      if (playing)
+      {
+        stopPlaying();
+        startPlaying();
+      }
+
+      if (debugging)
+      {
+        Serial.print(F("current track "));
+        Serial.println(track);
+        Serial.print(F("worst refill delay "));
+        Serial.println(SdSpiBus::maxDeferMicros());
+      }
+      break;
+    
+    case VOLUME:
+
+      // Change the volume. Easy.
+      
+      changeVolume(steps);
+      break;
+  }
+}
+
+
+void changeVolume(int steps)
+{
+  // Raise (positive steps) or lower (negative steps) the volume.
   // This is handled internally in the VS1053 MP3 chip.
   // Lower numbers are louder (0 is the loudest).
   
-  if (volume < 255 && direction == false)
+  for (; steps < 0 && volume < 254; steps++)
     volume += 2;
   
-  if (volume > 0 && direction == true)
+  for (; steps > 0 && volume > 0; steps--)
     volume -= 2;
 
-  MP3player.setVolume(volume, volume);
+  // Glide to the new volume, rather than jump. The library
+  // steps it in the background, so we don't wait here.
+
+  MP3player.fadeTo(volume, volume, VOLUME_GLIDE);
 
   if (debugging)
   {
@@ -573,7 +687,7 @@ void changeVolume(boolean direction)
 
 void getNextTrack()
 {
-  // Get the next playable track (check extension to be
+  // Get the next playable track (check the content to be
   // sure it's an audio file)
   
   do
@@ -582,17 +696,6 @@ void getNextTrack()
 }
 
 
-void getPrevTrack()
-{
-  // Get the previous playable track (check extension to be
-  // sure it's an audio file)
-
-  do
-    getPrevFile();
-  while(isPlayable() != true);
-}
-
-
 void getNextFile()
 {
   // Get the next file (which may be playable or not)
@@ -609,38 +712,68 @@ void getNextFile()
     return;
   }
   file.getFilename(track);  
+
+  // Only look inside files, directories are never playable:
+
+  if (file.isFile())
+    sniffFormat(&file, &track_format);
+  else
+    track_format.format = fmt_unknown;
   file.close();
 }
 
 
-void getPrevFile()
+void getPrevTrack(unsigned int steps)
 {
-  // Get the previous file (which may be playable or not)
-  
-  char test[13], prev[13];
-
-  // Getting the previous file is tricky, since you can
-  // only go forward when reading directories.
+  // Go back a number of files, to a playable track.
+
+  // Going backwards is tricky, since you can only go forward
+  // when reading directories. To handle this, we'll read through
+  // the whole directory once, counting the files and noting where
+  // the current track is, without looking inside them. Then we'll
+  // start over and read forward to the file "steps" before it, and
+  // only check that one is playable. If it isn't, we go on to the
+  // next playable track after it. That's two passes however far we
+  // go back, so a fast spin back through a big card doesn't take
+  // forever.
+
+  char name[13];
+  unsigned int count = 0, index = 0;
+
+  sd.chdir("/",true); // Back to the beginning of root directory
+  while (file.openNext(sd.vwd(), O_READ))
+  {
+    if (file.isFile())
+    {
+      file.getFilename(name);
+      if (strcasecmp(name,track) == 0)
+        index = count;
+      count++;
+    }
+    file.close();
+  }
 
-  // To handle this, we'll save the name of the current
-  // file, then keep reading all the files until we loop
-  // back around to where we are. While doing this we're
-  // saving the last file we looked at, so when we get
-  // back to the current file, we'll return the previous
-  // one.
-  
-  // Yeah, it's a pain.
+  if (count == 0) return;
 
-  strcpy(test,track);
+  // Read forward to the file "steps" before the current one,
+  // looping around from the first file to the last:
 
-  do
+  index = (index + count - (steps % count)) % count;
+  sd.chdir("/",true);
+  while (file.openNext(sd.vwd(), O_READ))
   {
-    strcpy(prev,track);
-    getNextTrack();
+    if (file.isFile() && (index-- == 0))
+    {
+      file.getFilename(track);
+      sniffFormat(&file, &track_format);
+      file.close();
+      break;
+    }
+    file.close();
   }
-  while(strcasecmp(track,test) != 0);
-  
-  strcpy(track,prev);
+
+  if (!isPlayable())
+    getNextTrack();
 }
 
 
@@ -655,7 +788,10 @@ void startPlaying()
     Serial.print(F("..."));
   }  
 
-  result = MP3player.playMP3(track);
+  // The format was found as the track was chosen, so the
+  // library doesn't need to look again.
+
+  result = MP3player.playMP3(track, 0, &track_format);
 
   if (debugging)
   {
@@ -674,27 +810,14 @@ void stopPlaying()
 
 boolean isPlayable()
 {
-  // Check to see if a filename has a "playable" extension.
+  // Check to see if the track's content is a "playable" format.
   // This is to keep the VS1053 from locking up if it is sent
-  // unplayable data.
+  // unplayable data. The library's sniffFormat() looked at the
+  // first bytes of the file, for the marks each format starts
+  // with, as it was found. (Directories and other files are
+  // fmt_unknown.)
 
-  char *extension;
-  
-  extension = strrchr(track,'.');
-  extension++;
-  if (
-    (strcasecmp(extension,"MP3") == 0) ||
-    (strcasecmp(extension,"WAV") == 0) ||
-    (strcasecmp(extension,"MID") == 0) ||
-    (strcasecmp(extension,"MP4") == 0) ||
-    (strcasecmp(extension,"WMA") == 0) ||
-    (strcasecmp(extension,"FLA") == 0) ||
-    (strcasecmp(extension,"OGG") == 0) ||
-    (strcasecmp(extension,"AAC") == 0)
-  )
-    return true;
-  else
-    return false;
+  return (track_format.format != fmt_unknown);
 }
 
 
@@ -0,0 +1,146 @@
+// RotaryEncoder.h, part of the "Player" example sketch for Lilypad MP3 Player
+
+// A quadrature decoder for a rotary encoder with both channels on
+// interrupts, with velocity acceleration.
+
+// Call changeA() from the IRQ of channel A, and changeB() from the
+// IRQ of channel B. Each reads the pins straight from their port
+// input registers (or takes the port state PinChangeInt already
+// read), and looks up the transition from the previous state in a
+// 16 entry table. Every valid transition is a quarter step; the two
+// that change both channels at once are missed edges or noise, and
+// are ignored. Switch bounce moves back and forth between two
+// states, so it cancels itself out.
+
+// When QUARTERS_PER_STEP quarter steps add up in one direction, a
+// detent ("click") is complete and the call returns the number of
+// steps to take, positive for CW and negative for CCW. The faster
+// the knob turns, the bigger that number; the time of each detent
+// (from micros()) is compared to the previous one, and the gap is
+// looked up in the acceleration table below. A change of direction
+// always starts again at one step.
+
+#ifndef RotaryEncoder_h
+#define RotaryEncoder_h
+
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+
+// Quarter steps (channel edges) per detent of the knob.
+
+#define QUARTERS_PER_STEP 4
+
+// Acceleration table: a detent that comes less than "gap" us after
+// the previous one in the same direction is worth "steps" steps.
+// Checked in order, so keep the gaps increasing. (The tables are
+// kept in program flash to save RAM.)
+
+struct EncoderSpeed
+{
+  unsigned long gap;
+  signed char steps;
+};
+
+const EncoderSpeed encoder_speeds[] PROGMEM =
+{
+  {  8000UL, 32 },
+  { 15000UL, 16 },
+  { 30000UL,  8 },
+  { 60000UL,  3 },
+};
+
+// Quarter steps for each transition, indexed by (previous << 2) | current,
+// where a state is (B << 1) | A. CW is 2, 0, 1, 3, 2...
+
+const signed char encoder_transitions[16] PROGMEM =
+{
+   0,  1, -1,  0,
+  -1,  0,  0,  1,
+   1,  0,  0, -1,
+   0, -1,  1,  0
+};
+
+class RotaryEncoder
+{
+  public:
+    // Remember where the channels are, and their current state.
+    // Call before the IRQs are attached.
+
+    void begin(uint8_t pinA, uint8_t pinB)
+    {
+      portA = portInputRegister(digitalPinToPort(pinA));
+      maskA = digitalPinToBitMask(pinA);
+      portB = portInputRegister(digitalPinToPort(pinB));
+      maskB = digitalPinToBitMask(pinB);
+      state = ((*portB & maskB) ? 2 : 0) | ((*portA & maskA) ? 1 : 0);
+      quarters = 0;
+      last_steps = 0;
+      last_time = micros();
+    }
+
+    // Call from channel A's IRQ. Returns the steps taken, 0 if none.
+
+    signed char changeA()
+    {
+      return update(*portB & maskB, *portA & maskA);
+    }
+
+    // Call from channel B's IRQ, with the port state PinChangeInt
+    // read as the interrupt came in (PCintPort::curr).
+    // Returns the steps taken, 0 if none.
+
+    signed char changeB(uint8_t port_state)
+    {
+      return update(port_state & maskB, *portA & maskA);
+    }
+
+    // micros() of the last detent.
+
+    unsigned long lastStepTime() { return last_time; }
+
+  private:
+    signed char update(uint8_t b, uint8_t a)
+    {
+      uint8_t current = (b ? 2 : 0) | (a ? 1 : 0);
+      signed char direction;
+      signed char steps = 1;
+      unsigned long now, gap;
+      uint8_t i;
+
+      quarters += (signed char)pgm_read_byte(&encoder_transitions[(state << 2) | current]);
+      state = current;
+
+      if (quarters >= QUARTERS_PER_STEP)
+        direction = 1;
+      else if (quarters <= -QUARTERS_PER_STEP)
+        direction = -1;
+      else
+        return 0;
+      quarters = 0;
+
+      // A whole detent, how fast did it come?
+
+      now = micros();
+      gap = now - last_time;
+      last_time = now;
+      if (last_steps && ((last_steps > 0) == (direction > 0)))
+        for (i = 0; i < sizeof(encoder_speeds) / sizeof(encoder_speeds[0]); i++)
+          if (gap < pgm_read_dword(&encoder_speeds[i].gap))
+          {
+            steps = (signed char)pgm_read_byte(&encoder_speeds[i].steps);
+            break;
+          }
+
+      last_steps = steps * direction;
+      return last_steps;
+    }
+
+    volatile uint8_t *portA, *portB;
+    uint8_t maskA, maskB;
+    uint8_t state;            // (B << 1) | A as last seen
+    signed char quarters;     // quarter steps toward the next detent
+    signed char last_steps;   // value returned for the last detent
+    unsigned long last_time;  // micros() of the last detent
+};
+
+#endif
@@ -35,6 +35,9 @@
 // Uses the SFEMP3Shield library by Bill Porter, which is supplied
 // with this archive, or download from http://www.billporter.info/
 
+// Uses the PinChangeInt library by Lex Talionis, which is supplied 
+// with this archive, or download from http://code.google.com/p/arduino-pinchangeint/
+
 // License:
 // We use the "beerware" license for our firmware. You can do
 // ANYTHING you want with this code. If you like it, and we meet
@@ -46,6 +49,9 @@
 
 // Revision history:
 // 1.0 initial release MDG 2012/11/01
+// 1.1 triggers are pin change interrupts, a file starts on the
+//     first edge instead of after the trigger is released 2026/10/18
+// 1.2 files are preloaded in setup() and started with playClip()
 
 
 // We'll need a few libraries to access all this hardware!
@@ -54,6 +60,12 @@
 #include <SdFat.h>          // SD card file system
 #include <SFEMP3Shield.h>   // MP3 decoder chip
 
+// The triggers are on ports C and D, port B (the SPI bus) is not
+// needed by the pin change interrupt library:
+
+#define NO_PORTB_PINCHANGES
+#include <PinChangeInt.h>   // Interrupts on the trigger pins
+
 // Constants for the trigger input pins, which we'll place
 // in an array for convenience:
 
@@ -102,6 +114,50 @@ boolean interruptself = false;
 
 char filename[5][13];
 
+// To start as quickly as possible, each file's location on the SD
+// card is found once in setup(), along with its first CLIP_HEAD
+// bytes of audio. These are sent to the MP3 chip the moment the
+// trigger is grounded, while the rest of the file is being read.
+// (Each byte of CLIP_HEAD takes five bytes of the 2K of RAM)
+
+#define CLIP_HEAD 64
+
+clip_m clip[5];
+byte clip_head[5][CLIP_HEAD];
+
+// A trigger must be HIGH (released) for a solid TRIGGER_DEBOUNCE
+// microseconds before the next LOW edge counts as a new trigger.
+// (necessary to avoid switch bounce on T2 and T3 since we need
+// those free for I2C control of the amplifier)
+
+#define TRIGGER_DEBOUNCE 50000UL
+
+// Each trigger's debounce state, kept by the interrupt function.
+// trigger_high is true while the pin is HIGH, and trigger_edge is
+// the time of its last edge (in microseconds):
+
+volatile boolean trigger_high[5] = {true,true,true,true,true};
+volatile unsigned long trigger_edge[5];
+
+// Triggers are passed from the interrupt function to loop() through
+// a small queue of events, each with the trigger number and the
+// time (in microseconds) the trigger was grounded. The interrupt
+// function only writes trigger_head, and loop() only writes
+// trigger_tail, so neither needs to turn off interrupts.
+
+#define TRIGGER_QUEUE 8  // Must be a power of two
+
+struct trigger_event
+{
+  byte t;             // trigger number, 1 to 5
+  unsigned long time; // micros() when it was grounded
+};
+
+volatile trigger_event trigger_queue[TRIGGER_QUEUE];
+volatile byte trigger_head = 0;
+volatile byte trigger_tail = 0;
+volatile byte trigger_overflow = 0; // events lost to a full queue
+
 
 void setup()
 {
@@ -119,6 +175,13 @@ void setup()
     digitalWrite(trigger[x],HIGH);
   }
 
+  // Call triggerIRQ() whenever a trigger pin changes state.
+  // If serial debugging is on, only watch triggers 1-3,
+  // otherwise the serial port would fire triggers 4 and 5.
+
+  for (x = 0; x < (debugging ? 3 : 5); x++)
+    PCintPort::attachInterrupt(trigger[x], &triggerIRQ, CHANGE);
+
   // If serial port debugging is inconvenient, you can connect
   // a LED to the red channel of the rotary encoder to blink
   // startup error codes:
@@ -236,6 +299,28 @@ void setup()
     }
   }
 
+  // Preload the location and head of each file:
+
+  for(x = 0; x <= 4; x++)
+  {
+    if (filename[x][0] != 0)
+    {
+      result = MP3player.preloadClip(filename[x],&clip[x],clip_head[x],CLIP_HEAD);
+
+      if (result != 0) // Can't preload, don't play it
+      {
+        if (debugging)
+        {
+          Serial.print(F("error "));
+          Serial.print(result);
+          Serial.print(F(" when trying to preload "));
+          Serial.println(filename[x]);
+        }
+        filename[x][0] = 0;
+      }
+    }
+  }
+
   // Set the VS1053 volume. 0 is loudest, 255 is lowest (off):
 
   MP3player.setVolume(10,10);
@@ -249,93 +334,130 @@ void setup()
 
 void loop()
 {
-  int t;              // current trigger
   static int last_t;  // previous (playing) trigger
-  int x;
+  trigger_event event;
   byte result;
   
-  // Step through the trigger inputs, looking for LOW signals.
-  // The internal pullup resistors will keep them HIGH when
-  // there is no connection to the input.
-
-  // If serial debugging is on, only check triggers 1-3,
-  // otherwise check triggers 1-5.
+  // Take the triggers queued by triggerIRQ(), in the order they
+  // happened. Nothing here waits, so a trigger is acted on as soon
+  // as it is grounded, rather than after it is released.
 
-  for(t = 1; t <= (debugging ? 3 : 5); t++)
+  while (trigger_tail != trigger_head)
   {
-    // The trigger pins are stored in the inputs[] array.
-    // Read the pin and check if it is LOW (triggered).
+    event.t = trigger_queue[trigger_tail].t;
+    event.time = trigger_queue[trigger_tail].time;
+    trigger_tail = (trigger_tail + 1) & (TRIGGER_QUEUE - 1);
 
-    if (digitalRead(trigger[t-1]) == LOW)
+    if (debugging)
     {
-      // Wait for trigger to return high for a solid 50ms
-      // (necessary to avoid switch bounce on T2 and T3
-      // since we need those free for I2C control of the
-      // amplifier)
-      
-      x = 0;
-      while(x < 50)
-      {
-        if (digitalRead(trigger[t-1]) == HIGH)
-          x++;
-        else
-          x = 0;
-        delay(1);
-      } 
-        
-      if (debugging)
-      {
-        Serial.print(F("got trigger "));
-        Serial.println(t);
-      }
+      Serial.print(F("got trigger "));
+      Serial.println(event.t);
+    }
+
+    // Do we have a valid filename for this trigger?
+    // (Invalid filenames will have 0 as the first character)
 
-      // Do we have a valid filename for this trigger?
-      // (Invalid filenames will have 0 as the first character)
+    if (filename[event.t-1][0] == 0)
+    {
+      if (debugging)
+        Serial.println(F("no file with that number"));
+    }
+    else // We do have a filename for this trigger!
+    {
+      // If a file is already playing, and we've chosen to
+      // allow playback to be interrupted by a new trigger,
+      // stop the playback before playing the new file.
 
-      if (filename[t-1][0] == 0)
+      if (interrupt && MP3player.isPlaying() && ((event.t != last_t) || interruptself))
       {
         if (debugging)
-          Serial.println(F("no file with that number"));
+          Serial.println(F("stopping playback"));
+
+        MP3player.stopTrack();
       }
-      else // We do have a filename for this trigger!
-      {
-        // If a file is already playing, and we've chosen to
-        // allow playback to be interrupted by a new trigger,
-        // stop the playback before playing the new file.
 
-        if (interrupt && MP3player.isPlaying() && ((t != last_t) || interruptself))
+      // Play the file associated with the trigger number,
+      // from where it was preloaded.
+      // (If a file is already playing, this command will fail
+      //  with error #1).
+
+      result = MP3player.playClip(&clip[event.t-1]);
+
+      if (result == 0) last_t = event.t;  // Save playing trigger
+
+      if(debugging)
+      {
+        if(result != 0)
         {
-          if (debugging)
-            Serial.println(F("stopping playback"));
+          Serial.print(F("error "));
+          Serial.print(result);
+          Serial.print(F(" when trying to play track "));
+        }
+        else
+        {
+          // The time from the trigger being grounded until
+          // the head and first data were sent to the MP3 chip:
 
-          MP3player.stopTrack();
+          Serial.print(F("latency "));
+          Serial.print(micros() - event.time);
+          Serial.print(F("us, playing "));
         }
+        Serial.println(filename[event.t-1]);
+      }
+    }
+  }
 
-        // Play the filename associated with the trigger number.
-        // (If a file is already playing, this command will fail
-        //  with error #2).
+  if (debugging && trigger_overflow)
+  {
+    Serial.print(F("lost triggers: "));
+    Serial.println(trigger_overflow);
+    trigger_overflow = 0;
+  }
+}
 
-        result = MP3player.playMP3(filename[t-1]);
 
-        if (result == 0) last_t = t;  // Save playing trigger
-  
-        if(debugging)
-        {
-          if(result != 0)
-          {
-            Serial.print(F("error "));
-            Serial.print(result);
-            Serial.print(F(" when trying to play track "));
-          }
-          else
-          {
-            Serial.print(F("playing "));
-          }
-          Serial.println(filename[t-1]);
-        }
+void triggerIRQ()
+{
+  // Trigger interrupt request function (IRQ).
+  // This function is called *automatically* when any of the
+  // trigger pins changes state.
+
+  // Each trigger is debounced by remembering whether it is HIGH
+  // or LOW, and the time of its last edge. A LOW edge that follows
+  // a HIGH of at least TRIGGER_DEBOUNCE is a new trigger, and is
+  // put on the queue with its timestamp. Any other edge is switch
+  // bounce, and only restarts the timing.
+
+  unsigned long now = micros();
+  byte x, next;
+
+  // Which trigger changed? (PinChangeInt tells us the pin number)
+
+  for (x = 0; x <= 4; x++)
+    if (trigger[x] == PCintPort::arduinoPin)
+      break;
+  if (x > 4) return;
+
+  if (PCintPort::pinState == LOW)
+  {
+    if (trigger_high[x] && (now - trigger_edge[x] >= TRIGGER_DEBOUNCE))
+    {
+      next = (trigger_head + 1) & (TRIGGER_QUEUE - 1);
+      if (next == trigger_tail)
+        trigger_overflow++;
+      else
+      {
+        trigger_queue[trigger_head].t = x + 1;
+        trigger_queue[trigger_head].time = now;
+        trigger_head = next;
       }
     }
+    trigger_high[x] = false;
   }
+  else
+    trigger_high[x] = true;
+
+  trigger_edge[x] = now;
 }
 
 
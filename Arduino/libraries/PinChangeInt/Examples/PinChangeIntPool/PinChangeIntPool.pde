@@ -0,0 +1,86 @@
+// PinChangeIntPool
+// Version 1.0 - initial version
+//
+// Reports free RAM and heap fragmentation as pin change interrupts are attached and detached, with
+// the PCintPin objects taken from new (the default) or from the static pool of PCINT_PIN_POOL.
+//
+// Between attaches, the sketch borrows and returns a small buffer with malloc() and free(), as SdFat,
+// String or a sketch might. With new, a PCintPin lands above each buffer, and the buffer's hole can't
+// be handed back to the top of the heap. With the pool, the objects are in .bss, sized at compile
+// time, and the heap is left alone. Build once with and once without PCINT_PIN_POOL to compare.
+//
+// Uses SdFatUtil's FreeRam() for the gap between the heap and the stack, and FreeListRam() for the
+// holes left in the heap below it.
+
+//-------- define these in your sketch, if applicable ----------------------------------------------------------
+// define PCINT_PIN_POOL below to take the PCintPin objects from a static pool of that many.
+//#define PCINT_PIN_POOL 6
+//-------- define the above in your sketch, if applicable ------------------------------------------------------
+#include <PinChangeInt.h>
+#include <SdFat.h>
+#include <SdFatUtil.h>
+
+#define PLOW  2 // Interrupts are attached to these pins
+#define PHIGH 7
+#define BUFFER_SIZE 24 // bytes borrowed from the heap between attaches
+
+volatile uint8_t count;
+
+void quicfunc() {
+  count++;
+}
+
+void report(const __FlashStringHelper* step) {
+  int largest;
+  int holes = FreeListRam(&largest);
+  int ram = FreeRam();
+  Serial.print(step);
+  Serial.print(F(" FreeRam: "));
+  Serial.print(ram, DEC);
+  Serial.print(F(" holes: "));
+  Serial.print(holes, DEC);
+  Serial.print(F(" largest hole: "));
+  Serial.print(largest, DEC);
+  // fragmentation: the share of free RAM that can't be had in one piece.
+  Serial.print(F(" fragmentation: "));
+  Serial.print(100 - (100L * (ram > largest ? ram : largest)) / (ram + holes), DEC);
+  Serial.println(F("%"));
+}
+
+void setup() {
+  uint8_t i;
+  void* buffer;
+
+  Serial.begin(115200); Serial.println(F("---------------------------------------"));
+#ifdef PCINT_PIN_POOL
+  Serial.print(F("PCintPin pool of ")); Serial.println(PCINT_PIN_POOL, DEC);
+#else
+  Serial.println(F("PCintPin from new"));
+#endif
+  report(F("start"));
+
+  for (i=PLOW; i <= PHIGH; i++) {
+    pinMode(i, INPUT); digitalWrite(i, HIGH);
+    buffer=malloc(BUFFER_SIZE);
+    if (PCintPort::attachInterrupt(i, &quicfunc, CHANGE) < 0) {
+      Serial.print(F("attach failed, pin ")); Serial.println(i, DEC);
+    }
+    free(buffer);
+  }
+  report(F("attached"));
+
+  for (i=PLOW; i <= PHIGH; i++) PCintPort::detachInterrupt(i);
+  report(F("detached"));
+
+  for (i=PLOW; i <= PHIGH; i++) PCintPort::attachInterrupt(i, &quicfunc, CHANGE);
+  report(F("reattached"));
+
+  buffer=malloc(BUFFER_SIZE * (PHIGH - PLOW + 1));
+  Serial.print(F("one buffer of all the holes: "));
+  Serial.println(buffer ? F("placed") : F("failed"));
+  free(buffer);
+  report(F("end"));
+}
+
+void loop() {
+}
@@ -10,6 +10,9 @@
 //   for 1 second, show "*\n" (where \n is a newline), pause for 1 second, then run the test.
 // Version 1.4 - made this compatible with version 1.5 of PinChangeInt
 // Version 1.5 - modified it to use #define OOPCIVERSION for ooPinChangeInt
+// Version 1.6 - added #define PCINT_STATIC_TABLES, and a baseline run with the pin change interrupts
+//   masked, so the cost of each interrupt is printed in CPU cycles.  Build once with and once without
+//   PCINT_STATIC_TABLES to compare the linked list walk with the per-port handler tables.
 
 // This version number is for ooPinChangeInt
 //#define OOPCIVERSION 1030
@@ -34,6 +37,8 @@
 // reducing latency and code size
 // define DISABLE_PCINT_MULTI_SERVICE below to limit the handler to servicing a single interrupt per invocation.
 //#define       DISABLE_PCINT_MULTI_SERVICE
+// define PCINT_STATIC_TABLES below to dispatch through the per-port handler tables instead of the linked list.
+//#define       PCINT_STATIC_TABLES
 //-------- define the above in your sketch, if applicable ------------------------------------------------------
 #if defined(OOPCIVERSION)
   #define LIBRARYUNDERTEST "ooPinChangeInt"
@@ -209,12 +214,33 @@ void setup()
 } // end setup()
 
 uint8_t k=0;
-unsigned long milliStart, milliEnd, elapsed;
+unsigned long milliStart, milliEnd, elapsed, baseline;
+
+// Toggle the test pin 100000 times, 200000 edges, and return the milliseconds taken.
+unsigned long toggleTest() {
+  k=0;
+  milliStart=millis();
+  while (k < 10) {
+    i=0;
+    while (i < 10000) {
+      *pinT_OP&=not_pinT_M;    // pintest to 0 ****************************** 16.8 us
+      *pinT_OP|=pinT_M;        // pintest to 1 ****************************** ...to get here
+      i++;
+    }
+    k++;
+  }
+  milliEnd=millis();
+  return milliEnd-milliStart;
+}
+
 void loop() {
   k=0;
   *pinT_OP|=pinT_M;        // pintest to 1
 #ifdef SERIALSTUFF
   Serial.print(LIBRARYUNDERTEST); Serial.print(" ");
+#ifdef PCINT_STATIC_TABLES
+  Serial.print("(static tables) ");
+#endif
   Serial.print("TEST: "); Serial.print(TEST, DEC); Serial.print(" ");
 #ifndef MEMTEST
   Serial.print("test pin mask: "); Serial.print(pinT_M, HEX);
@@ -230,24 +256,24 @@ void loop() {
   #ifdef FLASH
   *led_port|=led_mask;
   #endif
-  milliStart=millis();
-  while (k < 10) {
-    i=0;
-    while (i < 10000) {
-      *pinT_OP&=not_pinT_M;    // pintest to 0 ****************************** 16.8 us
-      *pinT_OP|=pinT_M;        // pintest to 1 ****************************** ...to get here
-      i++;
-    }
-    k++;
-  }
-  milliEnd=millis();
+  // Baseline: the same loop with all pin change interrupts masked.
+  uint8_t pcicr=PCICR;
+  PCICR=0;
+  baseline=toggleTest();
+  PCIFR=PCIFR; // clear the flags raised meanwhile
+  PCICR=pcicr;
+  elapsed=toggleTest();
   #ifdef FLASH
   *led_port&=not_led_mask;
   #endif
-  elapsed=milliEnd-milliStart;
   #ifndef MEMTEST
   Serial.print(" Elapsed: "); 
-  Serial.println(elapsed, DEC);
+  Serial.print(elapsed, DEC);
+  Serial.print(" Baseline: ");
+  Serial.print(baseline, DEC);
+  // 200000 interrupts in (elapsed - baseline) ms
+  Serial.print(" Cycles per interrupt: ");
+  Serial.println((elapsed - baseline) * (F_CPU / 1000UL) / 200000UL, DEC);
   #endif
   #ifdef SERIALSTUFF
   Serial.print("Interrupted pin: ");
@@ -56,6 +56,12 @@
 // #define NO_PIN_NUMBER       // to indicate that you don't need the arduinoPin
 // #define DISABLE_PCINT_MULTI_SERVICE // to limit the handler to servicing a single interrupt per invocation.
 // #define GET_PCINT_VERSION   // to enable the uint16_t getPCIintVersion () function.
+// #define PCINT_STATIC_TABLES // to keep each port's handlers in a static 8-entry table, indexed by bit number,
+//                             // rather than a linked list of PCintPin objects allocated with new.  The interrupt
+//                             // handler then visits only the pins that changed, with no heap and no list walk.
+// #define PCINT_PIN_POOL 4    // to take the PCintPin objects from a static pool of that many, rather than new.
+//                             // attachInterrupt() and detachInterrupt() are then O(1), and detachInterrupt()
+//                             // returns the object to the pool.  Ignored with PCINT_STATIC_TABLES.
 // The following is intended for testing purposes.  If defined, then a whole host of static variables can be read
 // in your interrupt subroutine.  It is not defined by default, and you DO NOT want to define this in
 // Production code!:
@@ -173,12 +179,19 @@ public:
 	portPCMask(maskReg),
 	PCICRbit(1 << pcindex),
 	portRisingPins(0),
-	portFallingPins(0),
-	firstPin(NULL)
+	portFallingPins(0)
+#ifndef PCINT_STATIC_TABLES
+	,firstPin(NULL)
+#endif
 #ifdef PINMODE
 	,intrCount(0)
 #endif
 	{
+		#ifdef PCINT_STATIC_TABLES
+		for (uint8_t i=0; i < 8; i++) handler[i]=NULL;
+		#elif defined(PCINT_PIN_POOL)
+		for (uint8_t i=0; i < 8; i++) slot[i]=0;
+		#endif
 		#ifdef FLASH
 		ledsetup();
 		#endif
@@ -215,6 +228,27 @@ public:
 	#endif
 
 protected:
+	// Bit number, 0 to 7, of a mask with a single bit set.  Three tests rather than a loop.
+	static uint8_t	bitNumber(uint8_t mask) {
+		uint8_t bit=0;
+		if (mask & 0xF0) bit+=4;
+		if (mask & 0xCC) bit+=2;
+		if (mask & 0xAA) bit+=1;
+		return bit;
+	}
+#ifdef PCINT_STATIC_TABLES
+	void		enable(uint8_t mask, uint8_t mode);
+	int8_t		addPin(uint8_t arduinoPin,PCIntvoidFuncPtr userFunc, uint8_t mode);
+	volatile	uint8_t&		portPCMask;
+	const		uint8_t			PCICRbit;
+	volatile	uint8_t			portRisingPins;
+	volatile	uint8_t			portFallingPins;
+	volatile uint8_t		lastPinView;
+	PCIntvoidFuncPtr	handler[8];		// user function of each bit of the port
+	#ifndef NO_PIN_NUMBER
+	uint8_t			pinNumber[8];	// arduino pin of each bit of the port
+	#endif
+#else
 	class PCintPin {
 	public:
 		PCintPin() :
@@ -225,6 +259,9 @@ protected:
 		uint8_t		mask;
 		uint8_t arduinoPin;
 		PCintPin* next;
+		#ifdef PCINT_PIN_POOL
+		PCintPin* prev;
+		#endif
 	};
 	void 		enable(PCintPin* pin, PCIntvoidFuncPtr userFunc, uint8_t mode);
 	int8_t		addPin(uint8_t arduinoPin,PCIntvoidFuncPtr userFunc, uint8_t mode);
@@ -234,6 +271,13 @@ protected:
 	volatile	uint8_t			portFallingPins;
 	volatile uint8_t		lastPinView;
 	PCintPin*	firstPin;
+	#ifdef PCINT_PIN_POOL
+	uint8_t		slot[8];		// 1 + pool index of each bit's PCintPin, 0 for none
+	static PCintPin pinPool[PCINT_PIN_POOL];
+	static PCintPin* freePin;		// objects returned by detachInterrupt()
+	static uint8_t poolUsed;		// objects never yet taken from the pool
+	#endif
+#endif // PCINT_STATIC_TABLES
 };
 
 #ifndef LIBCALL_PINCHANGEINT // LIBCALL_PINCHANGEINT ***********************************************
@@ -244,6 +288,11 @@ volatile uint8_t PCintPort::arduinoPin=0;
 #ifndef NO_PIN_STATE
 volatile uint8_t PCintPort::pinState=0;
 #endif
+#if defined(PCINT_PIN_POOL) && !defined(PCINT_STATIC_TABLES)
+PCintPort::PCintPin PCintPort::pinPool[PCINT_PIN_POOL];
+PCintPort::PCintPin* PCintPort::freePin=NULL;
+uint8_t PCintPort::poolUsed=0;
+#endif
 #ifdef PINMODE
 volatile uint8_t PCintPort::pinmode=0;
 volatile uint8_t PCintPort::s_portRisingPins=0;
@@ -363,6 +412,35 @@ static PCintPort *lookupPortNumToPort( int portNum ) {
 }
 
 
+#ifdef PCINT_STATIC_TABLES
+void PCintPort::enable(uint8_t mask, uint8_t mode) {
+	// Enable the pin for interrupts by adding to the PCMSKx register.
+	// ...The final steps; at this point the interrupt is enabled on this pin.
+	portPCMask |= mask;
+	if ((mode == RISING) || (mode == CHANGE)) portRisingPins |= mask;
+	if ((mode == FALLING) || (mode == CHANGE)) portFallingPins |= mask;
+	PCICR |= PCICRbit;
+}
+
+int8_t PCintPort::addPin(uint8_t arduinoPin, PCIntvoidFuncPtr userFunc, uint8_t mode)
+{
+	uint8_t mask=digitalPinToBitMask(arduinoPin);
+	uint8_t bit=bitNumber(mask);
+	int8_t result=(handler[bit] == NULL) ? 1 : 0;
+
+	// The handler is two bytes; don't let the interrupt see half of it.
+	uint8_t oldSREG = SREG;
+	cli();
+	handler[bit]=userFunc;
+	#ifndef NO_PIN_NUMBER
+	pinNumber[bit]=arduinoPin;
+	#endif
+	portRisingPins &= ~mask; portFallingPins &= ~mask; // the mode may have changed
+	enable(mask, mode);
+	SREG = oldSREG;
+	return(result);
+}
+#else
 void PCintPort::enable(PCintPin* p, PCIntvoidFuncPtr userFunc, uint8_t mode) {
 	// Enable the pin for interrupts by adding to the PCMSKx register.
 	// ...The final steps; at this point the interrupt is enabled on this pin.
@@ -374,6 +452,38 @@ void PCintPort::enable(PCintPin* p, PCIntvoidFuncPtr userFunc, uint8_t mode) {
 	PCICR |= PCICRbit;
 }
 
+#ifdef PCINT_PIN_POOL
+int8_t PCintPort::addPin(uint8_t arduinoPin, PCIntvoidFuncPtr userFunc, uint8_t mode)
+{
+	PCintPin* p;
+	uint8_t mask=digitalPinToBitMask(arduinoPin);
+	uint8_t bit=bitNumber(mask);
+
+	// The pin already has an object, just enable.
+	if (slot[bit]) { enable(&pinPool[slot[bit]-1], userFunc, mode); return(0); }
+
+	// Take an object returned by detachInterrupt(), else a fresh one.
+	if (freePin != NULL) { p=freePin; freePin=p->next; }
+	else if (poolUsed < PCINT_PIN_POOL) p=&pinPool[poolUsed++];
+	else return(-1);
+	p->arduinoPin=arduinoPin;
+	p->mode=mode;
+	p->mask=mask;
+
+	// Link at the head of the list, where the interrupt may be walking it.
+	uint8_t oldSREG = SREG;
+	cli();
+	p->prev=NULL;
+	p->next=firstPin;
+	if (firstPin != NULL) firstPin->prev=p;
+	firstPin=p;
+	SREG = oldSREG;
+	slot[bit]=(p - pinPool) + 1;
+
+	enable(p, userFunc, mode);
+	return(1);
+}
+#else
 int8_t PCintPort::addPin(uint8_t arduinoPin, PCIntvoidFuncPtr userFunc, uint8_t mode)
 {
 	PCintPin* tmp;
@@ -414,6 +524,8 @@ int8_t PCintPort::addPin(uint8_t arduinoPin, PCIntvoidFuncPtr userFunc, uint8_t
 #endif
 	return(1);
 }
+#endif // PCINT_PIN_POOL
+#endif // PCINT_STATIC_TABLES
 
 /*
  * attach an interrupt to a specific pin using pin change interrupts.
@@ -439,7 +551,6 @@ int8_t PCintPort::attachInterrupt(uint8_t arduinoPin, PCIntvoidFuncPtr userFunc,
 void PCintPort::detachInterrupt(uint8_t arduinoPin)
 {
 	PCintPort *port;
-	PCintPin* current;
 	uint8_t mask;
 #ifdef DEBUG
 	Serial.print("detachInterrupt: "); Serial.println(arduinoPin, DEC);
@@ -448,6 +559,33 @@ void PCintPort::detachInterrupt(uint8_t arduinoPin)
 	if (portNum == NOT_A_PORT) return;
 	port=lookupPortNumToPort(portNum);
 	mask=digitalPinToBitMask(arduinoPin);
+#ifdef PCINT_STATIC_TABLES
+	uint8_t oldSREG = SREG;
+	cli(); // disable interrupts
+	port->portPCMask &= ~mask; // disable the mask entry.
+	if (port->portPCMask == 0) PCICR &= ~(port->PCICRbit);
+	port->portRisingPins &= ~mask; port->portFallingPins &= ~mask;
+	port->handler[bitNumber(mask)]=NULL;
+	SREG = oldSREG; // Restore register; reenables interrupts
+#elif defined(PCINT_PIN_POOL)
+	uint8_t bit=bitNumber(mask);
+	if (port->slot[bit] == 0) return;
+	PCintPin* p=&pinPool[port->slot[bit]-1];
+	port->slot[bit]=0;
+	uint8_t oldSREG = SREG;
+	cli(); // disable interrupts
+	port->portPCMask &= ~mask; // disable the mask entry.
+	if (port->portPCMask == 0) PCICR &= ~(port->PCICRbit);
+	port->portRisingPins &= ~mask; port->portFallingPins &= ~mask;
+	// Unlink, then return it to the pool.
+	if (p->prev != NULL) p->prev->next=p->next;
+	else port->firstPin=p->next;
+	if (p->next != NULL) p->next->prev=p->prev;
+	SREG = oldSREG; // Restore register; reenables interrupts
+	p->next=freePin;
+	freePin=p;
+#else
+	PCintPin* current;
 	current=port->firstPin;
 	//PCintPin* prev=NULL;
 	while (current) {
@@ -466,12 +604,15 @@ void PCintPort::detachInterrupt(uint8_t arduinoPin)
 		//prev=current;
 		current=current->next;
 	}
+#endif // PCINT_STATIC_TABLES
 }
 
 // common code for isr handler. "port" is the PCINT number.
 // there isn't really a good way to back-map ports and masks to pins.
 void PCintPort::PCint() {
+	#ifndef PCINT_STATIC_TABLES
 	uint8_t thisChangedPin; //MIKE
+	#endif
 
 	#ifdef FLASH
 	if (*led_port & led_mask) *led_port&=not_led_mask;
@@ -506,6 +647,27 @@ void PCintPort::PCint() {
 		#endif
 		lastPinView = PCintPort::curr;
 
+		#ifdef PCINT_STATIC_TABLES
+		// Visit only the pins that changed, lowest bit first.
+		while (changedPins) {
+			uint8_t mask = changedPins & (uint8_t)-changedPins;
+			uint8_t bit = bitNumber(mask);
+			changedPins ^= mask;
+			#ifndef NO_PIN_STATE
+			PCintPort::pinState=PCintPort::curr & mask ? HIGH : LOW;
+			#endif
+			#ifndef NO_PIN_NUMBER
+			PCintPort::arduinoPin=pinNumber[bit];
+			#endif
+			#ifdef PINMODE
+			PCintPort::s_portRisingPins=portRisingPins;
+			PCintPort::s_portFallingPins=portFallingPins;
+			PCintPort::s_pmask=mask;
+			PCintPort::s_changedPins=changedPins;
+			#endif
+			handler[bit]();
+		}
+		#else
 		PCintPin* p = firstPin;
 		while (p) {
 			// Trigger interrupt if the bit is high and it's set to trigger on mode RISING or CHANGE
@@ -529,6 +691,7 @@ void PCintPort::PCint() {
 			}
 			p=p->next;
 		}
+		#endif // PCINT_STATIC_TABLES
 	#ifndef DISABLE_PCINT_MULTI_SERVICE
 		pcifr = PCIFR & PCICRbit;
 		if (pcifr == 0) break;
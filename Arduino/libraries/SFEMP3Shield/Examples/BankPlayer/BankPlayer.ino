@@ -0,0 +1,147 @@
+/**
+ * \file BankPlayer.ino
+ *
+ * \brief Example sketch playing clips from a sound bank, by number
+ * \remarks comments are implemented with Doxygen Markdown format
+ *
+ * This sketch opens the sound bank "SOUNDS.BNK" in the root of the SdCard.
+ * Then listens for a number from a serial terminal (such as the Serial Monitor
+ * in the Arduino IDE), followed by a new line, and plays the clip of that id.
+ * Any clip playing is stopped first. The time taken for playBankClip() is
+ * printed, which has no file to open nor directory to search.
+ *
+ * Create the bank on the PC from a folder of clips, for example
+ * \code mk_bank.pl SOUNDS.BNK 1door.mp3 2bell.wav 3creak.mp3 \endcode
+ * with plugins/mk_bank.pl. Where the number leading each filename is its id.
+ * Copy it to a freshly formatted card, as openBank() requires it to be
+ * contiguous.
+ */
+
+#include <SPI.h>
+
+//Add the SdFat Libraries
+#include <SdFat.h>
+#include <SdFatUtil.h>
+
+//and the MP3 Shield Library
+#include <SFEMP3Shield.h>
+
+// Below is not needed if interrupt driven. Safe to remove if not using.
+#if defined(USE_MP3_REFILL_MEANS) \
+    && ( (USE_MP3_REFILL_MEANS == USE_MP3_Timer1) \
+    ||   (USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog) )
+  #include <TimerOne.h>
+#elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer
+  #include <SimpleTimer.h>
+#endif
+
+/**
+ * \brief Object instancing the SdFat library.
+ *
+ * principal object for handling all SdCard functions.
+ */
+SdFat sd;
+
+/**
+ * \brief Object instancing the SFEMP3Shield library.
+ *
+ * principal object for handling all the attributes, members and functions for the library.
+ */
+SFEMP3Shield MP3player;
+
+/**
+ * \brief Filename of the sound bank, in the root of the SdCard.
+ */
+char bankName[] = "SOUNDS.BNK";
+
+/**
+ * \brief id of the clip being entered on the Serial port.
+ */
+uint16_t id = 0;
+
+/**
+ * \brief Number of digits of the id entered so far.
+ */
+uint8_t digits = 0;
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Setup the Arduino Chip's feature for our use.
+ *
+ * Initialize the SdCard and MP3player, then open the sound bank.
+ *
+ * \see
+ * \ref Error_Codes
+ */
+void setup() {
+
+  uint8_t result; //result code from some function as to be tested at later time.
+
+  Serial.begin(115200);
+
+  //Initialize the SdCard.
+  if(!sd.begin(SD_SEL, SPI_FULL_SPEED)) sd.initErrorHalt();
+  if(!sd.chdir("/")) sd.errorHalt("sd.chdir");
+
+  //Initialize the MP3 Player Shield
+  result = MP3player.begin();
+  if(result != 0) {
+    Serial.print(F("Error code: "));
+    Serial.print(result);
+    Serial.println(F(" when trying to start MP3 player"));
+  }
+
+  result = MP3player.openBank(bankName);
+  if(result != 0) {
+    Serial.print(F("Error code: "));
+    Serial.print(result);
+    Serial.println(F(" when trying to open SOUNDS.BNK"));
+  }
+
+  Serial.println(F("Enter the id of a clip to play."));
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Main Loop the Arduino Chip
+ *
+ * Collects the digits of an id from the Serial port, and plays the clip at
+ * the end of the line.
+ */
+void loop() {
+
+// Below is only needed if not interrupt driven. Safe to remove if not using.
+#if defined(USE_MP3_REFILL_MEANS) \
+    && ( (USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer) \
+    ||   (USE_MP3_REFILL_MEANS == USE_MP3_Polled)      )
+
+  MP3player.available();
+#endif
+
+  if(Serial.available()) {
+    char c = Serial.read();
+    if((c >= '0') && (c <= '9')) {
+      id = (id * 10) + (c - '0');
+      digits++;
+    } else if(digits && ((c == '\n') || (c == '\r'))) {
+      if(MP3player.isPlaying()) MP3player.stopTrack();
+
+      uint32_t t0 = micros();
+      uint8_t result = MP3player.playBankClip(id);
+      uint32_t us = micros() - t0;
+
+      Serial.print(F("clip "));
+      Serial.print(id);
+      if(result != 0) {
+        Serial.print(F(" error code: "));
+        Serial.println(result);
+      } else {
+        Serial.print(F(" started in "));
+        Serial.print(us);
+        Serial.println(F("us"));
+      }
+      id = 0;
+      digits = 0;
+    }
+  }
+}
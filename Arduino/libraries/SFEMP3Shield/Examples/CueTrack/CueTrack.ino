@@ -0,0 +1,214 @@
+/**
+ * \file CueTrack.ino
+ *
+ * \brief Example sketch driving LEDs and a relay in sync with a track
+ * \remarks comments are implemented with Doxygen Markdown format
+ *
+ * This sketch listens for a key from a serial terminal (such as the Serial
+ * Monitor in the Arduino IDE).
+ * - any digit plays that trackn.mp3, by playTrack(), with its cues.
+ * - 'f' and 'b' skip 5 seconds forward and back, the cues follow.
+ * - 'x' stops the track.
+ * - 's' prints the position and how late the cues have been.
+ *
+ * Each trackn.mp3 may have a trackn.cue beside it. Create it on the PC from
+ * a text list, such as
+ * \code
+ * # time     action channel value
+ * 0          1      0       0      # LED 0 off
+ * 0:01.250   1      0       255    # LED 0 full on
+ * 0:02.000   2      2       1      # relay on
+ * 0:04.500   2      2       0      # relay off
+ * \endcode
+ * with
+ * \code mk_cue.pl show.txt TRACK001.CUE \endcode
+ * using plugins/mk_cue.pl.
+ *
+ * Action 1 writes the value to a PWM channel, action 2 switches a digital
+ * channel, other actions are printed.
+ *
+ * \note Requires USE_CUE_TRACK set to 1 in SFEMP3ShieldConfig.h.
+ */
+
+#include <SPI.h>
+
+//Add the SdFat Libraries
+#include <SdFat.h>
+#include <SdFatUtil.h>
+
+//and the MP3 Shield Library
+#include <SFEMP3Shield.h>
+
+// Below is not needed if interrupt driven. Safe to remove if not using.
+#if defined(USE_MP3_REFILL_MEANS) \
+    && ( (USE_MP3_REFILL_MEANS == USE_MP3_Timer1) \
+    ||   (USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog) )
+  #include <TimerOne.h>
+#elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer
+  #include <SimpleTimer.h>
+#endif
+
+#if !USE_CUE_TRACK
+  #error Set USE_CUE_TRACK to 1 in SFEMP3ShieldConfig.h
+#endif
+
+/**
+ * \brief Object instancing the SdFat library.
+ *
+ * principal object for handling all SdCard functions.
+ */
+SdFat sd;
+
+/**
+ * \brief Object instancing the SFEMP3Shield library.
+ *
+ * principal object for handling all the attributes, members and functions for the library.
+ */
+SFEMP3Shield MP3player;
+
+/**
+ * \brief Action of a cue writing its value to a PWM channel.
+ */
+#define CUE_PWM     1
+
+/**
+ * \brief Action of a cue switching a digital channel.
+ */
+#define CUE_DIGITAL 2
+
+/**
+ * \brief Pins of the cue channels, clear of those used by the shield.
+ *
+ * Channels 0 and 1 are PWM, on Timer2 and Timer0. Channel 2 is digital only,
+ * pin 10 being SS and its PWM on Timer1, which the refill may use.
+ */
+const uint8_t cuePins[] = {3, 5, 4};
+
+/**
+ * \brief Number of cues taken since the track started.
+ */
+uint16_t cuesTaken;
+
+/**
+ * \brief Most milliseconds a cue has been taken after its time.
+ */
+uint32_t maxLate;
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Setup the Arduino Chip's feature for our use.
+ *
+ * Initialize the SdCard, the cue channels and the MP3player.
+ *
+ * \see
+ * \ref Error_Codes
+ */
+void setup() {
+
+  uint8_t result; //result code from some function as to be tested at later time.
+
+  Serial.begin(115200);
+
+  for(uint8_t i = 0; i < sizeof(cuePins); i++) {
+    pinMode(cuePins[i], OUTPUT);
+    digitalWrite(cuePins[i], LOW);
+  }
+
+  //Initialize the SdCard.
+  if(!sd.begin(SD_SEL, SPI_FULL_SPEED)) sd.initErrorHalt();
+  if(!sd.chdir("/")) sd.errorHalt("sd.chdir");
+
+  //Initialize the MP3 Player Shield
+  result = MP3player.begin();
+  if(result != 0) {
+    Serial.print(F("Error code: "));
+    Serial.print(result);
+    Serial.println(F(" when trying to start MP3 player"));
+  }
+
+  Serial.println(F("Keys 0-9 play, f/b skip, x stop, s stats."));
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Act on a cue.
+ */
+void doCue(cue_m* cue) {
+  if((cue->action == CUE_PWM) && (cue->channel < sizeof(cuePins))) {
+    analogWrite(cuePins[cue->channel], cue->value);
+  } else if((cue->action == CUE_DIGITAL) && (cue->channel < sizeof(cuePins))) {
+    digitalWrite(cuePins[cue->channel], cue->value ? HIGH : LOW);
+  } else {
+    Serial.print(F("cue "));
+    Serial.print(cue->action);
+    Serial.print(',');
+    Serial.print(cue->channel);
+    Serial.print(',');
+    Serial.print(cue->value);
+    Serial.print(F(" at "));
+    Serial.println(cue->time);
+  }
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Main Loop the Arduino Chip
+ *
+ * Takes every cue that is due, then acts on any key received. Keep the loop
+ * short, the cues are only as accurate as it is frequent.
+ */
+void loop() {
+  uint8_t result = 0;
+  cue_m cue;
+
+// Below is only needed if not interrupt driven. Safe to remove if not using.
+#if defined(USE_MP3_REFILL_MEANS) \
+    && ( (USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer) \
+    ||   (USE_MP3_REFILL_MEANS == USE_MP3_Polled)      )
+
+  MP3player.available();
+#endif
+
+  while(MP3player.nextCue(&cue)) {
+    uint32_t late = MP3player.currentPosition() - cue.time;
+    if(late > maxLate) maxLate = late;
+    cuesTaken++;
+    doCue(&cue);
+  }
+
+  if(!Serial.available()) return;
+  char key = Serial.read();
+
+  if((key >= '0') && (key <= '9')) {
+    MP3player.stopTrack();
+    cuesTaken = 0;
+    maxLate = 0;
+    result = MP3player.playTrack(key - '0');
+    if((result == 0) && !MP3player.hasCues())
+      Serial.println(F("no cues for this track"));
+
+  } else if(key == 'f') {
+    result = MP3player.skip(5000);
+
+  } else if(key == 'b') {
+    result = MP3player.skip(-5000);
+
+  } else if(key == 'x') {
+    MP3player.stopTrack();
+
+  } else if(key == 's') {
+    Serial.print(F("position "));
+    Serial.print(MP3player.currentPosition());
+    Serial.print(F("ms, cues taken "));
+    Serial.print(cuesTaken);
+    Serial.print(F(", latest by "));
+    Serial.print(maxLate);
+    Serial.println(F("ms"));
+  }
+
+  if(result != 0) {
+    Serial.print(F("Error code: "));
+    Serial.print(result);
+    Serial.println(F(" when trying to play track"));
+  }
+}
@@ -33,7 +33,9 @@
 #include <SFEMP3Shield.h>
 
 // Below is not needed if interrupt driven. Safe to remove if not using.
-#if defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_Timer1
+#if defined(USE_MP3_REFILL_MEANS) \
+    && ( (USE_MP3_REFILL_MEANS == USE_MP3_Timer1) \
+    ||   (USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog) )
   #include <TimerOne.h>
 #elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer
   #include <SimpleTimer.h>
@@ -177,7 +179,7 @@ void loop() {
       while (file.openNext(sd.vwd(),O_READ))
       {
         file.getFilename(filename);
-        if ( isFnMusic(filename) ) {
+        if ( sniffFormat(&file) != fmt_unknown ) {
 
           if (count == fn_index) {
             Serial.print(F("Index "));
@@ -486,6 +488,9 @@ void parse_menu(byte key_command) {
       Serial.print(F("Error code: "));
       Serial.print(result);
       Serial.println(F(" when trying to skip track"));
+    } else {
+      Serial.print(F("blocks read = "));
+      Serial.println(MP3player.getSeekBlocks(), DEC);
     }
 
   } else if(key_command == 'k') {
@@ -612,15 +617,23 @@ void parse_menu(byte key_command) {
       Serial.println(F("Music Files found :"));
       SdFile file;
       char filename[13];
+      audio_format_m format;
       sd.chdir("/",true);
       uint16_t count = 1;
       while (file.openNext(sd.vwd(),O_READ))
       {
         file.getFilename(filename);
-        if ( isFnMusic(filename) ) {
+        if ( sniffFormat(&file, &format) != fmt_unknown ) {
           SerialPrintPaddedNumber(count, 5 );
           Serial.print(F(": "));
-          Serial.println(filename);
+          Serial.print(filename);
+          if (format.duration) {
+            // known without playing, such as of a WAV.
+            Serial.print(F(" "));
+            Serial.print(format.duration / 1000, DEC);
+            Serial.print(F("[seconds]"));
+          }
+          Serial.println();
           count++;
         }
         file.close();
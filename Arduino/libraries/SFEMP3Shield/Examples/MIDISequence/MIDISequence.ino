@@ -0,0 +1,159 @@
+/**
+ * \file MIDISequence.ino
+ *
+ * \brief Example sketch playing time-stamped MIDI sequences in real-time
+ * \remarks comments are implemented with Doxygen Markdown format
+ *
+ * This sketch starts real-time MIDI, then listens for a key from a serial
+ * terminal (such as the Serial Monitor in the Arduino IDE).
+ * - 'f' plays "SCORE.SEQ" from the root of the SdCard.
+ * - 'p' plays a short jingle from Flash.
+ * - 'x' stops the sequence.
+ * - 's' prints the latency and jitter of the events dispatched so far.
+ *
+ * Create the sequence on the PC from a Standard MIDI File with
+ * \code mk_seq.pl score.mid SCORE.SEQ \endcode
+ * or a Flash array, as the jingle below, with
+ * \code mk_seq.pl -c jingle jingle.mid jingle.h \endcode
+ * using plugins/mk_seq.pl.
+ *
+ * \note Requires USE_MIDI_SEQUENCER set to 1 in SFEMP3ShieldConfig.h, and the
+ * TimerOne library.
+ */
+
+#include <SPI.h>
+
+//Add the SdFat Libraries
+#include <SdFat.h>
+#include <SdFatUtil.h>
+
+//and the MP3 Shield Library
+#include <SFEMP3Shield.h>
+
+// Below is needed by the sequencer, as it is dispatched by Timer1.
+#include <TimerOne.h>
+
+#if !USE_MIDI_SEQUENCER
+  #error Set USE_MIDI_SEQUENCER to 1 in SFEMP3ShieldConfig.h
+#endif
+
+/**
+ * \brief Object instancing the SdFat library.
+ *
+ * principal object for handling all SdCard functions.
+ */
+SdFat sd;
+
+/**
+ * \brief Object instancing the SFEMP3Shield library.
+ *
+ * principal object for handling all the attributes, members and functions for the library.
+ */
+SFEMP3Shield MP3player;
+
+/**
+ * \brief Filename of the sequence, in the root of the SdCard.
+ */
+char scoreName[] = "SCORE.SEQ";
+
+/**
+ * \brief A short jingle in Flash, of a rising arpeggio over a hi-hat.
+ */
+PROGMEM const midi_event_m jingle[] = {
+  {{0xC0, 0x0B, 0x00}, 2,      0UL}, // Vibraphone
+  {{0x90, 0x3C, 0x64}, 3,      0UL},
+  {{0x99, 0x2A, 0x50}, 3,      0UL},
+  {{0x90, 0x40, 0x64}, 3, 150000UL},
+  {{0x99, 0x2A, 0x50}, 3, 150000UL},
+  {{0x90, 0x43, 0x64}, 3, 300000UL},
+  {{0x99, 0x2A, 0x50}, 3, 300000UL},
+  {{0x90, 0x48, 0x7F}, 3, 450000UL},
+  {{0x99, 0x31, 0x7F}, 3, 450000UL}, // Crash Cymbal
+  {{0xB0, 0x7B, 0x00}, 3, 1200000UL}, // All Notes Off
+};
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Setup the Arduino Chip's feature for our use.
+ *
+ * Initialize the SdCard and MP3player, then start real-time MIDI.
+ *
+ * \see
+ * \ref Error_Codes
+ */
+void setup() {
+
+  uint8_t result; //result code from some function as to be tested at later time.
+
+  Serial.begin(115200);
+
+  //Initialize the SdCard.
+  if(!sd.begin(SD_SEL, SPI_FULL_SPEED)) sd.initErrorHalt();
+  if(!sd.chdir("/")) sd.errorHalt("sd.chdir");
+
+  //Initialize the MP3 Player Shield
+  result = MP3player.begin();
+  if(result != 0) {
+    Serial.print(F("Error code: "));
+    Serial.print(result);
+    Serial.println(F(" when trying to start MP3 player"));
+  }
+
+  result = MP3player.midiBegin();
+  if(result != 0) {
+    Serial.print(F("Error code: "));
+    Serial.print(result);
+    Serial.println(F(" when trying to start real-time MIDI"));
+  }
+
+  Serial.println(F("Keys f file, p Flash jingle, x stop, s stats."));
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Main Loop the Arduino Chip
+ *
+ * Keeps the sequence read ahead, then acts on any key received.
+ */
+void loop() {
+  uint8_t result = 0;
+
+  MP3player.sequenceAvailable();
+
+  if(!Serial.available()) return;
+  char key = Serial.read();
+
+  if(key == 'f') {
+    MP3player.stopSequence();
+    result = MP3player.playSequence(scoreName);
+
+  } else if(key == 'p') {
+    MP3player.stopSequence();
+    result = MP3player.playSequence_P(jingle, sizeof(jingle) / sizeof(jingle[0]));
+
+  } else if(key == 'x') {
+    MP3player.stopSequence();
+    MP3player.controlChange(0, 123, 0); // All Notes Off.
+
+  } else if(key == 's') {
+    midi_stats_m stats;
+    MP3player.getMidiStats(&stats);
+    Serial.print(F("sent "));
+    Serial.print(stats.sent);
+    Serial.print(F(", latency min "));
+    Serial.print(stats.minLatency);
+    Serial.print(F("us, max "));
+    Serial.print(stats.maxLatency);
+    Serial.print(F("us, avg "));
+    Serial.print(stats.sent ? stats.totalLatency / stats.sent : 0);
+    Serial.print(F("us, jitter "));
+    Serial.print(stats.maxLatency - stats.minLatency);
+    Serial.println(F("us"));
+  }
+
+  if(result != 0) {
+    Serial.print(F("Error code: "));
+    Serial.print(result);
+    Serial.println(F(" when trying to play sequence"));
+  }
+}
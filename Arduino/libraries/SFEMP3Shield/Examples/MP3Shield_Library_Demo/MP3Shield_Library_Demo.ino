@@ -28,7 +28,9 @@
 #include <SFEMP3Shield.h>
 
 // Below is not needed if interrupt driven. Safe to remove if not using.
-#if defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_Timer1
+#if defined(USE_MP3_REFILL_MEANS) \
+    && ( (USE_MP3_REFILL_MEANS == USE_MP3_Timer1) \
+    ||   (USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog) )
   #include <TimerOne.h>
 #elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer
   #include <SimpleTimer.h>
@@ -274,14 +276,16 @@ void parse_menu(byte key_command) {
 
   /* Display the file on the SdCard */
   } else if(key_command == 'd') {
-    if(!MP3player.isPlaying()) {
-      // prevent root.ls when playing, something locks the dump. but keeps playing.
-      // yes, I have tried another unique instance with same results.
-      // something about SdFat and its 500byte cache.
-      Serial.println(F("Files found (name date time size):"));
-      sd.ls(LS_R | LS_DATE | LS_SIZE);
-    } else {
-      Serial.println(F("Busy Playing Files, try again later."));
+    // SdSpiBus defers refills while SdFat is busy, so this is safe while playing.
+    Serial.println(F("Files found (name date time size):"));
+    SdSpiBus::clearStats();
+    sd.ls(LS_R | LS_DATE | LS_SIZE);
+    if(MP3player.isPlaying()) {
+      Serial.print(F("Refills deferred: "));
+      Serial.print(SdSpiBus::deferCount());
+      Serial.print(F(", worst DREQ delay: "));
+      Serial.print(SdSpiBus::maxDeferMicros());
+      Serial.println(F(" us"));
     }
 
   /* Get and Display the Audio Information */
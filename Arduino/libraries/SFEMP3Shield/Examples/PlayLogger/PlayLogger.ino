@@ -0,0 +1,190 @@
+/**
+ * \file PlayLogger.ino
+ *
+ * \brief Example sketch logging play events to the SdCard while playing
+ * \remarks comments are implemented with Doxygen Markdown format
+ *
+ * This sketch listens for a key from a serial terminal (such as the Serial
+ * Monitor in the Arduino IDE).
+ * - any digit plays that trackn.mp3, by playTrack().
+ * - 'x' stops the track.
+ * - 's' prints the log's size and timing.
+ * - 'c' closes the log, which may then be read on the PC.
+ *
+ * Each start, stop and end of a track is appended to PLAY.LOG as a line of
+ * "millis,event,track" by an SdLogger. The log is synced every SYNC_PERIOD
+ * ms and as each track ends, so at most that much is lost to a reset. After
+ * a reset the same log is appended after its last synced line.
+ */
+
+#include <SPI.h>
+
+//Add the SdFat Libraries
+#include <SdFat.h>
+#include <SdFatUtil.h>
+
+//and the MP3 Shield Library
+#include <SFEMP3Shield.h>
+
+// Below is not needed if interrupt driven. Safe to remove if not using.
+#if defined(USE_MP3_REFILL_MEANS) \
+    && ( (USE_MP3_REFILL_MEANS == USE_MP3_Timer1) \
+    ||   (USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog) )
+  #include <TimerOne.h>
+#elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer
+  #include <SimpleTimer.h>
+#endif
+
+/**
+ * \brief Object instancing the SdFat library.
+ *
+ * principal object for handling all SdCard functions.
+ */
+SdFat sd;
+
+/**
+ * \brief Object instancing the SFEMP3Shield library.
+ *
+ * principal object for handling all the attributes, members and functions for the library.
+ */
+SFEMP3Shield MP3player;
+
+/**
+ * \brief Object instancing the play event log.
+ */
+SdLogger playLog;
+
+/**
+ * \brief Bytes preallocated for the log.
+ */
+#define LOG_SIZE (64UL * 1024)
+
+/**
+ * \brief Milliseconds between syncs of the log.
+ */
+#define SYNC_PERIOD 10000
+
+/**
+ * \brief Track playing, or -1 if none.
+ */
+int8_t playing = -1;
+
+/**
+ * \brief millis() of the last sync of the log.
+ */
+uint32_t lastSync;
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Append a line of "millis,event,track" to the log.
+ */
+void logEvent(const __FlashStringHelper* event, int8_t track) {
+  playLog.print(millis());
+  playLog.print(',');
+  playLog.print(event);
+  playLog.print(',');
+  playLog.println(track);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Setup the Arduino Chip's feature for our use.
+ *
+ * Initialize the SdCard, open the log and initialize the MP3player.
+ *
+ * \see
+ * \ref Error_Codes
+ */
+void setup() {
+
+  uint8_t result; //result code from some function as to be tested at later time.
+
+  Serial.begin(115200);
+
+  //Initialize the SdCard.
+  if(!sd.begin(SD_SEL, SPI_FULL_SPEED)) sd.initErrorHalt();
+  if(!sd.chdir("/")) sd.errorHalt("sd.chdir");
+
+  //Create or resume the log.
+  if(!playLog.begin(sd.vwd(), "PLAY.LOG", LOG_SIZE)) sd.errorHalt("playLog.begin");
+  logEvent(F("reset"), -1);
+
+  //Initialize the MP3 Player Shield
+  result = MP3player.begin();
+  if(result != 0) {
+    Serial.print(F("Error code: "));
+    Serial.print(result);
+    Serial.println(F(" when trying to start MP3 player"));
+  }
+
+  Serial.println(F("Keys 0-9 play, x stop, s stats, c close log."));
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Main Loop the Arduino Chip
+ *
+ * Logs the end of a track and syncs the log when due, then acts on any key
+ * received.
+ */
+void loop() {
+  uint8_t result = 0;
+
+// Below is only needed if not interrupt driven. Safe to remove if not using.
+#if defined(USE_MP3_REFILL_MEANS) \
+    && ( (USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer) \
+    ||   (USE_MP3_REFILL_MEANS == USE_MP3_Polled)      )
+
+  MP3player.available();
+#endif
+
+  if((playing >= 0) && !MP3player.isPlaying()) {
+    logEvent(F("end"), playing);
+    playing = -1;
+    playLog.sync();
+    lastSync = millis();
+  }
+
+  if(playLog.isOpen() && ((millis() - lastSync) >= SYNC_PERIOD)) {
+    playLog.sync();
+    lastSync = millis();
+  }
+
+  if(!Serial.available()) return;
+  char key = Serial.read();
+
+  if((key >= '0') && (key <= '9')) {
+    if(playing >= 0) logEvent(F("stop"), playing);
+    MP3player.stopTrack();
+    result = MP3player.playTrack(key - '0');
+    if(result == 0) {
+      playing = key - '0';
+      logEvent(F("start"), playing);
+    }
+
+  } else if(key == 'x') {
+    if(playing >= 0) logEvent(F("stop"), playing);
+    playing = -1;
+    MP3player.stopTrack();
+
+  } else if(key == 's') {
+    Serial.print(F("log "));
+    Serial.print(playLog.size());
+    Serial.print(F(" bytes, dropped "));
+    Serial.print(playLog.dropped());
+    Serial.print(F(", longest block write "));
+    Serial.print(playLog.maxWriteMicros());
+    Serial.print(F("us, longest deferred refill "));
+    Serial.print(SdSpiBus::maxDeferMicros());
+    Serial.println(F("us"));
+
+  } else if(key == 'c') {
+    if(!playLog.close()) Serial.println(F("close failed"));
+  }
+
+  if(result != 0) {
+    Serial.print(F("Error code: "));
+    Serial.print(result);
+    Serial.println(F(" when trying to play track"));
+  }
+}
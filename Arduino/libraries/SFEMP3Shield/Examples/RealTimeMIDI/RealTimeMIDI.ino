@@ -0,0 +1,158 @@
+/**
+ * \file RealTimeMIDI.ino
+ *
+ * \brief Example sketch of using the VS1053 as a real-time MIDI sound module
+ * \remarks comments are implemented with Doxygen Markdown format
+ *
+ * This sketch loads rtmidi.053 from the root of the SdCard with midiBegin().
+ * Then plays notes as keys are received from a serial terminal (such as the
+ * Serial Monitor in the Arduino IDE), as a stand in for sensors and buttons.
+ * - 'a' through 'k' play a scale on channel 0, each held for NOTE_LENGTH ms.
+ * - '1' through '9' play a percussion instrument on channel 9.
+ * - '+' and '-' change channel 0's instrument.
+ * - 's' prints the latency and jitter of the messages sent so far.
+ *
+ * Each Note Off is sent from loop(), without blocking, when its note is due.
+ */
+
+#include <SPI.h>
+
+//Add the SdFat Libraries
+#include <SdFat.h>
+#include <SdFatUtil.h>
+
+//and the MP3 Shield Library
+#include <SFEMP3Shield.h>
+
+/**
+ * \brief Object instancing the SdFat library.
+ *
+ * principal object for handling all SdCard functions.
+ */
+SdFat sd;
+
+/**
+ * \brief Object instancing the SFEMP3Shield library.
+ *
+ * principal object for handling all the attributes, members and functions for the library.
+ */
+SFEMP3Shield MP3player;
+
+/**
+ * \brief Milliseconds each note of the scale is held.
+ */
+#define NOTE_LENGTH 300
+
+/**
+ * \brief MIDI notes of the scale, played by 'a' through 'k'.
+ */
+const uint8_t scale[] = {60, 62, 64, 65, 67, 69, 71, 72, 74, 76, 77};
+
+/**
+ * \brief Note of channel 0 sounding, or 0 if none.
+ */
+uint8_t sounding = 0;
+
+/**
+ * \brief millis() when the sounding note is to be released.
+ */
+uint32_t releaseAt;
+
+/**
+ * \brief Instrument of channel 0, the GM program less one.
+ */
+uint8_t program = 0;
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Setup the Arduino Chip's feature for our use.
+ *
+ * Initialize the SdCard and MP3player, then start real-time MIDI.
+ *
+ * \see
+ * \ref Error_Codes
+ */
+void setup() {
+
+  uint8_t result; //result code from some function as to be tested at later time.
+
+  Serial.begin(115200);
+
+  //Initialize the SdCard.
+  if(!sd.begin(SD_SEL, SPI_FULL_SPEED)) sd.initErrorHalt();
+  if(!sd.chdir("/")) sd.errorHalt("sd.chdir");
+
+  //Initialize the MP3 Player Shield
+  result = MP3player.begin();
+  if(result != 0) {
+    Serial.print(F("Error code: "));
+    Serial.print(result);
+    Serial.println(F(" when trying to start MP3 player"));
+  }
+
+  result = MP3player.midiBegin();
+  if(result != 0) {
+    Serial.print(F("Error code: "));
+    Serial.print(result);
+    Serial.println(F(" when trying to start real-time MIDI"));
+  }
+
+  MP3player.controlChange(0, 7, 127); // channel 0's volume to full.
+  MP3player.programChange(0, program);
+
+  Serial.println(F("Keys a-k play notes, 1-9 drums, +/- instrument, s stats."));
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Main Loop the Arduino Chip
+ *
+ * Releases the sounding note when due, then acts on any key received.
+ */
+void loop() {
+
+  // send any messages left queued while the VSdsp was busy.
+  MP3player.midiFlush();
+
+  if(sounding && ((int32_t)(millis() - releaseAt) >= 0)) {
+    MP3player.noteOff(0, sounding);
+    sounding = 0;
+  }
+
+  if(!Serial.available()) return;
+  char key = Serial.read();
+
+  if((key >= 'a') && (key <= 'k')) {
+    if(sounding) MP3player.noteOff(0, sounding);
+    sounding = scale[key - 'a'];
+    MP3player.noteOn(0, sounding, 100);
+    releaseAt = millis() + NOTE_LENGTH;
+
+  } else if((key >= '1') && (key <= '9')) {
+    // GM percussion from 35, Acoustic Bass Drum, in steps through the kit.
+    MP3player.noteOn(9, 35 + ((key - '1') * 3), 127);
+
+  } else if((key == '+') || (key == '-')) {
+    program = (program + ((key == '+') ? 1 : -1)) & 0x7F;
+    MP3player.programChange(0, program);
+    Serial.print(F("program "));
+    Serial.println(program);
+
+  } else if(key == 's') {
+    midi_stats_m stats;
+    MP3player.getMidiStats(&stats);
+    Serial.print(F("sent "));
+    Serial.print(stats.sent);
+    Serial.print(F(", stalls "));
+    Serial.print(stats.stalls);
+    Serial.print(F(", latency min "));
+    Serial.print(stats.minLatency);
+    Serial.print(F("us, max "));
+    Serial.print(stats.maxLatency);
+    Serial.print(F("us, avg "));
+    Serial.print(stats.sent ? stats.totalLatency / stats.sent : 0);
+    Serial.print(F("us, jitter "));
+    Serial.print(stats.maxLatency - stats.minLatency);
+    Serial.println(F("us"));
+  }
+}
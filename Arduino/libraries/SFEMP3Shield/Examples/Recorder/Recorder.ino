@@ -0,0 +1,164 @@
+/**
+ * \file Recorder.ino
+ *
+ * \brief Example sketch recording to a WAV file on the SdCard
+ * \remarks comments are implemented with Doxygen Markdown format
+ *
+ * This sketch listens for a key from a serial terminal (such as the Serial
+ * Monitor in the Arduino IDE).
+ * - 'r' records IMA ADPCM at 8000Hz to the next free RECnn.WAV.
+ * - 'p' records linear PCM at 16000Hz to the next free RECnn.WAV.
+ * - 's' stops recording, and prints its statistics.
+ * - any digit plays that RECn.WAV, by playMP3().
+ *
+ * Recording takes the microphone or line input, as per VS_LINE1_MODE. Each
+ * file is preallocated contiguous at RECORD_SIZE and truncated as stopped.
+ * A fresh card, with the free space unfragmented, is best.
+ */
+
+#include <SPI.h>
+
+//Add the SdFat Libraries
+#include <SdFat.h>
+#include <SdFatUtil.h>
+
+//and the MP3 Shield Library
+#include <SFEMP3Shield.h>
+
+// Below is not needed if interrupt driven. Safe to remove if not using.
+#if defined(USE_MP3_REFILL_MEANS) \
+    && ( (USE_MP3_REFILL_MEANS == USE_MP3_Timer1) \
+    ||   (USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog) )
+  #include <TimerOne.h>
+#elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer
+  #include <SimpleTimer.h>
+#endif
+
+/**
+ * \brief Object instancing the SdFat library.
+ *
+ * principal object for handling all SdCard functions.
+ */
+SdFat sd;
+
+/**
+ * \brief Object instancing the SFEMP3Shield library.
+ *
+ * principal object for handling all the attributes, members and functions for the library.
+ */
+SFEMP3Shield MP3player;
+
+/**
+ * \brief Bytes preallocated for each recording, 4 minutes of IMA ADPCM at 8000Hz.
+ */
+#define RECORD_SIZE (4UL * 60 * 4096)
+
+/**
+ * \brief Filename of the recording, numbered by nextName().
+ */
+char fileName[] = "REC00.WAV";
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Number fileName as the first RECnn.WAV not on the SdCard.
+ */
+void nextName() {
+  for(uint8_t n = 0; n < 100; n++) {
+    fileName[3] = '0' + (n / 10);
+    fileName[4] = '0' + (n % 10);
+    if(!sd.exists(fileName)) return;
+  }
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Setup the Arduino Chip's feature for our use.
+ *
+ * Initialize the SdCard and MP3player.
+ *
+ * \see
+ * \ref Error_Codes
+ */
+void setup() {
+
+  uint8_t result; //result code from some function as to be tested at later time.
+
+  Serial.begin(115200);
+
+  //Initialize the SdCard.
+  if(!sd.begin(SD_SEL, SPI_FULL_SPEED)) sd.initErrorHalt();
+  if(!sd.chdir("/")) sd.errorHalt("sd.chdir");
+
+  //Initialize the MP3 Player Shield
+  result = MP3player.begin();
+  if(result != 0) {
+    Serial.print(F("Error code: "));
+    Serial.print(result);
+    Serial.println(F(" when trying to start MP3 player"));
+  }
+
+  Serial.println(F("Keys r ADPCM, p PCM, s stop, 0-9 play RECn.WAV"));
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Main Loop the Arduino Chip
+ *
+ * Drains the recording, then acts on any key received.
+ */
+void loop() {
+  uint8_t result = 0;
+
+// Below is only needed if not interrupt driven. Safe to remove if not using.
+#if defined(USE_MP3_REFILL_MEANS) \
+    && ( (USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer) \
+    ||   (USE_MP3_REFILL_MEANS == USE_MP3_Polled)      )
+
+  MP3player.available();
+#endif
+
+  MP3player.recordAvailable();
+
+  if(!Serial.available()) return;
+  char key = Serial.read();
+
+  if((key == 'r') || (key == 'p')) {
+    nextName();
+    if(key == 'r') {
+      result = MP3player.startRecording(fileName, RECORD_SIZE);
+    } else {
+      result = MP3player.startRecording(fileName, RECORD_SIZE, 16000, true);
+    }
+    if(result == 0) {
+      Serial.print(F("Recording "));
+      Serial.println(fileName);
+    }
+
+  } else if(key == 's') {
+    record_stats_m stats;
+    MP3player.getRecordStats(&stats);
+    MP3player.stopRecording();
+    Serial.print(F("bytes "));
+    Serial.print(stats.bytes);
+    Serial.print(F(", peak fill "));
+    Serial.print(stats.peakFill);
+    Serial.print(F(" words, near full "));
+    Serial.print(stats.nearFull);
+    Serial.print(F(", overruns "));
+    Serial.print(stats.overruns);
+    Serial.print(F(", longest write "));
+    Serial.print(stats.maxWriteMicros);
+    Serial.println(F("us"));
+
+  } else if((key >= '0') && (key <= '9')) {
+    char name[] = "REC00.WAV";
+    name[4] = key;
+    MP3player.stopTrack();
+    result = MP3player.playMP3(name);
+  }
+
+  if(result != 0) {
+    Serial.print(F("Error code: "));
+    Serial.println(result);
+  }
+}
@@ -0,0 +1,159 @@
+/**
+ * \file RefillLoad.ino
+ *
+ * \brief Example sketch measuring the CPU time consumed by refilling the VS10xx
+ * \remarks comments are implemented with Doxygen Markdown format
+ *
+ * This sketch estimates how much of the CPU the SFEMP3Shield library consumes
+ * to keep the VS10xx's stream buffer full. It first counts how many iterations
+ * of an empty loop complete in MEASURE_MS with nothing playing. Then plays
+ * each of the files listed in testTracks[] and counts again. The difference is
+ * the share of the CPU that was spent in refill().
+ *
+ * Copy the files to the root of the SdCard, or change testTracks[] to match.
+ * Each should play for longer than SETTLE_MS plus MEASURE_MS.
+ * For example a 128 kbps MP3, a 320 kbps MP3 and a FLAC, to compare the
+ * default per byte SPI.transfer() refill on AVR against the block buffered
+ * DMA refill of MP3_REFILL_DMA on a Due or Teensy 3.
+ *
+ * \note FLAC requires the VLSI patches.053 on the SdCard, loaded by begin().
+ */
+
+#include <SPI.h>
+
+//Add the SdFat Libraries
+#include <SdFat.h>
+#include <SdFatUtil.h>
+
+//and the MP3 Shield Library
+#include <SFEMP3Shield.h>
+
+// Below is not needed if interrupt driven. Safe to remove if not using.
+#if defined(USE_MP3_REFILL_MEANS) \
+    && ( (USE_MP3_REFILL_MEANS == USE_MP3_Timer1) \
+    ||   (USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog) )
+  #include <TimerOne.h>
+#elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer
+  #include <SimpleTimer.h>
+#endif
+
+/**
+ * \brief Object instancing the SdFat library.
+ *
+ * principal object for handling all SdCard functions.
+ */
+SdFat sd;
+
+/**
+ * \brief Object instancing the SFEMP3Shield library.
+ *
+ * principal object for handling all the attributes, members and functions for the library.
+ */
+SFEMP3Shield MP3player;
+
+/**
+ * \brief Milliseconds over which each loop count is taken.
+ */
+#define MEASURE_MS 5000
+
+/**
+ * \brief Milliseconds to let each track's playback settle before counting.
+ */
+#define SETTLE_MS  1000
+
+/**
+ * \brief Files to be measured, 8.3 filenames in the root of the SdCard.
+ */
+char testTracks[][13] = {"mp3_128.mp3", "mp3_320.mp3", "flac.fla"};
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Count the iterations of an empty loop.
+ *
+ * \param[in] ms duration of the count in milliseconds.
+ * \return number of iterations completed in \c ms.
+ *
+ * Whatever time refill() takes away from this loop, directly as an interrupt
+ * or through available(), reduces the count.
+ */
+uint32_t countLoops(uint32_t ms) {
+  uint32_t count = 0;
+  uint32_t start = millis();
+
+  while((millis() - start) < ms) {
+// Below is only needed if not interrupt driven. Safe to remove if not using.
+#if defined(USE_MP3_REFILL_MEANS) \
+    && ( (USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer) \
+    ||   (USE_MP3_REFILL_MEANS == USE_MP3_Polled)      )
+    if(MP3player.isPlaying()) MP3player.available();
+#endif
+    count++;
+  }
+  return count;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Setup the Arduino Chip's feature for our use.
+ *
+ * Initialize the SdCard and MP3player, then take the idle count followed by
+ * the count while playing each of testTracks[]. Printing the resulting CPU
+ * utilization of each.
+ */
+void setup() {
+
+  uint8_t result; //result code from some function as to be tested at later time.
+
+  Serial.begin(115200);
+
+  Serial.print(F("F_CPU = "));
+  Serial.println(F_CPU);
+  Serial.print(F("MP3_REFILL_DMA = "));
+  Serial.println(MP3_REFILL_DMA);
+
+  //Initialize the SdCard.
+  if(!sd.begin(SD_SEL, SPI_FULL_SPEED)) sd.initErrorHalt();
+  if(!sd.chdir("/")) sd.errorHalt("sd.chdir");
+
+  //Initialize the MP3 Player Shield
+  result = MP3player.begin();
+  if(result != 0) {
+    Serial.print(F("Error code: "));
+    Serial.print(result);
+    Serial.println(F(" when trying to start MP3 player"));
+  }
+
+  uint32_t idle = countLoops(MEASURE_MS);
+  Serial.print(F("idle loops: "));
+  Serial.println(idle);
+
+  for(uint8_t i = 0; i < sizeof(testTracks) / sizeof(testTracks[0]); i++) {
+    Serial.print(testTracks[i]);
+
+    result = MP3player.playMP3(testTracks[i]);
+    if(result != 0) {
+      Serial.print(F(" error code: "));
+      Serial.println(result);
+      continue;
+    }
+    countLoops(SETTLE_MS);
+    uint32_t busy = countLoops(MEASURE_MS);
+    MP3player.stopTrack();
+
+    Serial.print(F(" loops: "));
+    Serial.print(busy);
+    Serial.print(F(" CPU used by refill: "));
+    Serial.print(100.0 * ((float) idle - busy) / idle, 1);
+    Serial.println(F("%"));
+  }
+  Serial.println(F("Done."));
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Main Loop the Arduino Chip
+ *
+ * Nothing to do, all measurements are taken once in setup().
+ */
+void loop() {
+}
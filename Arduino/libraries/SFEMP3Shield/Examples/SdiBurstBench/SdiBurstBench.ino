@@ -0,0 +1,154 @@
+/**
+ * \file SdiBurstBench.ino
+ *
+ * \brief Example sketch benchmarking the SFEMP3Shield's SDI burst primitives
+ * \remarks comments are implemented with Doxygen Markdown format
+ *
+ * This sketch times sending 32 byte bursts over the SPI, as refill() does, by
+ * each of the following means. Then prints the resulting bytes per microsecond.
+ * - a SPI.transfer() per byte, as the library previously did.
+ * - SFEMP3Shield::sdi_send() from a RAM buffer, as used by refill().
+ * - SFEMP3Shield::sdi_send_P() from Flash, as used by SendSingleMIDInote().
+ * - SFEMP3Shield::sdi_fill() of a constant, as used by flush_cancel().
+ *
+ * No chip is selected while the bursts are sent, so neither the VS10xx nor
+ * the SdCard see the data. The SPI is clocked at the VS10xx's write rate,
+ * SPI_CLOCK_DIV2, to match refill().
+ */
+
+#include <SPI.h>
+
+//Add the SdFat Libraries
+#include <SdFat.h>
+#include <SdFatUtil.h>
+
+//and the MP3 Shield Library
+#include <SFEMP3Shield.h>
+
+/**
+ * \brief Object instancing the SdFat library.
+ *
+ * principal object for handling all SdCard functions.
+ */
+SdFat sd;
+
+/**
+ * \brief SFEMP3Shield with its SDI burst primitives made public.
+ *
+ * sdi_send(), sdi_send_P() and sdi_fill() are protected, as they neither
+ * select the VS10xx nor wait for DREQ. This benchmark calls them directly.
+ */
+class SdiBench : public SFEMP3Shield {
+  public:
+    using SFEMP3Shield::sdi_send;
+    using SFEMP3Shield::sdi_send_P;
+    using SFEMP3Shield::sdi_fill;
+};
+
+/**
+ * \brief Object instancing the SFEMP3Shield library.
+ *
+ * principal object for handling all the attributes, members and functions for the library.
+ */
+SdiBench MP3player;
+
+/**
+ * \brief Number of 32 byte bursts sent per measurement.
+ */
+#define BURSTS 1000
+
+/**
+ * \brief RAM source of the bursts.
+ */
+uint8_t ramBurst[32];
+
+/**
+ * \brief Flash source of the bursts.
+ */
+PROGMEM const uint8_t flashBurst[32] = {
+  0x4D, 0x54, 0x68, 0x64, 0x00, 0x00, 0x00, 0x06,
+  0x00, 0x00, 0x00, 0x01, 0x00, 0x60, 0x4D, 0x54,
+  0x72, 0x6B, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x99,
+  0x38, 0x7F, 0x64, 0x89, 0x38, 0x7F, 0x00, 0xFF
+};
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Print the rate of one measurement.
+ *
+ * \param[in] name of the means measured, in Flash.
+ * \param[in] us elapsed microseconds for BURSTS of 32 bytes.
+ */
+void printRate(const __FlashStringHelper* name, uint32_t us) {
+  Serial.print(name);
+  Serial.print(F(": "));
+  Serial.print(us);
+  Serial.print(F(" us, "));
+  Serial.print((float) BURSTS * 32 / us, 3);
+  Serial.println(F(" bytes/us"));
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Setup the Arduino Chip's feature for our use.
+ *
+ * Initialize the SdCard and MP3player, as to configure the SPI. Then take and
+ * print each of the measurements.
+ */
+void setup() {
+  uint32_t t0;
+
+  Serial.begin(115200);
+
+  Serial.print(F("F_CPU = "));
+  Serial.println(F_CPU);
+
+  //Initialize the SdCard.
+  if(!sd.begin(SD_SEL, SPI_FULL_SPEED)) sd.initErrorHalt();
+
+  //Initialize the MP3 Player Shield
+  MP3player.begin();
+
+  for(uint8_t i = 0; i < sizeof(ramBurst); i++) ramBurst[i] = i;
+
+  // clock the bus as refill() would, and tell SdSpiBus it was changed.
+  SPI.setBitOrder(MSBFIRST);
+  SPI.setDataMode(SPI_MODE0);
+  SPI.setClockDivider(SPI_CLOCK_DIV2);
+  SdSpiBus::invalidate();
+
+  t0 = micros();
+  for(uint16_t n = 0; n < BURSTS; n++) {
+    for(uint8_t i = 0; i < sizeof(ramBurst); i++) {
+      SPI.transfer(ramBurst[i]);
+    }
+  }
+  printRate(F("SPI.transfer per byte"), micros() - t0);
+
+  t0 = micros();
+  for(uint16_t n = 0; n < BURSTS; n++) {
+    MP3player.sdi_send(ramBurst, sizeof(ramBurst));
+  }
+  printRate(F("sdi_send from RAM    "), micros() - t0);
+
+  t0 = micros();
+  for(uint16_t n = 0; n < BURSTS; n++) {
+    MP3player.sdi_send_P(flashBurst, sizeof(flashBurst));
+  }
+  printRate(F("sdi_send_P from Flash"), micros() - t0);
+
+  t0 = micros();
+  for(uint16_t n = 0; n < BURSTS; n++) {
+    MP3player.sdi_fill(0x00, 32);
+  }
+  printRate(F("sdi_fill constant    "), micros() - t0);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Main Loop the Arduino Chip
+ *
+ * Nothing to do, all measurements are taken once in setup().
+ */
+void loop() {
+}
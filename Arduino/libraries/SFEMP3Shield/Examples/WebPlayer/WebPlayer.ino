@@ -15,6 +15,12 @@
  * \code #define USE_MP3_REFILL_MEANS USE_MP3_Polled \endcode
  * as the Ethernet library makes interrupts not possible.
  * any one with a fix, let me know.
+ * Alternatively USE_MP3_INTxWatchdog keeps the interrupt driven refill, with
+ * Timer1 catching the DREQ edges missed while the Ethernet has interrupts off.
+ * The number of such rescues is printed after each request. As the W5100
+ * takes the SPI without SdSpiBus, loop() holds SdSpiBus::lock() across its
+ * Ethernet calls, so that a refill interrupt defers rather than clock the
+ * VS10xx in the middle of an Ethernet transfer.
  */
 
 #include <SdFat.h>
@@ -23,7 +29,9 @@
 #include <SPI.h>
 
 // Below is not needed if interrupt driven. Safe to remove if not using.
-#if defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_Timer1
+#if defined(USE_MP3_REFILL_MEANS) \
+    && ( (USE_MP3_REFILL_MEANS == USE_MP3_Timer1) \
+    ||   (USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog) )
   #include <TimerOne.h>
 #elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer
   #include <SimpleTimer.h>
@@ -115,6 +123,10 @@ void ListFiles(EthernetClient client, uint8_t flags) {
   sd.vwd()->rewind();
   client.println(F("<ul>"));
   while (sd.vwd()->readDir(&p) > 0) {
+    // let a refill deferred by the last entry's Ethernet transfer run
+    SdSpiBus::unlock();
+    SdSpiBus::lock();
+
     // done if past last used entry
     if (p.name[0] == DIR_NAME_FREE) break;
 
@@ -193,6 +205,8 @@ void loop()
   MP3player.available();
 #endif
 
+  // keep refill off the SPI while the W5100 is on it, see the file's warning
+  SdSpiBus::lock();
   EthernetClient client = server.available();
   if (client) {
     // an http request ends with a blank line
@@ -202,6 +216,10 @@ void loop()
     index = 0;
 
     while (client.connected()) {
+      // run any refill deferred by the Ethernet, between its transfers
+      SdSpiBus::unlock();
+      SdSpiBus::lock();
+
       if (client.available()) {
         char c = client.read();
 
@@ -401,6 +419,8 @@ void loop()
 
             int16_t c;
             while ((c = file.read()) > 0) {
+                SdSpiBus::unlock();
+                SdSpiBus::lock();
                 // uncomment the serial to debug (slow!)
                 Serial.print((char)c);
                 client.print((char)c);
@@ -418,9 +438,17 @@ void loop()
       }
     }
     // give the web browser time to receive the data
+    SdSpiBus::unlock();
     delay(1000);
+    SdSpiBus::lock();
     client.stop();
+
+#if defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog
+    Serial.print(F("refill watchdog rescues: "));
+    Serial.println(MP3player.getRefillRescues());
+#endif
   }
+  SdSpiBus::unlock();
 }
 
 void ButtonForm(EthernetClient client, char* name, char* value) {
@@ -12,6 +12,25 @@
 //avr pgmspace library for storing the LUT in program flash instead of sram
 #include <avr/pgmspace.h>
 
+/**
+ * \brief Begin a critical section, saving the interrupt flag.
+ *
+ * Paired with MP3_ATOMIC_END in the same scope, which restores the flag
+ * rather than always re-enabling interrupts. So either may be used where
+ * interrupts are already disabled, such as from refill(). SREG on AVR, PRIMASK
+ * on ARM.
+ */
+#if defined(__AVR__)
+#define MP3_ATOMIC_BEGIN uint8_t mp3_sreg = SREG; cli()
+#define MP3_ATOMIC_END SREG = mp3_sreg
+#elif defined(__arm__)
+#define MP3_ATOMIC_BEGIN uint32_t mp3_sreg = __get_PRIMASK(); __disable_irq()
+#define MP3_ATOMIC_END __set_PRIMASK(mp3_sreg)
+#else
+#define MP3_ATOMIC_BEGIN noInterrupts()
+#define MP3_ATOMIC_END interrupts()
+#endif
+
 /**
  * \brief bitrate lookup table
  *
@@ -81,6 +100,22 @@ PROGMEM const uint16_t bitrate_table[15][6] = {
  */
 PROGMEM const uint8_t SingleMIDInoteFile[] = {MIDI_HDR_CHUNK_ID, MIDI_CHUNKSIZE, MIDI_FORMAT, MIDI_NUMBER_OF_TRACKS, MIDI_TIME_DIVISION, MIDI_TRACK_CHUNK_ID, MIDI_CHUNK_SIZE, MIDI_EVENT_NOTE_ON, MIDI_EVENT_NOTE_OFF, MIDI_END_OF_TRACK};
 
+/**
+ * \brief Number of steps of the volume curve.
+ */
+#define VOLUME_CURVE_STEPS      32
+
+/**
+ * \brief Attenuation of the fade gain, in -0.5dB steps of SCI_VOL.
+ *
+ * Entry i being the attenuation of a gain of i/32, as -40 log10(i/32), and
+ * entry 0 silence. A fade moving evenly along it is an even fade of the
+ * amplitude, as heard. Interpolated between entries by volumeWord().
+ */
+PROGMEM const uint8_t vol_curve[VOLUME_CURVE_STEPS + 1] = {
+  254, 60, 48, 41, 36, 32, 29, 26, 24, 22, 20, 19, 17, 16, 14, 13,
+   12, 11, 10,  9,  8,  7,  7,  6,  5,  4,  4,  3,  2,  2,  1,  1, 0};
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /* Initialize static classes and variables
  */
@@ -107,8 +142,102 @@ uint16_t SFEMP3Shield::spi_Write_Rate;
   int timerId_mp3;
 #endif
 
+/**
+ * \brief Set while refill() is feeding the VSdsp.
+ *
+ * A DREQ interrupt, or a refill deferred by SdSpiBus, arriving meanwhile
+ * returns at once instead of nesting a second refill() into the transfer.
+ */
+volatile uint8_t SFEMP3Shield::refill_active = 0;
+volatile uint16_t SFEMP3Shield::refill_rescues = 0;
+
+uint32_t SFEMP3Shield::bank_firstBlock = 0;
+uint16_t SFEMP3Shield::bank_count = 0;
+midi_event_m SFEMP3Shield::midi_queue[MIDI_QUEUE_SIZE];
+uint8_t  SFEMP3Shield::midi_head = 0;
+uint8_t  SFEMP3Shield::midi_tail = 0;
+midi_stats_m SFEMP3Shield::midi_stats;
+
+uint16_t SFEMP3Shield::rec_fill = 0;
+uint32_t SFEMP3Shield::rec_block = 0;
+uint32_t SFEMP3Shield::rec_lastBlock = 0;
+uint8_t  SFEMP3Shield::rec_writing = 0;
+uint32_t SFEMP3Shield::rec_max = 0;
+uint16_t SFEMP3Shield::rec_rate = 0;
+uint8_t  SFEMP3Shield::rec_pcm = 0;
+record_stats_m SFEMP3Shield::rec_stats;
+
+#if USE_MIDI_SEQUENCER
+midi_event_m SFEMP3Shield::seq_buffer[MIDI_SEQ_BUFFER];
+volatile uint8_t SFEMP3Shield::seq_head = 0;
+volatile uint8_t SFEMP3Shield::seq_tail = 0;
+uint32_t SFEMP3Shield::seq_remaining = 0;
+const midi_event_m* SFEMP3Shield::seq_P = NULL;
+uint32_t SFEMP3Shield::seq_start = 0;
+volatile uint8_t SFEMP3Shield::seq_active = 0;
+#endif
+
+volatile uint32_t SFEMP3Shield::fade_pos = (uint32_t)VOLUME_CURVE_STEPS << 16;
+volatile int32_t SFEMP3Shield::fade_step = 0;
+volatile uint32_t SFEMP3Shield::fade_end = 0;
+volatile uint16_t SFEMP3Shield::fade_ticks = 0;
+volatile uint16_t SFEMP3Shield::fade_wait = 0;
+volatile uint32_t SFEMP3Shield::base_pos[2];
+volatile int32_t SFEMP3Shield::base_step[2];
+volatile uint8_t SFEMP3Shield::base_end[2];
+volatile uint16_t SFEMP3Shield::base_ticks = 0;
+volatile uint16_t SFEMP3Shield::vol_written = 0;
+volatile uint8_t SFEMP3Shield::vol_pending = 0;
+
+volatile uint32_t SFEMP3Shield::pos_fed = 0;
+uint32_t SFEMP3Shield::pos_segment = 0;
+uint32_t SFEMP3Shield::pos_segment_ms = 0;
+volatile uint16_t SFEMP3Shield::pos_latency = 0;
+volatile uint8_t SFEMP3Shield::pos_primed = 0;
+uint32_t SFEMP3Shield::pos_rate = 0;
+uint32_t SFEMP3Shield::pos_synced = 0;
+
+uint8_t  SFEMP3Shield::track_format = fmt_unknown;
+uint8_t  SFEMP3Shield::seek_parsed = 0;
+uint32_t SFEMP3Shield::seek_start = 0;
+uint32_t SFEMP3Shield::seek_end = 0;
+uint32_t SFEMP3Shield::seek_rate = 0;
+uint16_t SFEMP3Shield::seek_align = 0;
+uint32_t SFEMP3Shield::seek_table = 0;
+uint16_t SFEMP3Shield::seek_points = 0;
+uint32_t SFEMP3Shield::wav_fmt = 0;
+uint16_t SFEMP3Shield::wav_fmtSize = 0;
+uint16_t SFEMP3Shield::seek_blocks = 0;
+uint32_t SFEMP3Shield::seek_lastBlock = 0;
+
+#if USE_CUE_TRACK
+SdFile   SFEMP3Shield::cues;
+cue_m    SFEMP3Shield::cue_buffer[CUE_BUFFER];
+uint8_t  SFEMP3Shield::cue_head = 0;
+uint8_t  SFEMP3Shield::cue_tail = 0;
+uint32_t SFEMP3Shield::cue_remaining = 0;
+#endif
+
+uint32_t SFEMP3Shield::raw_firstBlock = 0;
+uint32_t SFEMP3Shield::raw_position = 0;
+uint32_t SFEMP3Shield::raw_end = 0;
+
 //buffer for music
-uint8_t  SFEMP3Shield::mp3DataBuffer[32];
+uint8_t  SFEMP3Shield::mp3BlockBuffer[512];
+uint16_t SFEMP3Shield::mp3BlockHead = 0;
+uint16_t SFEMP3Shield::mp3BlockCount = 0;
+
+#if MP3_REFILL_RAW
+uint32_t SFEMP3Shield::raw_nextBlock = 0;
+#endif
+
+#if MP3_REFILL_DMA
+
+/**
+ * \brief SdFat's native SPI driver, used for the DMA bursts to the VSdsp.
+ */
+static SdSpi sdi;
+#endif
 
 //------------------------------------------------------------------------------
 /**
@@ -167,6 +296,8 @@ if (int8_t(sd.vol()->fatType()) == 0) {
 
 #if defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_Timer1
   Timer1.initialize(MP3_REFILL_PERIOD);
+#elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog
+  Timer1.initialize(MP3_WATCHDOG_PERIOD);
 #elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer
   timerId_mp3 = timer.setInterval(MP3_REFILL_PERIOD, refill);
   timer.disable(timerId_mp3);
@@ -599,7 +730,305 @@ void SFEMP3Shield::setVolume(uint8_t leftchannel, uint8_t rightchannel){
 
   VolL = leftchannel;
   VolR = rightchannel;
-  Mp3WriteRegister(SCI_VOL, leftchannel, rightchannel);
+  MP3_ATOMIC_BEGIN;
+  base_ticks = 0;
+  base_pos[0] = (uint32_t)leftchannel << 16;
+  base_pos[1] = (uint32_t)rightchannel << 16;
+  MP3_ATOMIC_END;
+  writeVolume();
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Fade in to the master volume
+ *
+ * \param[in] ms duration of the fade in milliseconds.
+ *
+ * Raises the fade gain evenly to unity, where the output is the master volume
+ * set by setVolume() or fadeTo(). Returns at once, the fade is stepped by
+ * volumeTick(). A fade already running is taken from where it is.
+ *
+ * \note Immediate if ms is shorter than a tick, or USE_VOLUME_RAMP is 0.
+ */
+void SFEMP3Shield::fadeIn(uint16_t ms) {
+  fadeGain((uint32_t)VOLUME_CURVE_STEPS << 16, ms);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Fade out to silence
+ *
+ * \param[in] ms duration of the fade in milliseconds.
+ *
+ * Lowers the fade gain evenly to 0, where SCI_VOL is 0xFEFE, without changing
+ * the master volume. Returns at once, as fadeIn().
+ */
+void SFEMP3Shield::fadeOut(uint16_t ms) {
+  fadeGain(0, ms);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Ramp the master volume to a new level
+ *
+ * \param[in] leftchannel the left channel master volume to end at.
+ * \param[in] rightchannel the right channel master volume to end at.
+ * \param[in] ms duration of the ramp in milliseconds.
+ *
+ * As setVolume(), in -0.5dB steps, but moving evenly in dB from the current
+ * level. Returns at once, the ramp is stepped by volumeTick(). A ramp already
+ * running is taken from where it is.
+ */
+void SFEMP3Shield::fadeTo(uint8_t leftchannel, uint8_t rightchannel, uint16_t ms) {
+  uint16_t ticks = rampTicks(ms);
+
+  if(!ticks) {
+    setVolume(leftchannel, rightchannel);
+    return;
+  }
+  VolL = leftchannel;
+  VolR = rightchannel;
+  MP3_ATOMIC_BEGIN;
+  base_step[0] = (int32_t)(((uint32_t)leftchannel << 16) - base_pos[0]) / ticks;
+  base_step[1] = (int32_t)(((uint32_t)rightchannel << 16) - base_pos[1]) / ticks;
+  base_end[0] = leftchannel;
+  base_end[1] = rightchannel;
+  base_ticks = ticks;
+  MP3_ATOMIC_END;
+#if USE_VOLUME_RAMP
+  TIMSK0 |= _BV(OCIE0A); // start the ticks.
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Is a fade or ramp running
+ *
+ * Also writes the step pending, as available(), while nothing is played.
+ *
+ * \return true until the fade of fadeIn() or fadeOut(), and the ramp of
+ * fadeTo(), have reached their ends and SCI_VOL is written.
+ */
+bool SFEMP3Shield::isFading() {
+  volumeAvailable();
+  return fade_ticks || base_ticks || vol_pending;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Step the volume ramps
+ *
+ * Called every VOLUME_RAMP_TICK_US by Timer0's compare A interrupt, while
+ * a ramp is running. Counts down any fade_wait before the fade gain moves.
+ * Moves the fade gain and the master volume one step, and
+ * if SCI_VOL changed sets vol_pending. The tick never uses the SPI bus, as
+ * the main context may be between its wait for DREQ and selecting the VSdsp.
+ * The step is written by volumeWrite(), from refill() while playing, else
+ * from available() or isFading(). Stops the interrupt once both ramps have
+ * ended.
+ */
+void SFEMP3Shield::volumeTick() {
+
+  if(fade_wait) {
+    fade_wait--;
+  } else if(fade_ticks) {
+    if(--fade_ticks) fade_pos += fade_step;
+    else fade_pos = fade_end;
+  }
+  if(base_ticks) {
+    if(--base_ticks) {
+      base_pos[0] += base_step[0];
+      base_pos[1] += base_step[1];
+    } else {
+      base_pos[0] = (uint32_t)base_end[0] << 16;
+      base_pos[1] = (uint32_t)base_end[1] << 16;
+    }
+  }
+
+  uint16_t word = volumeWord();
+  if(word != vol_written) {
+    if(!digitalRead(MP3_RESET)) {
+      vol_written = word; // vs_init() will write the volume.
+    } else {
+      vol_pending = 1;
+    }
+  }
+
+#if USE_VOLUME_RAMP
+  if(!fade_ticks && !base_ticks)
+    TIMSK0 &= ~_BV(OCIE0A); // nothing left to do, stop the ticks.
+#endif
+}
+
+#if USE_VOLUME_RAMP
+/**
+ * \brief Timer0's compare A interrupt, stepping the volume ramps.
+ *
+ * Timer0 overflows every VOLUME_RAMP_TICK_US, keeping millis(). Its compare A
+ * matches once per overflow too, whatever OCR0A, so PWM on its pin is not
+ * disturbed.
+ */
+ISR(TIMER0_COMPA_vect) {
+  SFEMP3Shield::volumeTick();
+}
+#endif
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Start a ramp of the fade gain
+ *
+ * \param[in] end fade_pos at the end of the ramp.
+ * \param[in] ms duration of the ramp in milliseconds.
+ * \param[in] wait (optional) milliseconds before the ramp starts.
+ *
+ * Primative function of fadeIn() and fadeOut(). Steps evenly from the current
+ * fade_pos, or sets it and writes SCI_VOL at once if ms is less than a tick.
+ * A ramp started with a wait holds fade_pos until volumeTick() has counted
+ * it down, one shorter than a tick then jumping in a single step.
+ */
+void SFEMP3Shield::fadeGain(uint32_t end, uint16_t ms, uint16_t wait) {
+  uint16_t ticks = rampTicks(ms);
+  uint16_t waitTicks = rampTicks(wait);
+  if(!ticks && waitTicks) ticks = 1;
+
+  if(!ticks) {
+    MP3_ATOMIC_BEGIN;
+    fade_ticks = 0;
+    fade_wait = 0;
+    fade_pos = end;
+    MP3_ATOMIC_END;
+    writeVolume();
+    return;
+  }
+  MP3_ATOMIC_BEGIN;
+  fade_step = (int32_t)(end - fade_pos) / ticks;
+  fade_end = end;
+  fade_ticks = ticks;
+  fade_wait = waitTicks;
+  MP3_ATOMIC_END;
+#if USE_VOLUME_RAMP
+  TIMSK0 |= _BV(OCIE0A); // start the ticks.
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Wait for the fade gain to reach its end
+ *
+ * Keeps available() going meanwhile, for the refill means that need it,
+ * which also writes the steps while the SdSpiBus is locked and refill()
+ * deferred. Returns at once if no fade is running.
+ */
+void SFEMP3Shield::fadeWait() {
+  while(fade_ticks || vol_pending)
+    available();
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Write SCI_VOL from the master volume and fade gain
+ *
+ * Unless a ramp is running, whose next tick will write it.
+ */
+void SFEMP3Shield::writeVolume() {
+  uint16_t word;
+
+  MP3_ATOMIC_BEGIN;
+  word = volumeWord();
+  if(fade_ticks || base_ticks) {
+    MP3_ATOMIC_END;
+    return;
+  }
+  vol_written = word;
+  vol_pending = 0;
+  MP3_ATOMIC_END;
+  Mp3WriteRegister(SCI_VOL, word);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Write the volume step left pending by volumeTick()
+ *
+ * Primative function of refill(), which has the VSdsp to itself and has
+ * found DREQ high. Writes SCI_VOL without waiting for the command to
+ * complete, DREQ is checked before the next use.
+ */
+void SFEMP3Shield::volumeWrite() {
+  uint16_t word;
+
+  MP3_ATOMIC_BEGIN;
+  word = volumeWord();
+  vol_written = word;
+  vol_pending = 0;
+  MP3_ATOMIC_END;
+
+  cs_low(); //Select control
+  SPI.transfer(0x02); //Write instruction
+  SPI.transfer(SCI_VOL);
+  SPI.transfer(word >> 8);
+  SPI.transfer(word & 0xFF);
+  cs_high(); //Deselect Control
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Write the volume step left pending, from the main context
+ *
+ * For when no refill() will, as while nothing is played or the track is
+ * paused. Or while the SdSpiBus is locked, as a sketch may hold it across
+ * calls, which defers each refill() until it is unlocked. The refill means
+ * being stopped, by Mp3WriteRegister().
+ */
+void SFEMP3Shield::volumeAvailable() {
+  if(!vol_pending || ((playing_state == playback) && !SdSpiBus::busy())) return;
+
+  uint16_t word;
+
+  MP3_ATOMIC_BEGIN;
+  word = volumeWord();
+  vol_written = word;
+  vol_pending = 0;
+  MP3_ATOMIC_END;
+  Mp3WriteRegister(SCI_VOL, word);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief The SCI_VOL of the master volume and fade gain
+ *
+ * \return each channel's master volume, plus the attenuation of the fade
+ * gain looked up and interpolated from vol_curve, limited to 0xFE silence.
+ * The left channel in the upper byte.
+ */
+uint16_t SFEMP3Shield::volumeWord() {
+  uint8_t index = fade_pos >> 16;
+  uint8_t fade = pgm_read_byte(&vol_curve[index]);
+  if(index < VOLUME_CURVE_STEPS) {
+    uint8_t next = pgm_read_byte(&vol_curve[index + 1]);
+    fade -= ((uint16_t)(fade - next) * (uint8_t)(fade_pos >> 8)) >> 8;
+  }
+
+  uint16_t left = (base_pos[0] >> 16) + fade;
+  uint16_t right = (base_pos[1] >> 16) + fade;
+  if(left > 0xFE) left = 0xFE;
+  if(right > 0xFE) right = 0xFE;
+  return (left << 8) | right;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Ticks of the volume ramp in a duration
+ *
+ * \param[in] ms duration in milliseconds.
+ * \return the number of whole VOLUME_RAMP_TICK_US in ms, always 0 when
+ * USE_VOLUME_RAMP is 0.
+ */
+uint16_t SFEMP3Shield::rampTicks(uint16_t ms) {
+#if USE_VOLUME_RAMP
+  return (uint32_t)ms * 1000 / VOLUME_RAMP_TICK_US;
+#else
+  return 0;
+#endif
 }
 
 //------------------------------------------------------------------------------
@@ -1041,13 +1470,26 @@ uint8_t SFEMP3Shield::playTrack(uint8_t trackNo){
  *
  * \param[out] fileName pointer of a char array (aka string), contianing the filename
  * \param[in] timecode (optional) milliseconds from the begining of the file.
- *  Only works with mp3 files, otherwise do nothing.
+ *  Found by seekTime(), for the formats it knows how to seek.
+ * \param[in,out] format (optional) pointer to the file's audio_format_m, as
+ *  kept by the sketch. Used as is if of the same file, else filled in.
  *
  * Skip, if already playing. Otherwise initialize the SdCard track to desired filehandle.
  * Reset the ByteRate and Play position and set playing to indicate such.
- * If the filename extension is MP3, then pre-read the byterate from the file.
+ * The format, the start of the audio and, for an MP3, the byterate are found
+ * from the file's content by sniffFormat(), unless given. Files of unknown
+ * content are not played, rather than lock up the VSdsp.
  * And initially fill the VSDsp's buffer, then enable refilling.
  *
+ * A WAV's chunks are walked by seekParse() to its "data" chunk, which is
+ * played from after a header of only its "fmt " chunk, sent by wavHeader().
+ * Rather than feeding the VSdsp any LIST or other chunks before it.
+ *
+ * With a timecode a track without stream headers, such as an MP3 or WAV, is
+ * started from the offset of the timecode. While an Ogg or FLAC is started
+ * from its headers, which the VSdsp needs, and is jumped by seekTo() once
+ * those have been sent.
+ *
  * \return Any Value other than zero indicates a problem occured.
  * where value indicates specific error
  *
@@ -1055,115 +1497,477 @@ uint8_t SFEMP3Shield::playTrack(uint8_t trackNo){
  * \ref Error_Codes
  *
  * \note
- * - Currently bitrate to calculate time offset is determined by either
- *   playing files or by reading MP3 headers. Hence only the later is doable
- *   without actually playing files. Hence other formats are not available, yet.
+ * - A timecode in a format seekTime() does not know, such as WMA, is ignored,
+ *   as its byte rate is only known from the VSdsp once playing.
  * - enableRefill() will enable the appropiate interrupt to match the
  *   corresponding means selected.
  * - use \c SdFat::chvol() command prior, to select desired SdCard volume, if
  *   multiple cards are used.
  */
-uint8_t SFEMP3Shield::playMP3(char* fileName, uint32_t timecode) {
+uint8_t SFEMP3Shield::playMP3(char* fileName, uint32_t timecode, audio_format_m* format) {
+  audio_format_m sniffed;
 
   if(isPlaying()) return 1;
   if(!digitalRead(MP3_RESET)) return 3;
 
   //Open the file in read mode.
   if(!track.open(fileName, O_READ)) return 2;
-
-  // find length of arrary at pointer
-  int fileNamefileName_length = 0;
-  while(*(fileName + fileNamefileName_length))
-    fileNamefileName_length++;
+  discardRefillBuffer();
+
+  // Only sniff the content if not already known for this file.
+  if(!format) format = &sniffed;
+  if((format != &sniffed) && (format->firstCluster == track.firstCluster())
+      && (format->format != fmt_unknown)) {
+    track.seekSet(format->offset);
+  } else if(!sniffFormat(&track, format)) {
+    track.close();
+    return 4;
+  }
 
   // Only know how to read bitrate from MP3 file. ignore the rest.
   // Note bitrate may get updated later by getAudioInfo()
-  if(strstr(strlwr(fileName), "mp3") )  {
-    getBitRateFromMP3File(fileName);
-    if (timecode > 0) {
-      track.seekSet(timecode * bitrate + start_of_music); // skip to X ms.
+  bitrate = format->bitrate;
+  start_of_music = format->offset;
+  track_format = format->format;
+  seek_parsed = 0;
+  seek_blocks = 0;
+  pos_rate = (uint32_t)bitrate * 1000;
+  openRaw();
+#if USE_CUE_TRACK
+  openCues(fileName);
+#endif
+
+  // a WAV is played from its data chunk, else as is.
+  if(track_format == fmt_wav) {
+    if(seekParse(start_of_music)) {
+      start_of_music = seek_start;
+      pos_rate = seek_rate;
+    } else {
+      track_format = fmt_unknown;
     }
   }
 
+  uint32_t position_ms = 0;
+  if(timecode && !streamHeaders()) {
+    position_ms = timecode;
+    if(!seekTime(&position_ms)) position_ms = 0;
+  } else if(timecode) {
+    seekParse(start_of_music); // for where the headers end.
+  }
+  if(!position_ms) seekTrack(start_of_music);
+
+  // start from silence, to fade in, when VOLUME_RAMP_START opts in.
+  if(VOLUME_RAMP_START) fadeOut(0);
   playing_state = playback;
 
-  Mp3WriteRegister(SCI_DECODE_TIME, 0); // Reset the Decode and bitrate from previous play back.
+  positionStart(tellTrack(), position_ms); // Reset the Decode and bitrate from previous play back.
   delay(100); // experimentally found that we need to let this settle before sending data.
 
+  if(track_format == fmt_wav) wavHeader();
+
   //gotta start feeding that hungry mp3 chip
   refill();
 
   //attach refill interrupt off DREQ line, pin 2
   enableRefill();
 
+  // jump, while still silent, once the VSdsp has been sent the headers.
+  if(timecode && streamHeaders() && seek_rate) {
+    uint32_t fed;
+    uint32_t started = millis();
+    do {
+      available();
+      MP3_ATOMIC_BEGIN;
+      fed = pos_fed;
+      MP3_ATOMIC_END;
+    } while((fed < seek_start) && isPlaying() && ((millis() - started) < 1000));
+    // fades in as the VSdsp has settled on the new position.
+    if(isPlaying()) {
+      seekTo(timecode, VOLUME_RAMP_START);
+      return 0;
+    }
+  }
+
+  fadeIn(VOLUME_RAMP_START);
+
   return 0;
 }
 
 //------------------------------------------------------------------------------
 /**
- * \brief Gracefully close track and cancel refill
+ * \brief Preload a file's location and head for playClip().
  *
- * Skip if already not playing. Otherwise Disable the refill means,
- * then set playing to false, close the filehandle track instance.
- * And finally flush the VSdsp's stream buffer.
+ * \param[out] fileName pointer of a char array (aka string), contianing the filename
+ * \param[out] clip pointer to the clip_m to be filled in.
+ * \param[in] head (optional) pointer to RAM to hold the first bytes of audio.
+ * \param[in] headSize (optional) number of bytes available at head.
+ *
+ * Opens the file in the current working directory and records its
+ * directory index, first cluster, first block if contiguous, its format and,
+ * for MP3s, the bitrate and the offset of the first audio frame. Then reads up to
+ * headSize bytes of audio from there into head.
+ *
+ * Intended to be called in setup() for each file that must start with the
+ * least delay, such as those of triggers.
+ *
+ * \return Any Value other than zero indicates a problem occured.
+ * where value indicates specific error
+ *
+ * \see
+ * \ref Error_Codes
+ *
+ * \note Each byte of head saves waiting on the SdCard at the start of
+ * playClip(). Some tens of bytes cover the first read, a few hundred the
+ * VSdsp's decoding of the first MP3 frame, at the cost of RAM per clip.
  */
-void SFEMP3Shield::stopTrack(){
-
-  if(((playing_state != playback) && (playing_state != paused_playback)) || !digitalRead(MP3_RESET))
-    return;
-
-  //cancel external interrupt
-  disableRefill();
-  playing_state = ready;
+uint8_t SFEMP3Shield::preloadClip(char* fileName, clip_m* clip, uint8_t* head, uint16_t headSize) {
+  dir_t d;
+  int16_t n;
+  uint32_t lastBlock;
+  char name[13];
+  char entry[13];
 
-  track.close(); //Close out this track
+  if(isPlaying()) return 1;
 
-  flush_cancel(pre); //possible mode of "none" for faster response.
+  //Open the file in read mode.
+  if(!track.open(fileName, O_READ)) return 2;
 
-  //Serial.println(F("Track is done!"));
+  clip->firstCluster = track.firstCluster();
+  if(!track.contiguousRange(&clip->firstBlock, &lastBlock)) {
+    clip->firstBlock = 0;
+  }
+  // the short name, as the directory holds it, whatever case fileName was.
+  if(!track.getFilename(name)) {
+    track.close();
+    return 2;
+  }
 
+  audio_format_m format;
+  if(!sniffFormat(&track, &format)) {
+    track.close();
+    return 4;
+  }
+  bitrate = format.bitrate;
+  start_of_music = format.offset;
+  clip->bitrate = bitrate;
+  clip->format = format.format;
+  clip->start = start_of_music;
+
+  clip->head = head;
+  clip->headLength = 0;
+  if(head && headSize && track.seekSet(start_of_music)) {
+    n = track.read(head, headSize);
+    if(n > 0) clip->headLength = n;
+  }
+  track.close();
+
+  // locate the file's entry by name, as for SdBaseFile::open(SdBaseFile*, uint16_t, uint8_t)
+  // leaving the directory where the sketch had it, such as mid openNext().
+  SdBaseFile* dir = SdBaseFile::cwd();
+  uint32_t dirPosition = dir->curPosition();
+  uint8_t result = 2;
+  dir->rewind();
+  while(dir->readDir(&d) > 0) {
+    SdBaseFile::dirName(d, entry);
+    if(!strcmp(entry, name)) {
+      clip->dirIndex = (dir->curPosition() / sizeof(dir_t)) - 1;
+      result = 0;
+      break;
+    }
+  }
+  dir->seekSet(dirPosition);
+  return result;
 }
 
 //------------------------------------------------------------------------------
 /**
- * \brief Inidicate if a song is playing?
+ * \brief Begin playing a file preloaded by preloadClip().
  *
- * Public method for determining if a file is streaming to the VSdsp.
+ * \param[in] clip pointer to the clip_m filled in by preloadClip().
  *
- * \return
- * - 0 indicates \b NO file is currently being streamed to the VSdsp.
- * - 1 indicates that a file is currently being streamed to the VSdsp.
- * - 3 indicates that the VSdsp is in reset.
+ * Skip, if already playing. Otherwise open the track directly by its
+ * directory index, rather than searching by name, and verify it is the same
+ * file. Only then send the clip's head from RAM to the VSdsp, so decoding
+ * starts while the SdCard is still being read, position the track just after
+ * the head and enable refilling. The bitrate, format and start of music are
+ * taken from the clip, rather than scanned.
+ *
+ * \return Any Value other than zero indicates a problem occured.
+ * where value indicates specific error
+ *
+ * \see
+ * \ref Error_Codes
+ *
+ * \note Unlike playMP3() there is no delay() for the VSdsp to settle, as
+ * the head has already been accepted by DREQ.
  */
-uint8_t SFEMP3Shield::isPlaying(){
-  uint8_t result;
+uint8_t SFEMP3Shield::playClip(clip_m* clip) {
 
-  if(!digitalRead(MP3_RESET))
-    result = 3;
-  else if(getState() == playback)
-    result = 1;
-  else if(getState() == paused_playback)
-    result = 1;
-  else
-    result = 0;
+  if(isPlaying()) return 1;
+  if(!digitalRead(MP3_RESET)) return 3;
+#if USE_CUE_TRACK
+  closeCues(); // a clip has none, drop those of the last track.
+#endif
 
-  return result;
+  //Open the file by its directory index, and verify it is the same file,
+  //before any of it is sent, so a failure leaves the VSdsp untouched.
+  if(!track.open(SdBaseFile::cwd(), clip->dirIndex, O_READ)) return 2;
+  discardRefillBuffer();
+  if((track.firstCluster() != clip->firstCluster)
+      || !track.seekSet(clip->start + clip->headLength)) {
+    track.close();
+    return 2;
+  }
+
+  //get the preloaded head into the VSdsp without waiting on the SdCard.
+  dcs_low(); //Select Data
+  for(uint16_t y = 0 ; y < clip->headLength ; y += 32) {
+    while(!digitalRead(MP3_DREQ));
+    uint16_t n = clip->headLength - y;
+    if(n > 32) n = 32;
+    sdi_send(&clip->head[y], n);
+  }
+  dcs_high(); //Deselect Data
+
+  bitrate = clip->bitrate;
+  start_of_music = clip->start;
+  track_format = clip->format;
+  seek_parsed = 0;
+  seek_blocks = 0;
+  openRaw(clip->firstBlock);
+
+  //the head already sent counts toward the position.
+  pos_rate = (uint32_t)bitrate * 1000;
+  positionStart(start_of_music, 0); // Reset the Decode and bitrate from previous play back.
+  playing_state = playback;
+
+  //the SdCard stream catches up from here.
+  refill();
+
+  //attach refill interrupt off DREQ line, pin 2
+  enableRefill();
+
+  return 0;
 }
 
+//------------------------------------------------------------------------------
 /**
- * \brief Get the current state of the device
+ * \brief Open a sound bank for playBankClip().
  *
- * Reports the current operational status of the device from the list of possible
- * states enumerated by state_m
+ * \param[out] fileName pointer of a char array (aka string), contianing the filename
  *
- * \return the value held by SFEMP3Shield::playing_state
+ * Opens the bank, as created by plugins/mk_bank.pl, verifies its header and
+ * that it is contiguous. Then records only its first block and number of
+ * clips, and closes it. Clips are thereafter read by raw block address,
+ * needing neither a file handle nor a directory search.
+ *
+ * \return Any Value other than zero indicates a problem occured.
+ * where value indicates specific error
+ *
+ * \see
+ * \ref Error_Codes
+ *
+ * \warning The bank must remain unchanged on the SdCard while open. Copy it
+ * to a freshly formatted card for it to be contiguous.
  */
-state_m SFEMP3Shield::getState(){
- return playing_state;
-}
+uint8_t SFEMP3Shield::openBank(char* fileName) {
+  bank_header_m header;
+  uint32_t lastBlock;
+  uint8_t result = 0;
 
-//------------------------------------------------------------------------------
-/**
+  if(isPlaying()) return 1;
+  bank_firstBlock = 0;
+  bank_count = 0;
+
+  if(!track.open(fileName, O_READ)) return 2;
+
+  if(track.read(&header, sizeof(header)) != sizeof(header)
+      || memcmp(header.magic, "SBNK", 4) || (header.version != BANK_VERSION)) {
+    result = 5;
+  } else if(!track.contiguousRange(&bank_firstBlock, &lastBlock)) {
+    bank_firstBlock = 0;
+    result = 4;
+  } else {
+    bank_count = header.count;
+  }
+  track.close();
+  return result;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Find a clip in the open sound bank.
+ *
+ * \param[in] id of the clip to be found.
+ * \param[out] entry pointer to where the clip's entry is to be copied.
+ *
+ * Binary search of the bank's table, which is sorted by id. Reading each
+ * block of entries by raw block address into mp3BlockBuffer, which is free
+ * while not playing, leaving SdVolume's cache to the sketch's file
+ * operations. Typically one block for up to 31 clips and one more for each
+ * doubling.
+ *
+ * \return true if found.
+ */
+bool SFEMP3Shield::findBankEntry(uint16_t id, bank_entry_m* entry) {
+  uint16_t lo = 0;
+  uint16_t hi = bank_count;
+  uint32_t held = 0; // block in mp3BlockBuffer, the bank's first is the header.
+  bool found = false;
+
+  mp3BlockHead = 0;
+  mp3BlockCount = 0;
+  SdSpiBusLock busLock; // end any open transaction, such as an SdLogger's write.
+  while(lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+    uint32_t offset = sizeof(bank_header_m) + (uint32_t) mid * sizeof(bank_entry_m);
+    uint32_t block = bank_firstBlock + (offset >> 9);
+    if((block != held) && !sd.card()->readBlock(block, mp3BlockBuffer)) break;
+    held = block;
+    memcpy(entry, &mp3BlockBuffer[offset & 0x1FF], sizeof(bank_entry_m));
+    if(entry->id == id) {
+      found = true;
+      break;
+    }
+    if(entry->id < id) lo = mid + 1;
+    else hi = mid;
+  }
+  return found;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Begin playing a clip of the open sound bank.
+ *
+ * \param[in] id of the clip, as assigned by plugins/mk_bank.pl.
+ *
+ * Skip, if already playing. Otherwise find the clip's entry in the bank's
+ * table, and stream it by raw block address from its offset for its length.
+ * There is no file to open, and no directory search or cluster chain to walk.
+ *
+ * \return Any Value other than zero indicates a problem occured.
+ * where value indicates specific error
+ *
+ * \see
+ * \ref Error_Codes
+ *
+ * \note Named apart from playClip(clip_m*) as playClip(0) would be ambiguous.
+ */
+uint8_t SFEMP3Shield::playBankClip(uint16_t id) {
+  bank_entry_m entry;
+
+  if(isPlaying()) return 1;
+  if(!digitalRead(MP3_RESET)) return 3;
+  if(!bank_firstBlock || !findBankEntry(id, &entry) || !entry.length) return 2;
+#if USE_CUE_TRACK
+  closeCues(); // a clip has none, drop those of the last track.
+#endif
+
+  discardRefillBuffer();
+  bitrate = entry.bitrate;
+  start_of_music = entry.offset;
+  track_format = fmt_unknown;
+  raw_firstBlock = bank_firstBlock;
+  raw_position = entry.offset;
+  raw_end = entry.offset + entry.length;
+
+  pos_rate = (uint32_t)bitrate * 1000;
+  positionStart(start_of_music, 0); // Reset the Decode and bitrate from previous play back.
+
+  playing_state = playback;
+
+  //gotta start feeding that hungry mp3 chip
+  refill();
+
+  //attach refill interrupt off DREQ line, pin 2
+  enableRefill();
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Gracefully close track and cancel refill
+ *
+ * Skip if already not playing. Otherwise Disable the refill means,
+ * then set playing to false, close the filehandle track instance.
+ * And finally flush the VSdsp's stream buffer.
+ *
+ * \note With USE_VOLUME_RAMP a playing track first fades out over
+ * VOLUME_RAMP_STOP, while still being refilled.
+ */
+void SFEMP3Shield::stopTrack(){
+
+  if(((playing_state != playback) && (playing_state != paused_playback)) || !digitalRead(MP3_RESET))
+    return;
+
+  //fade out what is playing, rather than cut it.
+  if(playing_state == playback) {
+    fadeOut(VOLUME_RAMP_STOP);
+    fadeWait();
+  }
+
+  //cancel external interrupt
+  disableRefill();
+  playing_state = ready;
+
+  discardRefillBuffer();
+  endRawRead();
+  track.close(); //Close out this track
+  raw_end = 0;
+#if USE_CUE_TRACK
+  closeCues();
+#endif
+
+  flush_cancel(pre); //possible mode of "none" for faster response.
+
+  //nothing left to hear, restore the gain for what is played next.
+  fadeIn(0);
+
+  //Serial.println(F("Track is done!"));
+
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Inidicate if a song is playing?
+ *
+ * Public method for determining if a file is streaming to the VSdsp.
+ *
+ * \return
+ * - 0 indicates \b NO file is currently being streamed to the VSdsp.
+ * - 1 indicates that a file is currently being streamed to the VSdsp.
+ * - 3 indicates that the VSdsp is in reset.
+ */
+uint8_t SFEMP3Shield::isPlaying(){
+  uint8_t result;
+
+  if(!digitalRead(MP3_RESET))
+    result = 3;
+  else if(getState() == playback)
+    result = 1;
+  else if(getState() == paused_playback)
+    result = 1;
+  else
+    result = 0;
+
+  return result;
+}
+
+/**
+ * \brief Get the current state of the device
+ *
+ * Reports the current operational status of the device from the list of possible
+ * states enumerated by state_m
+ *
+ * \return the value held by SFEMP3Shield::playing_state
+ */
+state_m SFEMP3Shield::getState(){
+ return playing_state;
+}
+
+//------------------------------------------------------------------------------
+/**
  * \brief Pause streaming data to the VSdsp.
  *
  * Public method for disabling the refill with disableRefill().
@@ -1217,11 +2021,13 @@ void SFEMP3Shield::pauseMusic() {
  * \param[in] timecode (optional) milliseconds from the begining of the file.
  *
  * Public method for resuming the play of music from a specific file location.
+ * As found by seekTime() for the track's format.
  *
  * \return
  * - 0 indicates the position was changed.
  * - 1 indicates no action, in lieu of any current file stream.
- * - 2 indicates failure to skip to new file location.
+ * - 2 indicates failure to skip to new file location, the track stays
+ *   paused where it was.
  *
  * \note This is effectively equal to resumeDataStream() and is a place holder to
  * resuming the VSdsp's playing and DREQ's.
@@ -1229,8 +2035,15 @@ void SFEMP3Shield::pauseMusic() {
 uint8_t SFEMP3Shield::resumeMusic(uint32_t timecode) {
   if((playing_state == paused_playback) && digitalRead(MP3_RESET)) {
 
-    if(!track.seekSet(((timecode * Mp3ReadWRAM(para_byteRate))/1000) + start_of_music))    //if(!track.seekCur((uint32_t(timecode/1000 * Mp3ReadWRAM(para_byteRate)))))
+    discardRefillBuffer();
+    uint32_t resume = tellTrack();
+    seek_blocks = 0;
+    if(!seekTime(&timecode)) {
+      seekTrack(resume);
       return 2;
+    }
+    seekFlush();
+    positionStart(tellTrack(), timecode);
 
     resumeDataStream();
     return 0;
@@ -1265,51 +2078,25 @@ bool SFEMP3Shield::resumeMusic() {
  *
  * \param[in] timecode offset milliseconds from the current location of the file.
  *
- * Repositions the filehandles track location to the requested offset.
- * As calculated by the bitrate multiplied by the desired ms offset.
+ * Repositions the filehandles track location to the requested offset, from
+ * the position heard, as currentPosition(). Clamped to the begining of the
+ * track. As found by seekTime() for the track's format, by seekTo().
  *
  * \return
  * - 0 indicates the position was changed.
  * - 1 indicates no action, in lieu of any current file stream.
- * - 2 indicates failure to skip to new file location.
+ * - 2 indicates failure to skip to new file location, the track carries on
+ *   from where it was.
  *
- * \warning Limited to +/- 32768ms, since SdFile::seekCur(int32_t);
+ * \note With USE_VOLUME_RAMP the track fades out over VOLUME_RAMP_SEEK before
+ * the seek, waiting for it, and fades back in after, returning at once.
  */
 uint8_t SFEMP3Shield::skip(int32_t timecode){
 
   if(isPlaying() && digitalRead(MP3_RESET)) {
-
-    //stop interupt for now
-    disableRefill();
-    playing_state = paused_playback;
-
-    // try to set the files position to current position + offset(in bytes)
-    // as calculated from current byte rate, as per VSdsp.
-    if(!track.seekCur((uint32_t(timecode/1000 * Mp3ReadWRAM(para_byteRate))))) // skip next X ms.
-      return 2;
-
-    Mp3WriteRegister(SCI_VOL, 0xFE, 0xFE);
-    //seeked successfully
-
-    flush_cancel(pre); //possible mode of "none" for faster response.
-
-    //gotta start feeding that hungry mp3 chip
-    refill();
-
-    //again, I'm being bad and not following the spec sheet.
-    //I already turned the volume down, so when the MP3 chip gets upset at me
-    //for just slammin in new bits of the file, you won't hear it.
-    //so we'll wait a bit, and restore the volume to previous level
-    delay(50);
-
-    //one of these days I'll come back and try to do it the right way.
-    setVolume(VolL,VolR);
-
-    playing_state = playback;
-    //attach refill interrupt off DREQ line, pin 2
-    enableRefill();
-
-    return 0;
+    int32_t target = (int32_t)currentPosition() + timecode;
+    seek_blocks = 0;
+    return seekTo((target > 0) ? target : 0);
   }
 
   return 1;
@@ -1322,75 +2109,119 @@ uint8_t SFEMP3Shield::skip(int32_t timecode){
  * \param[in] timecode offset milliseconds from the begining of the file.
  *
  * Repositions the filehandles track location to the requested offset.
- * As calculated by the bitrate multiplied by the desired ms offset.
+ * As found by seekTime() for the track's format, by seekTo().
  *
  * \return
  * - 0 indicates the position was changed.
  * - 1 indicates no action, in lieu of any current file stream.
- * - 2 indicates failure to skip to new file location.
+ * - 2 indicates failure to skip to new file location, the track carries on
+ *   from where it was.
  *
- * \warning Limited to first 65535ms, since SdFile::seekSet(int32_t);
+ * \note Fades as skip().
  */
 uint8_t SFEMP3Shield::skipTo(uint32_t timecode){
 
   if(isPlaying() && digitalRead(MP3_RESET)) {
-
-    //stop interupt for now
-    disableRefill();
-    playing_state = paused_playback;
-
-    // try to set the files position to current position + offset(in bytes)
-    // as calculated from current byte rate, as per VSdsp.
-    if(!track.seekSet(((timecode * Mp3ReadWRAM(para_byteRate))/1000) + start_of_music)) // skip to X ms.
-    //if(!track.seekCur((uint32_t(timecode/1000 * Mp3ReadWRAM(para_byteRate))))) // skip next X ms.
-      return 2;
-
-    Mp3WriteRegister(SCI_VOL, 0xFE, 0xFE);
-    //seeked successfully
-
-    flush_cancel(pre); //possible mode of "none" for faster response.
-
-    //gotta start feeding that hungry mp3 chip
-    refill();
-
-    //again, I'm being bad and not following the spec sheet.
-    //I already turned the volume down, so when the MP3 chip gets upset at me
-    //for just slammin in new bits of the file, you won't hear it.
-    //so we'll wait a bit, and restore the volume to previous level
-    delay(50);
-
-    //one of these days I'll come back and try to do it the right way.
-    setVolume(VolL,VolR);
-
-    playing_state = playback;
-    //attach refill interrupt off DREQ line, pin 2
-    enableRefill();
-
-    return 0;
+    seek_blocks = 0;
+    return seekTo(timecode);
   }
 
   return 1;
 }
 
+//------------------------------------------------------------------------------
+/**
+ * \brief Blocks read by the last seek
+ *
+ * \return the number of blocks of the track read by the last skip(), skipTo(),
+ * resumeMusic(uint32_t) or playMP3() with a timecode, to find the offset of
+ * the time. Including those read by seekParse() for an Ogg or FLAC's headers,
+ * at its first seek. Consecutive reads of the same block, from SdVolume's cache,
+ * count once. 0 for a seek at the byte rate, such as of an MP3.
+ */
+uint16_t SFEMP3Shield::getSeekBlocks() {
+  return seek_blocks;
+}
+
 //------------------------------------------------------------------------------
 /**
  * \brief Current timecode in ms
  *
- * Reads the currenty position from the VSdsp's decode time
- * and converts the value to milliseconds.
+ * Computes the position from RAM, as the bytes refill() has sent to the VSdsp
+ * since the track started or was repositioned, less those estimated to be
+ * still in the VSdsp's buffer, at the stream's byte rate. To a resolution of
+ * a burst of 32 bytes, 2ms at 128Kbit/s. Cheap enough to be polled every frame
+ * of a light show.
+ *
+ * At most every POSITION_RESYNC_MS, while playing, the tracker is resynced
+ * with positionResync(), at the cost of a few SCI reads.
  *
  * \return the milliseconds offset of stream played.
  *
- * \note SCI_DECODE_TIME is cleared during SFEMP3Shield::playMP3, as to restart
- * the position for each file stream. Erasing prior streams weight.
+ * \note The byte rate is at first taken from the MP3 header, when there is
+ * one, else the position holds at the start until the first resync reads it
+ * from the VSdsp.
  *
- * \warning Not very accurate, rounded off to second. And Variable Bit-Rates
- * are completely inaccurate.
+ * \warning Variable Bit-Rates drift between resyncs, though never by more than
+ * a second from SCI_DECODE_TIME.
  */
 uint32_t SFEMP3Shield::currentPosition(){
 
-  return(Mp3ReadRegister(SCI_DECODE_TIME) << 10); // multiply by 1024 to convert to milliseconds.
+  if((playing_state == playback) && ((millis() - pos_synced) >= POSITION_RESYNC_MS))
+    positionResync();
+
+  uint32_t fed;
+  uint16_t latency;
+  uint8_t primed;
+  MP3_ATOMIC_BEGIN; // refill() may be updating these.
+  fed = pos_fed - pos_segment;
+  latency = pos_latency;
+  primed = pos_primed;
+  MP3_ATOMIC_END;
+
+  if(!primed || (fed <= latency)) return pos_segment_ms;
+  return pos_segment_ms + bytesToMs(fed - latency);
+}
+
+#if USE_CUE_TRACK
+//------------------------------------------------------------------------------
+/**
+ * \brief Take the next cue that is due
+ *
+ * \param[out] cue pointer to the cue_m to be filled in.
+ *
+ * Call from loop() while playing, as often as the accuracy needed. Compares
+ * the next cue read ahead with currentPosition(), from RAM. When it is due it
+ * is taken, and once half the cues read ahead have been taken the next are
+ * read from the SdCard, in a block. Call again until it returns false, to
+ * take several due at once.
+ *
+ * \return true if a cue was taken, false if none is due, or there is no cue
+ * track.
+ *
+ * \note The lateness of a cue is currentPosition() less its time. While
+ * paused the position holds, and so do the cues.
+ */
+bool SFEMP3Shield::nextCue(cue_m* cue) {
+  if((cue_tail == cue_head) || !isPlaying()) return false;
+  if((int32_t)(currentPosition() - cue_buffer[cue_tail].time) < 0) return false;
+
+  *cue = cue_buffer[cue_tail];
+  cue_tail = (cue_tail + 1) % CUE_BUFFER;
+  cueRead();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Does the track have cues left
+ *
+ * \return true while cues of the playing track remain to be taken by nextCue().
+ */
+bool SFEMP3Shield::hasCues() {
+  return (cue_tail != cue_head) || cue_remaining;
 }
+#endif
 
 // @}
 // Play_Control_Group
@@ -1457,34 +2288,30 @@ void SFEMP3Shield::trackAlbum(char* infobuffer){
  * Read current filehandles offset of track ID3 tag information. Then strip
  * all non readible (ascii) characters.
  *
- * \note this suspends currently playing streams and returns afterwards.
+ * \note this defers refills of currently playing streams and returns afterwards.
  * Restoring the file position to where it left off, before resuming.
  */
 void SFEMP3Shield::getTrackInfo(uint8_t offset, char* infobuffer){
 
-  //disable interupts
-  if(playing_state == playback) {
-    disableRefill();
-  }
-
-  //record current file position
-  uint32_t currentPos = track.curPosition();
+  // hold off refill across the seek and read, any DREQ meanwhile is deferred
+  // and serviced as the lock is released.
+  {
+    SdSpiBusLock busLock;
 
-  //skip to end
-  track.seekEnd((-128 + offset));
+    //record current file position
+    uint32_t currentPos = track.curPosition();
 
-  //read 30 bytes of tag informat at -128 + offset
-  track.read(infobuffer, 30);
-  infobuffer = strip_nonalpha_inplace(infobuffer);
+    //skip to end
+    track.seekEnd((-128 + offset));
 
-  //seek back to saved file position
-  track.seekSet(currentPos);
+    //read 30 bytes of tag informat at -128 + offset
+    track.read(infobuffer, 30);
 
-  //renable interupt
-  if(playing_state == playback) {
-    enableRefill();
+    //seek back to saved file position
+    track.seekSet(currentPos);
   }
 
+  infobuffer = strip_nonalpha_inplace(infobuffer);
 }
 
 //------------------------------------------------------------------------------
@@ -1496,7 +2323,7 @@ void SFEMP3Shield::getTrackInfo(uint8_t offset, char* infobuffer){
  *
  * This may be called while playing a current stream.
  *
- * \note this suspends currently playing streams and returns afterwards.
+ * \note this defers refills of currently playing streams and returns afterwards.
  * Restoring the file position to where it left off, before resuming.
  */
 void SFEMP3Shield::getAudioInfo() {
@@ -1569,77 +2396,6 @@ void SFEMP3Shield::getAudioInfo() {
   Serial.println();
 }
 
-//------------------------------------------------------------------------------
-/**
- * \brief Read the Bit-Rate from the current track's filehandle.
- *
- * \param[out] fileName pointer of a char array (aka string), contianing the filename
- *
- * locate the MP3 header in the current file and from there determine the
- * Bit-Rate, using bitrate_table located in flash. And return the position
- * to the prior location.
- *
- * \note the bitrate will be updated, as read back from the VS10xx when needed.
- *
- * \warning This feature only works on MP3 files.
- * It will \b LOCK-UP on other file formats, looking for the MP3 header.
- */
-void SFEMP3Shield::getBitRateFromMP3File(char* fileName) {
-  //look for first MP3 frame (11 1's)
-  bitrate = 0;
-  uint8_t temp = 0;
-  uint8_t row_num =0;
-
-    for(uint16_t i = 0; i<65535; i++) {
-      if(track.read() == 0xFF) {
-
-        temp = track.read();
-
-        if(((temp & 0b11100000) == 0b11100000) && ((temp & 0b00000110) != 0b00000000)) {
-
-          //found the 11 1's
-          //parse version, layer and bitrate out and save bitrate
-          if(!(temp & 0b00001000)) { //!true if Version 1, !false version 2 and 2.5
-            row_num = 3;
-          }
-          else if((temp & 0b00000110) == 0b00000100) { //true if layer 2, false if layer 1 or 3
-            row_num += 1;
-          }
-          else if((temp & 0b00000110) == 0b00000010) { //true if layer 3, false if layer 2 or 1
-            row_num += 2;
-          } else {
-            continue; // Not found, need to skip the rest and continue looking.
-                      // \warning But this can lead to a dead end and file end of file.
-          }
-
-          //parse bitrate code from next byte
-          temp = track.read();
-          temp = temp>>4;
-
-          //lookup bitrate
-          bitrate = pgm_read_word_near ( &(bitrate_table[temp][row_num]) );
-
-          //convert kbps to Bytes per mS
-          bitrate /= 8;
-
-          //record file position
-          track.seekCur(-3);
-          start_of_music = track.curPosition();
-
-//          Serial.print(F("POS: "));
-//          Serial.println(start_of_music);
-
-//          Serial.print(F("Bitrate: "));
-//          Serial.println(bitrate);
-
-          //break out of for loop
-          break;
-
-        }
-      }
-    }
-  }
-
 //------------------------------------------------------------------------------
 /**
  * \brief get the status of the VSdsp VU Meter
@@ -1712,6 +2468,7 @@ int16_t SFEMP3Shield::getVUlevel() {
 void SFEMP3Shield::setBitRate(uint16_t bitr){
 
   bitrate = bitr;
+  pos_rate = (uint32_t)bitr * 1000;
   return;
 }
 
@@ -1719,30 +2476,44 @@ void SFEMP3Shield::setBitRate(uint16_t bitr){
 /**
  * \brief Initialize the SPI for VS10xx use.
  *
+ * \param[in] rate is the SPI ClockDivider to be used, either spi_Write_Rate
+ * or spi_Read_Rate.
+ *
  * Primative function to configure the SPI's BitOrder, DataMode and ClockDivider to that of
  * the current VX10xx.
- *
- * \warning This sets the rate fast for write, too fast for reading. In the case of a subsequent SPI.transfer that is reading back data followup with a SPI.setClockDivider(spi_Read_Rate); as not to get gibberish.
-*/
-void SFEMP3Shield::spiInit() {
-  //Set SPI bus for write
+ */
+void SFEMP3Shield::spiInit(uint16_t rate) {
   SPI.setBitOrder(MSBFIRST);
   SPI.setDataMode(SPI_MODE0);
-  SPI.setClockDivider(spi_Write_Rate);
+  SPI.setClockDivider(rate);
 }
 
 //------------------------------------------------------------------------------
 /**
  * \brief Select Control Channel
  *
- * Primative function to configure the SPI's Mode and rate control to that of
- * the current VX10xx. Then select the VS10xx's Control Chip Select as per
- * defined by MP3_XCS.
- *
- * \warning This uses spiInit() which sets the rate fast for write, too fast for reading. In the case of a subsequent SPI.transfer that is reading back data followup with a SPI.setClockDivider(spi_Read_Rate); as not to get gibberish.
+ * Primative function to select the VS10xx's Control Chip Select at the write
+ * rate, as per cs_low(uint16_t).
  */
 void SFEMP3Shield::cs_low() {
-  spiInit();
+  cs_low(spi_Write_Rate);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Select Control Channel at a given rate
+ *
+ * \param[in] rate is the SPI ClockDivider to be used, either spi_Write_Rate
+ * or spi_Read_Rate.
+ *
+ * Primative function to take the SPI bus from SdSpiBus and only when the
+ * SdCard, or another rate, was last on the bus configure the SPI's Mode and
+ * rate to that of the current VX10xx. Then select the VS10xx's Control Chip
+ * Select as per defined by MP3_XCS.
+ */
+void SFEMP3Shield::cs_low(uint16_t rate) {
+  if(SdSpiBus::acquire(MP3_SPI_BUS_ID, rate))
+    spiInit(rate);
   digitalWrite(MP3_XCS, LOW);
 }
 
@@ -1751,24 +2522,26 @@ void SFEMP3Shield::cs_low() {
  * \brief Deselect Control Channel
  *
  * Primative function to Deselect the VS10xx's Control Chip Select as per
- * defined by MP3_XCS.
+ * defined by MP3_XCS. And release the SPI bus, running any refill deferred
+ * meanwhile.
  */
 void SFEMP3Shield::cs_high() {
   digitalWrite(MP3_XCS, HIGH);
+  SdSpiBus::release(MP3_SPI_BUS_ID);
 }
 
 //------------------------------------------------------------------------------
 /**
  * \brief Select Data Channel
  *
- * Primative function to configure the SPI's Mode and rate control to that of
- * the current VX10xx. Then select the VS10xx's Data Chip Select as per
- * defined by MP3_XDCS.
- *
- * \warning This uses spiInit() which sets the rate fast for write, too fast for reading. In the case of a subsequent SPI.transfer that is reading back data followup with a SPI.setClockDivider(spi_Read_Rate); as not to get gibberish.
+ * Primative function to take the SPI bus from SdSpiBus and only when the
+ * SdCard, or another rate, was last on the bus configure the SPI's Mode and
+ * rate to that of the current VX10xx. Then select the VS10xx's Data Chip
+ * Select as per defined by MP3_XDCS.
  */
 void SFEMP3Shield::dcs_low() {
-  spiInit();
+  if(SdSpiBus::acquire(MP3_SPI_BUS_ID, spi_Write_Rate))
+    spiInit(spi_Write_Rate);
   digitalWrite(MP3_XDCS, LOW);
 }
 
@@ -1777,38 +2550,1109 @@ void SFEMP3Shield::dcs_low() {
  * \brief Deselect Data Channel
  *
  * Primative function to Deselect the VS10xx's Control Data Select as per
- * defined by MP3_XDCS.
+ * defined by MP3_XDCS. And release the SPI bus, running any refill deferred
+ * meanwhile.
  */
 void SFEMP3Shield::dcs_high() {
   digitalWrite(MP3_XDCS, HIGH);
+  SdSpiBus::release(MP3_SPI_BUS_ID);
 }
 
+#if MP3_REFILL_DMA
 //------------------------------------------------------------------------------
 /**
- * \brief uint16_t Overload of SFEMP3Shield::Mp3WriteRegister
- *
- * \param[in] addressbyte of the VSdsp's register to be written
- * \param[in] data to writen to the register
+ * \brief Select Data Channel for DMA bursts
  *
- * Forces the input value into the Big Endian Corresponding positions of
- * Mp3WriteRegister as to be written to the addressed VSdsp's registers.
+ * Primative function, like dcs_low(), to take the SPI bus from SdSpiBus. But
+ * configures it with SdFat's native SdSpi driver at MP3_DMA_SCK_DIVISOR, as to
+ * send with SdSpi::send(). Then select the VS10xx's Data Chip Select as per
+ * defined by MP3_XDCS. Deselect with dcs_high().
  */
-void SFEMP3Shield::Mp3WriteRegister(uint8_t addressbyte, uint16_t data) {
-  union twobyte val;
-  val.word = data;
-  Mp3WriteRegister(addressbyte, val.byte[1], val.byte[0]);
+void SFEMP3Shield::sdi_low() {
+  if(SdSpiBus::acquire(MP3_SPI_BUS_ID, 0x80 | MP3_DMA_SCK_DIVISOR))
+    sdi.init(MP3_DMA_SCK_DIVISOR);
+  digitalWrite(MP3_XDCS, LOW);
 }
+#endif
 
 //------------------------------------------------------------------------------
 /**
- * \brief Write a value a VSDsp's register.
- *
- * \param[in] addressbyte of the VSdsp's register to be written
- * \param[in] highbyte to writen to the register
- * \param[in] lowbyte to writen to the register
+ * \brief Discard data read ahead by refill()
  *
- * Primative function to suspend playing and directly communicate over the SPI
- * to the VSdsp's registers. Where the value write is Big Endian (MSB first).
+ * refill() reads ahead up to a block of the track. This rewinds the track to
+ * the first byte not yet sent to the VSdsp and empties the block buffer, so
+ * that the track's position may be used, or changed, as if refill() had not
+ * read ahead.
+ */
+void SFEMP3Shield::discardRefillBuffer() {
+  if(raw_end)
+    raw_position -= mp3BlockCount - mp3BlockHead;
+  else if(track.isOpen() && (mp3BlockHead < mp3BlockCount))
+    track.seekCur(-(int32_t)(mp3BlockCount - mp3BlockHead));
+  mp3BlockHead = 0;
+  mp3BlockCount = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Position of the next byte to be read by refill()
+ *
+ * \return the offset in the track, or in the sound bank when playing a clip.
+ */
+uint32_t SFEMP3Shield::tellTrack() {
+  return raw_end ? raw_position : track.curPosition();
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Reposition the next byte to be read by refill()
+ *
+ * \param[in] position offset in the track, or in the sound bank when playing
+ * a clip.
+ *
+ * A raw read is limited to between start_of_music and its end, as not to
+ * wander into a neighbouring clip.
+ *
+ * \return true on success, false if the position is out of range.
+ */
+bool SFEMP3Shield::seekTrack(uint32_t position) {
+  if(!raw_end) return track.seekSet(position);
+  if((position < start_of_music) || (position > raw_end)) return false;
+  raw_position = position;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Restart the position tracker
+ *
+ * \param[in] segment offset of the first byte sent to the VSdsp from here on,
+ * as tellTrack().
+ * \param[in] ms milliseconds into the track at the segment, as found by
+ * seekTime().
+ *
+ * Called as a track starts, or is repositioned, before its first refill().
+ * Which sets the estimate of the bytes held by the VSdsp to all it sent.
+ * And SCI_DECODE_TIME is cleared, to count from the segment.
+ * With USE_CUE_TRACK the cues from the segment's position are read ahead.
+ *
+ * \note Bytes read ahead must have been discarded by discardRefillBuffer().
+ */
+void SFEMP3Shield::positionStart(uint32_t segment, uint32_t ms) {
+  MP3_ATOMIC_BEGIN;
+  pos_fed = tellTrack();
+  pos_segment = segment;
+  pos_primed = 0;
+  MP3_ATOMIC_END;
+  pos_segment_ms = ms;
+  pos_synced = millis();
+#if USE_CUE_TRACK
+  cueSeek(pos_segment_ms);
+#endif
+
+  // as per data sheet, written twice to change it.
+  Mp3WriteRegister(SCI_DECODE_TIME, 0);
+  Mp3WriteRegister(SCI_DECODE_TIME, 0);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Resync the position tracker with the VSdsp
+ *
+ * Reads para_byteRate, the VSdsp's measure of the stream's byte rate, and
+ * SCI_DECODE_TIME, the whole seconds decoded since positionStart(). The
+ * position heard then lies within that second, which bounds the bytes that
+ * can still be held by the VSdsp. The estimate is only moved within those
+ * bounds, so each resync narrows it further.
+ */
+void SFEMP3Shield::positionResync() {
+  pos_synced = millis();
+
+  uint16_t rate = Mp3ReadWRAM(para_byteRate);
+  if(rate) pos_rate = rate;
+  uint32_t decoded = Mp3ReadRegister(SCI_DECODE_TIME);
+  if(!pos_rate || !pos_primed) return;
+
+  uint32_t fed;
+  uint32_t heard = decoded * pos_rate;
+
+  // the latency is narrowed as one, refill() moving pos_fed meanwhile.
+  MP3_ATOMIC_BEGIN;
+  fed = pos_fed - pos_segment;
+
+  // heard between decoded and decoded + 1 seconds worth of bytes.
+  uint32_t most = (fed > heard) ? fed - heard : 0;
+  uint32_t least = (fed > heard + pos_rate) ? fed - heard - pos_rate : 0;
+  if(most > 0xFFFF) most = 0xFFFF;
+  if(least > most) least = most;
+
+  if(pos_latency > most) pos_latency = most;
+  else if(pos_latency < least) pos_latency = least;
+  MP3_ATOMIC_END;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Scale a value by a ratio
+ *
+ * \param[in] value to be scaled.
+ * \param[in] mul numerator of the ratio.
+ * \param[in] div denominator of the ratio, not 0.
+ *
+ * \return value * mul / div. Split so as not to overflow long tracks, as long
+ * as (div - 1) * mul does not, such as between milliseconds and a byte or
+ * sample rate.
+ */
+static uint32_t muldiv(uint32_t value, uint32_t mul, uint32_t div) {
+  return (value / div) * mul + ((value % div) * mul) / div;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Convert bytes of the stream to milliseconds
+ *
+ * \param[in] bytes of the playing stream.
+ *
+ * \return the milliseconds of the bytes at pos_rate, or 0 if it is unknown.
+ */
+uint32_t SFEMP3Shield::bytesToMs(uint32_t bytes) {
+  if(!pos_rate) return 0;
+  return muldiv(bytes, 1000, pos_rate);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Bytes to which seeking by bisection narrows, before stepping.
+ */
+#define SEEK_SPAN 8192
+
+/**
+ * \brief Granule position of an Ogg page on which no packet ends, or past 32 bits.
+ */
+#define OGG_NO_GRANULE 0xFFFFFFFF
+
+/**
+ * \brief Read a little endian number
+ *
+ * \param[in] p pointer to the bytes.
+ * \param[in] n number of bytes, up to 4.
+ */
+static uint32_t littleEndian(const uint8_t* p, uint8_t n) {
+  uint32_t value = 0;
+  while(n--) value = (value << 8) | p[n];
+  return value;
+}
+
+/**
+ * \brief Write a little endian number
+ *
+ * \param[out] p pointer to the 4 bytes to be written.
+ * \param[in] value to be written.
+ */
+static void putLittleEndian(uint8_t* p, uint32_t value) {
+  for(uint8_t i = 0; i < 4; i++) {
+    p[i] = value;
+    value >>= 8;
+  }
+}
+
+/**
+ * \brief Read a big endian number
+ *
+ * \param[in] p pointer to the bytes.
+ * \param[in] n number of bytes, up to 4.
+ */
+static uint32_t bigEndian(const uint8_t* p, uint8_t n) {
+  uint32_t value = 0;
+  while(n--) value = (value << 8) | *p++;
+  return value;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Most bytes of a WAV's "fmt " chunk, as sent by wavHeader().
+ */
+#define WAV_FMT_MAX 64
+
+/**
+ * \brief Chunks of a RIFF WAVE, as found by riffWalk()
+ */
+struct riff_chunks_m {
+
+/** \brief Offset of the payload of the "fmt " chunk.*/
+  uint32_t fmt;
+
+/** \brief Size of the "fmt " chunk.*/
+  uint16_t fmtSize;
+
+/** \brief Block align of the "fmt " chunk, bytes of a sample of all channels.*/
+  uint16_t blockAlign;
+
+/** \brief Byte rate of the "fmt " chunk.*/
+  uint32_t byteRate;
+
+/** \brief Offset of the payload of the "data" chunk, the audio.*/
+  uint32_t data;
+
+/** \brief Size of the "data" chunk, as far as the file goes.*/
+  uint32_t dataSize;
+  };
+
+/**
+ * \brief Walk the chunks of a RIFF WAVE
+ *
+ * \param[in] file pointer to the open file.
+ * \param[out] riff pointer to the riff_chunks_m to be filled in.
+ *
+ * Jumps from chunk to chunk by their sizes, padded to even, reading only the
+ * 8 byte header of each, through SdVolume's cache. Such as past LIST or fact
+ * chunks, up to the "data" chunk. Taking the byte rate and block align of the
+ * "fmt " chunk on the way.
+ *
+ * \return true if a "fmt " chunk of up to WAV_FMT_MAX bytes, then a "data"
+ * chunk, were found.
+ */
+static bool riffWalk(SdBaseFile* file, riff_chunks_m* riff) {
+  uint8_t h[16];
+  uint32_t size;
+  uint32_t end = file->fileSize();
+
+  riff->byteRate = 0;
+  for(uint32_t pos = 12; pos + 8 <= end; pos += 8 + size + (size & 1)) {
+    if(!file->seekSet(pos) || (file->read(h, 8) != 8)) return false;
+    size = littleEndian(&h[4], 4);
+    if(!memcmp_P(h, PSTR("fmt "), 4)) {
+      if((size < 16) || (size > WAV_FMT_MAX) || (file->read(h, 16) != 16)) return false;
+      riff->fmt = pos + 8;
+      riff->fmtSize = size;
+      riff->byteRate = littleEndian(&h[8], 4);
+      riff->blockAlign = littleEndian(&h[12], 2);
+    } else if(!memcmp_P(h, PSTR("data"), 4)) {
+      riff->data = pos + 8;
+      riff->dataSize = (size < end - riff->data) ? size : end - riff->data;
+      return riff->byteRate && riff->blockAlign;
+    }
+    if(size > end - pos - 8) return false; // runs past the file
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Reposition the playing track
+ *
+ * \param[in] ms milliseconds from the begining of the track.
+ * \param[in] fade (optional) milliseconds to fade back in over.
+ *
+ * Common to skip(), skipTo() and playMP3() with a timecode. Fades out, stops
+ * the refill and finds the offset of ms by seekTime(). Then flushes the VSdsp
+ * by seekFlush(), restarts the position tracker from the offset, and the
+ * refill, and returns. The fade back in is started by volumeTick() once the
+ * VSdsp, still silent, has had VOLUME_RAMP_SETTLE to find its footing in the
+ * new stream. If the offset is not found, the refill restarts from where it
+ * was stopped.
+ *
+ * \return
+ * - 0 indicates the position was changed.
+ * - 2 indicates failure to skip to new file location.
+ */
+uint8_t SFEMP3Shield::seekTo(uint32_t ms, uint16_t fade) {
+  uint8_t result = 0;
+
+  //fade out what is playing, rather than cut it.
+  fadeOut(VOLUME_RAMP_SEEK);
+  fadeWait();
+
+  //stop interupt for now
+  disableRefill();
+  playing_state = paused_playback;
+  discardRefillBuffer();
+
+  uint32_t resume = tellTrack();
+  if(seekTime(&ms)) {
+    //seeked successfully
+    seekFlush();
+    positionStart(tellTrack(), ms);
+  } else {
+    seekTrack(resume);
+    result = 2;
+  }
+
+  //gotta start feeding that hungry mp3 chip
+  refill();
+
+  playing_state = playback;
+  //attach refill interrupt off DREQ line, pin 2
+  enableRefill();
+
+  //the volume was cut, so when the MP3 chip gets upset at me for just
+  //slammin in new bits of the file, you won't hear it. The ticks wait a
+  //bit, then fade back in while it plays.
+  fadeGain((uint32_t)VOLUME_CURVE_STEPS << 16, fade, VOLUME_RAMP_SETTLE);
+
+  return result;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Position the track at a time
+ *
+ * \param[in,out] ms milliseconds from the begining of the track, changed to
+ * those of the offset found.
+ *
+ * Finds the offset to play ms from, by the track's format:
+ * - WAV, at the byte rate of its fmt chunk, rounded down to its block align.
+ * - Ogg, by oggSeek() on the granule positions of its pages.
+ * - FLAC, by flacSeek() on its SEEKTABLE and the sample numbers of its frames.
+ * - otherwise at pos_rate, the MP3's bitrate or the VSdsp's measure of the
+ *   byte rate, as for an MP3.
+ *
+ * Then positions the track there by seekTrack(). The headers of an Ogg or
+ * FLAC are parsed by seekParse() at its first seek, those of a WAV as
+ * playMP3() starts it, or of a WAV clip at its first seek. The blocks read are
+ * counted in seek_blocks, as getSeekBlocks().
+ *
+ * \return true on success, false if the offset is not known or out of range.
+ *
+ * \note The refill must be stopped, as the track is read from elsewhere.
+ */
+bool SFEMP3Shield::seekTime(uint32_t* ms) {
+  uint32_t offset;
+
+  // a WAV clip, played from its RIFF header, is parsed at its first seek.
+  if(!seek_parsed && (streamHeaders() || (track_format == fmt_wav))) {
+    seekParse(start_of_music);
+    if(track_format == fmt_wav) {
+      if(seek_rate) pos_rate = seek_rate;
+      else track_format = fmt_unknown;
+    }
+  }
+  if(streamHeaders() && !seek_rate) return false;
+
+  if(track_format == fmt_wav) {
+    uint32_t bytes = muldiv(*ms, seek_rate, 1000);
+    bytes -= bytes % seek_align;
+    if(bytes > seek_end - seek_start) return false;
+    offset = seek_start + bytes;
+    *ms = muldiv(bytes, 1000, seek_rate);
+  } else if(track_format == fmt_ogg) {
+    offset = oggSeek(ms);
+  } else if(track_format == fmt_flac) {
+    offset = flacSeek(ms);
+  } else {
+    if(!pos_rate) return false;
+    offset = start_of_music + muldiv(*ms, pos_rate, 1000);
+  }
+  return seekTrack(offset);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Flush the VSdsp for a jump in the track
+ *
+ * A cancel ends the stream, so is only issued, by flush_cancel(pre), for
+ * formats without stream headers, such as MP3. A WAV is jumped in as is, on a
+ * block boundary. An Ogg or FLAC is sent end fill bytes, for its decoder to
+ * resync on the next page or frame, keeping its headers.
+ */
+void SFEMP3Shield::seekFlush() {
+  if(track_format == fmt_wav) return;
+  if(streamHeaders()) {
+    send_endfill(Mp3ReadWRAM(para_endFillByte) & 0xFF, 2052);
+  } else {
+    flush_cancel(pre); //possible mode of "none" for faster response.
+  }
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Check if the playing track starts with stream headers
+ *
+ * \return true for an Ogg or FLAC, whose headers the VSdsp needs to decode
+ * the rest. So the stream may only be jumped in once those are sent. A WAV's
+ * header is sent by wavHeader() ahead of wherever it starts.
+ */
+bool SFEMP3Shield::streamHeaders() {
+  return (track_format == fmt_ogg) || (track_format == fmt_flac);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Send the header of a WAV
+ *
+ * Sends the VSdsp a RIFF WAVE header of only the track's "fmt " chunk, as
+ * found by seekParse(), and the header of its "data" chunk. Leaving out any
+ * other chunks, such as LIST. So the stream may start at, or anywhere in, the
+ * data chunk, which the VSdsp then decodes from its first bytes.
+ */
+void SFEMP3Shield::wavHeader() {
+  uint8_t header[20 + WAV_FMT_MAX + 8];
+  uint16_t fmt = wav_fmtSize + (wav_fmtSize & 1);
+  uint32_t data = seek_end - seek_start;
+  uint32_t at = tellTrack();
+
+  memcpy_P(header, PSTR("RIFF"), 4);
+  putLittleEndian(&header[4], 4 + 8 + fmt + 8 + data);
+  memcpy_P(&header[8], PSTR("WAVEfmt "), 8);
+  putLittleEndian(&header[16], wav_fmtSize);
+  if(!track.seekSet(wav_fmt) || (track.read(&header[20], fmt) != fmt)) {
+    memset(&header[20], 0, fmt);
+  }
+  memcpy_P(&header[20 + fmt], PSTR("data"), 4);
+  putLittleEndian(&header[24 + fmt], data);
+  seekTrack(at);
+
+  dcs_low(); //Select Data
+  for(uint16_t y = 0 ; y < 28 + fmt ; y += 32) {
+    while(!digitalRead(MP3_DREQ));
+    uint16_t n = 28 + fmt - y;
+    if(n > 32) n = 32;
+    sdi_send(&header[y], n);
+  }
+  dcs_high(); //Deselect Data
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Parse the headers of a WAV, Ogg or FLAC for seeking
+ *
+ * \param[in] start offset of the stream, past any ID3v2 tag, as start_of_music.
+ *
+ * Fills in seek_start, seek_end, seek_rate and seek_align, and seek_table
+ * and seek_points, of the playing track:
+ * - WAV, by riffWalk(), the "data" chunk is the audio, at the byte rate and
+ *   block align of the "fmt " chunk. Which is kept in wav_fmt and
+ *   wav_fmtSize for wavHeader().
+ * - Ogg, takes the sample rate from the Vorbis identification header, alone
+ *   on the first page. Then walks the pages by their sizes to the first with a
+ *   granule position, the first of audio.
+ * - FLAC, walks the metadata blocks by their sizes, taking the sample rate and
+ *   any fixed block size from STREAMINFO, and where any SEEKTABLE is. The
+ *   first frame follows the last block.
+ *
+ * \return true if the headers are understood, else seek_rate is left 0.
+ */
+bool SFEMP3Shield::seekParse(uint32_t start) {
+  uint8_t h[20];
+  uint32_t pos = start;
+  uint32_t size = 0;
+  uint32_t rate = 0;
+  uint32_t granule, next;
+
+  seek_parsed = 1;
+  seek_rate = 0;
+  seek_align = 0;
+  seek_points = 0;
+  seek_end = track.fileSize();
+
+  if(track_format == fmt_wav) {
+    riff_chunks_m riff;
+    if(!riffWalk(&track, &riff)) return false;
+    wav_fmt = riff.fmt;
+    wav_fmtSize = riff.fmtSize;
+    seek_start = riff.data;
+    seek_end = riff.data + riff.dataSize;
+    seek_align = riff.blockAlign;
+    seek_rate = riff.byteRate;
+    return true;
+
+  } else if(track_format == fmt_ogg) {
+    if(!oggPage(pos, &granule, &next) || (seekRead(next - 30, h, 16) != 16)
+        || (h[0] != 1) || memcmp_P(&h[1], PSTR("vorbis"), 6)) return false;
+    rate = littleEndian(&h[12], 4);
+    for(pos = next; pos < seek_end; pos = next) {
+      if(!oggPage(pos, &granule, &next)) return false;
+      if(granule && (granule != OGG_NO_GRANULE)) break;
+    }
+    seek_start = pos;
+    seek_rate = rate;
+    return seek_rate != 0;
+
+  } else if(track_format == fmt_flac) {
+    // each block's header is its last flag and type, then its size.
+    for(pos += 4; pos + 4 <= seek_end; pos += 4 + size) {
+      if(seekRead(pos, h, 4) != 4) return false;
+      size = bigEndian(&h[1], 3);
+      if(size > seek_end - pos - 4) return false; // runs past the file
+      if((h[0] & 0x7F) == 0) { // STREAMINFO
+        if(seekRead(pos + 4, &h[4], 13) != 13) return false;
+        if(bigEndian(&h[4], 2) == bigEndian(&h[6], 2)) seek_align = bigEndian(&h[6], 2);
+        rate = bigEndian(&h[14], 3) >> 4;
+      } else if((h[0] & 0x7F) == 3) { // SEEKTABLE
+        seek_table = pos + 4;
+        seek_points = size / 18;
+      }
+      if(h[0] & 0x80) {
+        seek_start = pos + 4 + size;
+        seek_rate = rate;
+        return seek_rate != 0;
+      }
+    }
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Read the track while seeking
+ *
+ * \param[in] position offset to read from.
+ * \param[out] buf pointer to where the bytes read are to be put.
+ * \param[in] nbyte number of bytes to be read, at least 1.
+ *
+ * Counts the blocks read in seek_blocks, those of consecutive reads of the
+ * same block once, as SdVolume's cache holds it.
+ *
+ * \return the number of bytes read, or -1 on failure, as SdBaseFile::read().
+ */
+int16_t SFEMP3Shield::seekRead(uint32_t position, void* buf, uint16_t nbyte) {
+  uint32_t first = position >> 9;
+  uint32_t last = (position + nbyte - 1) >> 9;
+
+  seek_blocks += last - first + ((first != seek_lastBlock) || !seek_blocks);
+  seek_lastBlock = last;
+  if(!track.seekSet(position)) return -1;
+  return track.read(buf, nbyte);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Find the next Ogg page or FLAC frame
+ *
+ * \param[in] from offset to search from.
+ * \param[in] to offset to search before.
+ * \param[out] value the granule position of the page, or sample number of
+ * the frame.
+ *
+ * Reads the track in bursts of 32 bytes, overlapping by one, for the capture
+ * pattern of a page with a granule position, by oggPage(). Or for the sync
+ * code of a frame, by flacFrame(), which checks the header as the sync code
+ * may occur in the audio.
+ *
+ * \return the offset of the page or frame, or 0 if none starts before \c to.
+ */
+uint32_t SFEMP3Shield::seekSync(uint32_t from, uint32_t to, uint32_t* value) {
+  uint8_t buffer[32];
+  uint32_t next;
+  bool ogg = (track_format == fmt_ogg);
+
+  while(from < to) {
+    int16_t n = seekRead(from, buffer, sizeof(buffer));
+    if(n < 2) break;
+    for(int16_t i = 0; i + 1 < n; i++) {
+      uint32_t pos = from + i;
+      if(pos >= to) return 0;
+      if(ogg ? ((buffer[i] == 'O') && (buffer[i + 1] == 'g')
+                && oggPage(pos, value, &next) && (*value != OGG_NO_GRANULE))
+             : ((buffer[i] == 0xFF) && ((buffer[i + 1] & 0xFE) == 0xF8)
+                && flacFrame(pos, value))) {
+        return pos;
+      }
+    }
+    from += n - 1;
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Scale bytes by a ratio of samples
+ *
+ * \param[in] bytes to be scaled.
+ * \param[in] num numerator of the ratio.
+ * \param[in] den denominator of the ratio.
+ *
+ * Both are shifted down to 16 bits, as muldiv() needs, precise enough for an
+ * estimate.
+ *
+ * \return bytes * num / den, or 0xFFFFFFFF if den is 0 at that precision.
+ */
+static uint32_t interpolate(uint32_t bytes, uint32_t num, uint32_t den) {
+  while((num | den) > 0xFFFF) {
+    num >>= 1;
+    den >>= 1;
+  }
+  if(!den) return 0xFFFFFFFF;
+  return (bytes / den) * num + ((bytes % den) * num) / den;
+}
+
+/**
+ * \brief Bisect the track for a page or frame before a sample
+ *
+ * \param[in] target samples from the begining of the track.
+ * \param[in,out] lo offset of a page or frame before target, moved to that of
+ * one within about SEEK_SPAN bytes of it.
+ * \param[in,out] found granule position or sample number at lo.
+ * \param[in] hi offset past the target.
+ * \param[in] top granule position or sample number at hi, 0 if not known.
+ *
+ * Each step reads the first page or frame from a point between lo and hi, by
+ * seekSync(). Moving lo up to it if before target, else hi down to the point.
+ * The point is interpolated between lo and hi by their samples, or until
+ * those at hi are known extrapolated from the start, less half of SEEK_SPAN
+ * as to land just before target. Which a steady byte rate narrows to in a few
+ * steps. Should two in a row not halve the range, the next point is halfway.
+ */
+void SFEMP3Shield::seekBisect(uint32_t target, uint32_t* lo, uint32_t* found, uint32_t hi, uint32_t top) {
+  uint32_t start = *lo;
+  uint32_t first = *found;
+  uint8_t slow = 0;
+  uint32_t value;
+
+  while(hi - *lo > SEEK_SPAN) {
+    uint32_t span = hi - *lo;
+    uint32_t point = *lo + span / 2;
+    bool guessed = false;
+
+    if(slow < 2) {
+      uint32_t guess = 0xFFFFFFFF;
+      if(top > target) {
+        guess = interpolate(span, target - *found, top - *found);
+      } else if(*found > first) {
+        guess = interpolate(*lo - start, target - *found, *found - first);
+      }
+      if(guess < SEEK_SPAN) break; // near enough.
+      if(guess < span) {
+        point = *lo + guess - SEEK_SPAN / 2;
+        guessed = true;
+      }
+    }
+
+    uint32_t at = seekSync(point, hi, &value);
+    if(!at || (value >= target)) {
+      hi = point;
+      if(at) top = value;
+    } else {
+      *lo = at;
+      *found = value;
+    }
+    slow = (guessed && (hi - *lo > span / 2)) ? slow + 1 : 0;
+  }
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Read the header of an Ogg page
+ *
+ * \param[in] pos offset of the page.
+ * \param[out] granule the page's granule position, the samples completed by
+ * its end, or OGG_NO_GRANULE.
+ * \param[out] next offset of the page after, past its header, segment table
+ * and the segments it lists.
+ *
+ * \return true if a page of version 0 starts at pos.
+ */
+bool SFEMP3Shield::oggPage(uint32_t pos, uint32_t* granule, uint32_t* next) {
+  uint8_t h[27];
+
+  if((seekRead(pos, h, sizeof(h)) != sizeof(h)) || memcmp_P(h, PSTR("OggS"), 4)
+      || h[4]) return false;
+  *granule = littleEndian(&h[10], 4) ? OGG_NO_GRANULE : littleEndian(&h[6], 4);
+
+  uint16_t segments = h[26];
+  *next = pos + sizeof(h) + segments;
+  for(uint16_t i = 0; i < segments; i += sizeof(h)) {
+    uint8_t n = (segments - i < (uint16_t)sizeof(h)) ? segments - i : sizeof(h);
+    if(seekRead(pos + sizeof(h) + i, h, n) != n) return false;
+    while(n) *next += h[--n];
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Find the page of an Ogg to play a time from
+ *
+ * \param[in,out] ms milliseconds from the begining of the track, changed to
+ * those of the page found.
+ *
+ * Bisects the audio, by seekBisect(), for a page with a granule position
+ * before the samples of ms, at seek_rate. Then steps from it, page by page,
+ * to the page completing the samples of ms, played from. As a granule
+ * position is that of the end of its page, the time found is that of the
+ * page before.
+ *
+ * \return the offset of the page.
+ */
+uint32_t SFEMP3Shield::oggSeek(uint32_t* ms) {
+  uint32_t target = muldiv(*ms, seek_rate, 1000);
+  uint32_t lo = seek_start;
+  uint32_t found = 0;
+  uint32_t page, granule, next;
+
+  seekBisect(target, &lo, &found, seek_end, 0);
+  for(page = lo; page < seek_end; page = next) {
+    if(!oggPage(page, &granule, &next)) break;
+    if(granule != OGG_NO_GRANULE) {
+      if(granule >= target) break;
+      found = granule;
+    }
+  }
+  *ms = muldiv(found, 1000, seek_rate);
+  return page;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Check for the header of a FLAC frame
+ *
+ * \param[in] pos offset of the candidate frame's sync code.
+ * \param[out] sample number of the frame's first sample.
+ *
+ * Checks the header's reserved values and its CRC-8. The number coded in it,
+ * in the manner of UTF-8, is the sample number if of variable block size,
+ * else the frame number, of seek_align samples each.
+ *
+ * \return true if a valid frame header.
+ */
+bool SFEMP3Shield::flacFrame(uint32_t pos, uint32_t* sample) {
+  uint8_t h[16];
+  int16_t n = seekRead(pos, h, sizeof(h));
+
+  if((n < 6) || (h[0] != 0xFF) || ((h[1] & 0xFE) != 0xF8) || !(h[2] & 0xF0)
+      || ((h[2] & 0x0F) == 0x0F) || (h[3] >= 0xB0) || ((h[3] & 0x06) == 0x06)
+      || (h[3] & 0x01)) return false;
+
+  uint8_t length = 1;
+  uint32_t number = h[4];
+  if(h[4] & 0x80) {
+    while((length < 7) && (h[4] & (0x80 >> length))) length++;
+    if((length == 1) || (h[4] == 0xFF)) return false;
+    number = h[4] & (0x7F >> length);
+    for(uint8_t i = 1; i < length; i++) {
+      if((h[4 + i] & 0xC0) != 0x80) return false;
+      number = (number << 6) | (h[4 + i] & 0x3F);
+    }
+  }
+
+  // past the block size and sample rate, if not coded in the first bytes.
+  uint8_t end = 4 + length;
+  if((h[2] >> 4) == 6) end += 1;
+  else if((h[2] >> 4) == 7) end += 2;
+  if((h[2] & 0x0F) == 12) end += 1;
+  else if((h[2] & 0x0F) >= 13) end += 2;
+  if(n <= end) return false;
+
+  // CRC-8, polynomial x^8 + x^2 + x + 1, of the header before it.
+  uint8_t crc = 0;
+  for(uint8_t i = 0; i < end; i++) {
+    crc ^= h[i];
+    for(uint8_t b = 0; b < 8; b++) crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+  }
+  if(crc != h[end]) return false;
+
+  if(h[1] & 0x01) {
+    *sample = number;
+  } else if(seek_align) {
+    *sample = number * seek_align;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Find the frame of a FLAC to play a time from
+ *
+ * \param[in,out] ms milliseconds from the begining of the track, changed to
+ * those of the frame found.
+ *
+ * If the FLAC has a SEEKTABLE, bisects it for the points around the samples
+ * of ms, at seek_rate, narrowing the audio to between them. Then bisects the
+ * frames between, by seekBisect(), for one starting at or before those
+ * samples.
+ *
+ * \return the offset of the frame.
+ */
+uint32_t SFEMP3Shield::flacSeek(uint32_t* ms) {
+  uint8_t point[18];
+  uint32_t target = muldiv(*ms, seek_rate, 1000);
+  uint32_t lo = seek_start;
+  uint32_t hi = seek_end;
+  uint32_t found = 0;
+  uint32_t top = 0;
+
+  if(seek_points) {
+    // each point is the sample number, offset from the first frame and samples
+    // of a frame, big endian, sorted. Placeholders, of all ones, are last.
+    uint16_t first = 0;
+    uint16_t last = seek_points;
+    while(first < last) {
+      uint16_t mid = first + (last - first) / 2;
+      if(seekRead(seek_table + mid * 18UL, point, sizeof(point)) != sizeof(point)) return lo;
+      if(!bigEndian(point, 4) && (bigEndian(&point[4], 4) <= target)) first = mid + 1;
+      else last = mid;
+    }
+    if(first && (seekRead(seek_table + (first - 1) * 18UL, point, sizeof(point)) == sizeof(point))
+        && (seek_start + bigEndian(&point[12], 4) < seek_end)) {
+      lo = seek_start + bigEndian(&point[12], 4);
+      found = bigEndian(&point[4], 4);
+    }
+    if((first < seek_points) && (seekRead(seek_table + first * 18UL, point, sizeof(point)) == sizeof(point))
+        && !bigEndian(point, 4) && (seek_start + bigEndian(&point[12], 4) > lo)
+        && (seek_start + bigEndian(&point[12], 4) < seek_end)) {
+      hi = seek_start + bigEndian(&point[12], 4);
+      top = bigEndian(&point[4], 4);
+    }
+  }
+
+  seekBisect(target + 1, &lo, &found, hi, top);
+  *ms = muldiv(found, 1000, seek_rate);
+  return lo;
+}
+
+#if USE_CUE_TRACK
+//------------------------------------------------------------------------------
+/**
+ * \brief Open the cue file of a track
+ *
+ * \param[in] fileName pointer of a char array (aka string), contianing the
+ * track's filename.
+ *
+ * Closes the cues of any prior track, then opens the file of the same name
+ * with the extension ".cue", and verifies its header. It is fine for a track
+ * to have none. Its cues are read ahead by cueSeek() as the position starts.
+ */
+void SFEMP3Shield::openCues(char* fileName) {
+  cue_header_m header;
+  char cueName[32];
+
+  closeCues();
+
+  // replace the extension, if the name and ".cue" fit.
+  uint8_t length = 0;
+  uint8_t dot = 0;
+  while(fileName[length]) {
+    if(fileName[length] == '.') dot = length;
+    else if(fileName[length] == '/') dot = 0;
+    length++;
+  }
+  if(dot) length = dot;
+  if(length > sizeof(cueName) - 5) return;
+  memcpy(cueName, fileName, length);
+  strcpy(&cueName[length], ".cue");
+
+  if(!cues.open(cueName, O_READ)) return;
+  if((cues.read(&header, sizeof(header)) != sizeof(header))
+      || memcmp(header.magic, "SCUE", 4) || (header.version != CUE_VERSION))
+    cues.close();
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Close the cue file
+ *
+ * Any cues read ahead are dropped.
+ */
+void SFEMP3Shield::closeCues() {
+  cues.close();
+  cue_head = 0;
+  cue_tail = 0;
+  cue_remaining = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Reposition the cues
+ *
+ * \param[in] ms milliseconds into the track.
+ *
+ * Drops the cues read ahead. Then bisects the cue file for the first cue due
+ * at or after ms, a few block reads, and reads ahead from there.
+ */
+void SFEMP3Shield::cueSeek(uint32_t ms) {
+  cue_head = 0;
+  cue_tail = 0;
+  cue_remaining = 0;
+  if(!cues.isOpen()) return;
+
+  uint32_t lo = 0;
+  uint32_t hi = (cues.fileSize() - sizeof(cue_header_m)) / sizeof(cue_m);
+  uint32_t count = hi;
+  while(lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    uint32_t time;
+    if(!cues.seekSet(sizeof(cue_header_m) + mid * sizeof(cue_m))
+        || (cues.read(&time, sizeof(time)) != sizeof(time)))
+      return;
+    if(time < ms) lo = mid + 1;
+    else hi = mid;
+  }
+
+  if(!cues.seekSet(sizeof(cue_header_m) + lo * sizeof(cue_m))) return;
+  cue_remaining = count - lo;
+  cueRead();
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Read ahead the cues
+ *
+ * Reads the next cues into the buffer, in blocks of half its size, once that
+ * much is free, as sequenceAvailable().
+ */
+void SFEMP3Shield::cueRead() {
+  while(cue_remaining) {
+    uint8_t space = (cue_tail + CUE_BUFFER - cue_head - 1) % CUE_BUFFER;
+
+    // read in blocks of half the buffer, or whatever remains.
+    if((space < CUE_BUFFER / 2) && (space < cue_remaining)) break;
+    uint8_t n = CUE_BUFFER - cue_head; // up to the end of the buffer.
+    if(n > space) n = space;
+    if(n > cue_remaining) n = cue_remaining;
+    if(!n) break;
+
+    if(cues.read(&cue_buffer[cue_head], n * sizeof(cue_m))
+        != (int16_t)(n * sizeof(cue_m))) {
+      cue_remaining = 0; // truncated or unreadable, take what was read.
+      break;
+    }
+    cue_remaining -= n;
+    cue_head = (cue_head + n) % CUE_BUFFER;
+  }
+}
+#endif
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Check if the opened track may be read by raw block address
+ *
+ * \param[in] firstBlock (optional) of the track, if already known to be
+ * contiguous, such as by preloadClip(). Otherwise 0.
+ *
+ * When MP3_REFILL_RAW is enabled, check once at open if the track is
+ * contiguous. If so refill() streams it by raw multiple block reads from the
+ * track's current position, bypassing the FAT and SdVolume's cache.
+ * Otherwise refill() reads it with SdBaseFile::read().
+ */
+void SFEMP3Shield::openRaw(uint32_t firstBlock) {
+  raw_end = 0;
+#if MP3_REFILL_RAW
+  uint32_t lastBlock;
+  raw_firstBlock = firstBlock;
+  if(raw_firstBlock || track.contiguousRange(&raw_firstBlock, &lastBlock)) {
+    raw_position = track.curPosition();
+    raw_end = track.fileSize();
+  }
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Refill the block buffer
+ *
+ * Primative function to read up to the next block boundary into
+ * mp3BlockBuffer, thereafter whole blocks are read. A sound bank's clip, or a
+ * contiguous track, is read by raw block address straight from the SdCard,
+ * leaving SdVolume's cache to the sketch's file operations. When
+ * MP3_REFILL_RAW is enabled each block is received by Sd2Card::readData() of
+ * one multiple block read, left open between calls. It is only restarted,
+ * with Sd2Card::readStart(), when the block needed is not the next of the
+ * read, such as after a seek or endRawRead(). Otherwise each is read by
+ * Sd2Card::readBlock().
+ *
+ * Other tracks are read with SdBaseFile::read(), which also reads whole
+ * blocks straight into mp3BlockBuffer once aligned, by DMA where supported.
+ *
+ * \return the number of bytes available in mp3BlockBuffer, 0 at the end of
+ * the track or clip.
+ */
+uint16_t SFEMP3Shield::fillBlockBuffer() {
+  mp3BlockHead = 0;
+  mp3BlockCount = 0;
+
+  if(raw_end) {
+    if(raw_position >= raw_end) return 0;
+    uint32_t aligned = raw_position & ~(uint32_t)0x1FF;
+    uint32_t block = raw_firstBlock + (raw_position >> 9);
+
+#if MP3_REFILL_RAW
+    if(block != raw_nextBlock) {
+      endRawRead();
+      // end any other open transaction, such as an SdLogger's write.
+      SdSpiBus::preempt();
+      // file operations end the read before using the card. Without a free
+      // preempt slot the block is read singly.
+      if(SdSpiBus::addPreempt(endRawRead)) {
+        if(!sd.card()->readStart(block)) return 0;
+        raw_nextBlock = block;
+      }
+    }
+    if(raw_nextBlock) {
+      raw_nextBlock++;
+      if(!sd.card()->readData(mp3BlockBuffer)) {
+        endRawRead();
+        return 0;
+      }
+    } else if(!sd.card()->readBlock(block, mp3BlockBuffer)) {
+      return 0;
+    }
+#else
+    // end any other open transaction, such as an SdLogger's write.
+    SdSpiBus::preempt();
+    if(!sd.card()->readBlock(block, mp3BlockBuffer)) return 0;
+#endif
+
+    mp3BlockHead = raw_position & 0x1FF;
+    mp3BlockCount = (raw_end - aligned < sizeof(mp3BlockBuffer)) ?
+                    raw_end - aligned : sizeof(mp3BlockBuffer);
+    raw_position = aligned + mp3BlockCount;
+    return mp3BlockCount - mp3BlockHead;
+  }
+
+  uint16_t n = sizeof(mp3BlockBuffer) - (track.curPosition() % sizeof(mp3BlockBuffer));
+  int16_t result = track.read(mp3BlockBuffer, n);
+  mp3BlockCount = (result > 0) ? result : 0;
+  return mp3BlockCount;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief End refill()'s multiple block read
+ *
+ * Stops the SdCard's multiple block read, if one is open, so the card may be
+ * used otherwise. Added to SdSpiBus's preempt handlers as the first read
+ * starts, so it is called by the outermost lock() of any file operation, and
+ * called as the track is stopped or ends.
+ *
+ * \note Does nothing unless MP3_REFILL_RAW is enabled.
+ */
+void SFEMP3Shield::endRawRead() {
+#if MP3_REFILL_RAW
+  if(raw_nextBlock) {
+    raw_nextBlock = 0;
+    sd.card()->readStop();
+  }
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief uint16_t Overload of SFEMP3Shield::Mp3WriteRegister
+ *
+ * \param[in] addressbyte of the VSdsp's register to be written
+ * \param[in] data to writen to the register
+ *
+ * Forces the input value into the Big Endian Corresponding positions of
+ * Mp3WriteRegister as to be written to the addressed VSdsp's registers.
+ */
+void SFEMP3Shield::Mp3WriteRegister(uint8_t addressbyte, uint16_t data) {
+  union twobyte val;
+  val.word = data;
+  Mp3WriteRegister(addressbyte, val.byte[1], val.byte[0]);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Write a value a VSDsp's register.
+ *
+ * \param[in] addressbyte of the VSdsp's register to be written
+ * \param[in] highbyte to writen to the register
+ * \param[in] lowbyte to writen to the register
+ *
+ * Primative function to suspend playing and directly communicate over the SPI
+ * to the VSdsp's registers. Where the value write is Big Endian (MSB first).
  */
 void SFEMP3Shield::Mp3WriteRegister(uint8_t addressbyte, uint8_t highbyte, uint8_t lowbyte) {
 
@@ -1866,8 +3710,7 @@ uint16_t SFEMP3Shield::Mp3ReadRegister (uint8_t addressbyte){
 
   while(!digitalRead(MP3_DREQ)) ; //Wait for DREQ to go high indicating IC is available
 
-  cs_low(); //Select control
-  SPI.setClockDivider(spi_Read_Rate); // correct the clock speed as from cs_low()
+  cs_low(spi_Read_Rate); //Select control, at the slower read rate
 
   //SCI consists of instruction byte, address byte, and 16-bit data word.
   SPI.transfer(0x03);  //Read instruction
@@ -1905,10 +3748,6 @@ uint16_t SFEMP3Shield::Mp3ReadWRAM (uint16_t addressbyte){
 
   unsigned short int tmp1,tmp2;
 
-  //Set SPI bus for write
-  spiInit();
-  SPI.setClockDivider(spi_Read_Rate);
-
   Mp3WriteRegister(SCI_WRAMADDR, addressbyte);
   tmp1 = Mp3ReadRegister(SCI_WRAM);
 
@@ -1949,6 +3788,8 @@ void SFEMP3Shield::Mp3WriteWRAM(uint16_t addressbyte, uint16_t data){
  *
  * Serves as a helper as to correspondingly run either the timer service or run
  * the refill() direclty, depending upon the configured means for refilling.
+ * Also writes a volume step left pending by volumeTick() while nothing is
+ * playing.
  */
 void SFEMP3Shield::available() {
 #if defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer
@@ -1956,6 +3797,7 @@ void SFEMP3Shield::available() {
 #elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_Polled
   refill();
 #endif
+  volumeAvailable();
 }
 
 //------------------------------------------------------------------------------
@@ -1974,20 +3816,40 @@ void SFEMP3Shield::available() {
  */
 void SFEMP3Shield::refill() {
 
+  // already refilling, the outer call keeps going while DREQ is high.
+  if(refill_active) return;
+
+  // the SdCard is mid transaction, retry as soon as it releases the bus.
+  if(SdSpiBus::busy()) {
+    SdSpiBus::defer(refill);
+    return;
+  }
+  refill_active = 1;
+
   //Serial.println(F("filling"));
 #if PERF_MON_PIN != -1
   digitalWrite(PERF_MON_PIN,LOW);
 #endif
 
   // no need to keep interrupts blocked, allow other ISR such as timer0 to continue
-#if !defined(USE_MP3_REFILL_MEANS) || USE_MP3_REFILL_MEANS == USE_MP3_INTx
+#if !defined(USE_MP3_REFILL_MEANS) || USE_MP3_REFILL_MEANS == USE_MP3_INTx \
+    || USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog
   sei();
 #endif
 
+  // a volume step is written here, where nothing else uses the VSdsp.
+  if(vol_pending && digitalRead(MP3_DREQ)) volumeWrite();
+
   while(digitalRead(MP3_DREQ)) {
 
-    if(!track.read(mp3DataBuffer, sizeof(mp3DataBuffer))) { //Go out to SD card and try reading 32 new bytes of the song
+    //Go out to SD card for the next block of the song, once the last is sent
+    if((mp3BlockHead >= mp3BlockCount) && !fillBlockBuffer()) {
+      endRawRead();
       track.close(); //Close out this track
+      raw_end = 0;
+#if USE_CUE_TRACK
+      closeCues();
+#endif
       playing_state = ready;
 
       //cancel external interrupt
@@ -2001,26 +3863,40 @@ void SFEMP3Shield::refill() {
     }
 
 
-    //Once DREQ is released (high) we now feed 32 bytes of data to the VS1053 from our SD read buffer
-#if !defined(USE_MP3_REFILL_MEANS) || USE_MP3_REFILL_MEANS == USE_MP3_INTx
+    // DREQ guarantees room for 32 bytes, send them as one burst.
+    uint16_t burst = mp3BlockCount - mp3BlockHead;
+    if(burst > 32) burst = 32;
+#if MP3_REFILL_DMA
+    sdi_low(); //Select Data
+    sdi.send(&mp3BlockBuffer[mp3BlockHead], burst);
+#else
+#if !defined(USE_MP3_REFILL_MEANS) || USE_MP3_REFILL_MEANS == USE_MP3_INTx \
+    || USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog
     cli(); // allow transfer to occur with out interruption.
 #endif
     dcs_low(); //Select Data
-    for(uint8_t y = 0 ; y < sizeof(mp3DataBuffer) ; y++) {
-      //while(!digitalRead(MP3_DREQ)); // wait until DREQ is or goes high // turns out it is not needed.
-      SPI.transfer(mp3DataBuffer[y]); // Send SPI byte
-    }
-
+    sdi_send(&mp3BlockBuffer[mp3BlockHead], burst);
+#endif
     dcs_high(); //Deselect Data
-    //We've just dumped 32 bytes into VS1053 so our SD read buffer is empty. go get more data
-#if !defined(USE_MP3_REFILL_MEANS) || USE_MP3_REFILL_MEANS == USE_MP3_INTx
+#if !MP3_REFILL_DMA && (!defined(USE_MP3_REFILL_MEANS) || USE_MP3_REFILL_MEANS == USE_MP3_INTx \
+    || USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog)
     sei();
 #endif
+    mp3BlockHead += burst;
+    pos_fed += burst;
+  }
+
+  // all that the first refill sent is waiting in the VSdsp's buffer.
+  if(!pos_primed) {
+    uint32_t held = pos_fed - pos_segment;
+    pos_latency = (held > 0xFFFF) ? 0xFFFF : held;
+    pos_primed = 1;
   }
 
 #if PERF_MON_PIN != -1
   digitalWrite(PERF_MON_PIN,HIGH);
 #endif
+  refill_active = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -2033,44 +3909,505 @@ void SFEMP3Shield::refill() {
  * stored into an array that can be delivered via SPI to the VSdsp's data stream 
  * buffer. Waiting for DREQ every 32 bytes.
  */
-void SFEMP3Shield::SendSingleMIDInote() {
+void SFEMP3Shield::SendSingleMIDInote() {
+
+  if(!digitalRead(MP3_RESET))
+    return;
+
+  //cancel and store current state to restore after
+  disableRefill();
+  state_m prv_state = playing_state;
+  playing_state = playMIDIbeep;
+  
+  // need to quickly purge the exiting formate of decoder.
+  flush_cancel(none);
+
+  // wait for VS1053 to be available.
+  while(!digitalRead(MP3_DREQ)); 
+
+#if !defined(USE_MP3_REFILL_MEANS) || USE_MP3_REFILL_MEANS == USE_MP3_INTx \
+    || USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog
+  cli(); // allow transfer to occur with out interruption.
+#endif
+
+  dcs_low(); //Select Data
+  for(uint16_t y = 0 ; y < sizeof(SingleMIDInoteFile) ; y += 32) {
+    // Every 32 check if not ready for next buffer chunk.
+    while(!digitalRead(MP3_DREQ));
+    uint16_t n = sizeof(SingleMIDInoteFile) - y;
+    if(n > 32) n = 32;
+    sdi_send_P(&SingleMIDInoteFile[y], n);
+  }
+  dcs_high(); //Deselect Data
+
+#if !defined(USE_MP3_REFILL_MEANS) || USE_MP3_REFILL_MEANS == USE_MP3_INTx \
+    || USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog
+  sei();  // renable interrupts for other processes
+#endif
+
+  flush_cancel(none); // need to quickly purge the exiting format of decoder.
+  playing_state = prv_state;
+  enableRefill();
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Start real-time MIDI
+ *
+ * Loads the rtmidi.053 plugin, which starts the VSdsp's real-time MIDI mode.
+ * Thereafter every byte on the data stream is taken as a MIDI message byte,
+ * and played as it arrives. Use noteOn(), noteOff(), controlChange() and
+ * programChange() to send messages, and midiEnd() to return to playing files.
+ *
+ * The queue and statistics of messages are cleared.
+ *
+ * \return Any Value other than zero indicates a problem occured.
+ * - 0 indicates that real-time MIDI was started.
+ * - 1 indicates it can not be started while currently streaming music.
+ * - 2 indicates that rtmidi.053 was not found.
+ * - 3 indicates that the VSdsp is in reset.
+ *
+ * \see
+ * - \ref Error_Codes
+ * - \ref Plug_Ins
+ */
+uint8_t SFEMP3Shield::midiBegin() {
+
+  if(!digitalRead(MP3_RESET)) return 3;
+  if(isPlaying() != FALSE) return 1;
+  if(playing_state == playRealTimeMIDI) return 0;
+
+  playing_state = loading;
+  if(VSLoadUserCode("rtmidi.053")) {
+    playing_state = ready;
+    return 2;
+  }
+
+  midi_head = 0;
+  midi_tail = 0;
+  clearMidiStats();
+  playing_state = playRealTimeMIDI;
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief End real-time MIDI
+ *
+ * Stops any sequence and sends any messages still queued, then resets the
+ * VSdsp with vs_init(), as the only way out of real-time MIDI mode, so that
+ * files may be played again.
+ *
+ * \return Any Value other than zero indicates a problem occured.
+ * - 0 indicates that the VSdsp is ready to play files.
+ * - 1 indicates that real-time MIDI was not started.
+ * - 3 indicates that the VSdsp is in reset.
+ * - otherwise the error code of vs_init(), as begin().
+ */
+uint8_t SFEMP3Shield::midiEnd() {
+
+  if(!digitalRead(MP3_RESET)) return 3;
+  if(playing_state != playRealTimeMIDI) return 1;
+
+#if USE_MIDI_SEQUENCER
+  stopSequence();
+#endif
+  while(midi_tail != midi_head) midiFlush();
+
+  uint8_t result = vs_init();
+  if(result) return result;
+
+  playing_state = ready;
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Send a real-time MIDI Note On message
+ *
+ * \param[in] channel 0 through 15, where 9 is percussion.
+ * \param[in] note 0 through 127, or the instrument on channel 9.
+ * \param[in] velocity 0 through 127, where 0 is as Note Off.
+ *
+ * \return Any Value other than zero indicates a problem occured.
+ * - 0 indicates the message was sent or queued.
+ * - 1 indicates that real-time MIDI was not started with midiBegin().
+ * - 3 indicates that the VSdsp is in reset.
+ */
+uint8_t SFEMP3Shield::noteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+  return midiQueue(0x90 | (channel & 0x0F), note, velocity, 3);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Send a real-time MIDI Note Off message
+ *
+ * \param[in] channel 0 through 15, where 9 is percussion.
+ * \param[in] note 0 through 127, or the instrument on channel 9.
+ * \param[in] velocity (optional) 0 through 127 of the release.
+ *
+ * \return Any Value other than zero indicates a problem occured.
+ * - 0 indicates the message was sent or queued.
+ * - 1 indicates that real-time MIDI was not started with midiBegin().
+ * - 3 indicates that the VSdsp is in reset.
+ */
+uint8_t SFEMP3Shield::noteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+  return midiQueue(0x80 | (channel & 0x0F), note, velocity, 3);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Send a real-time MIDI Control Change message
+ *
+ * \param[in] channel 0 through 15.
+ * \param[in] controller 0 through 127, such as 7 for the channel's volume.
+ * \param[in] value 0 through 127.
+ *
+ * \return Any Value other than zero indicates a problem occured.
+ * - 0 indicates the message was sent or queued.
+ * - 1 indicates that real-time MIDI was not started with midiBegin().
+ * - 3 indicates that the VSdsp is in reset.
+ */
+uint8_t SFEMP3Shield::controlChange(uint8_t channel, uint8_t controller, uint8_t value) {
+  return midiQueue(0xB0 | (channel & 0x0F), controller, value, 3);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Send a real-time MIDI Program Change message
+ *
+ * \param[in] channel 0 through 15.
+ * \param[in] program 0 through 127, the GM instrument less one.
+ *
+ * \return Any Value other than zero indicates a problem occured.
+ * - 0 indicates the message was sent or queued.
+ * - 1 indicates that real-time MIDI was not started with midiBegin().
+ * - 3 indicates that the VSdsp is in reset.
+ */
+uint8_t SFEMP3Shield::programChange(uint8_t channel, uint8_t program) {
+  return midiQueue(0xC0 | (channel & 0x0F), program, 0, 2);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Queue a real-time MIDI message and send what the VSdsp has room for
+ *
+ * \param[in] status byte of the message, including its channel.
+ * \param[in] data1 first data byte.
+ * \param[in] data2 second data byte, if any.
+ * \param[in] length of the message, 2 or 3 bytes.
+ *
+ * Primative function to time stamp and queue the message, then midiFlush().
+ * Should the queue be full, waits on DREQ for room, counting a stall.
+ *
+ * \return as noteOn().
+ */
+uint8_t SFEMP3Shield::midiQueue(uint8_t status, uint8_t data1, uint8_t data2, uint8_t length) {
+
+  if(!digitalRead(MP3_RESET)) return 3;
+  if(playing_state != playRealTimeMIDI) return 1;
+
+  uint8_t next = (midi_head + 1) % MIDI_QUEUE_SIZE;
+  if(next == midi_tail) {
+    midi_stats.stalls++;
+    while(next == midi_tail) midiFlush();
+  }
+
+  midi_event_m* event = &midi_queue[midi_head];
+  event->msg[0] = status;
+  event->msg[1] = data1 & 0x7F;
+  event->msg[2] = data2 & 0x7F;
+  event->length = length;
+  event->time = micros();
+  midi_head = next;
+
+  midiFlush();
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Send queued real-time MIDI messages
+ *
+ * Sends as many queued messages as the VSdsp has room for. Up to 5 messages
+ * are sent per 32 bytes guaranteed by DREQ, within one selection of the data
+ * stream. DREQ is checked once selected, as the sequencer's ISR is then held
+ * off and can not take the room meanwhile.
+ *
+ * Called by each message. Call it also from loop(), should messages be sent
+ * faster than the VSdsp takes them, as to send those left queued.
+ */
+void SFEMP3Shield::midiFlush() {
+
+  while(midi_tail != midi_head) {
+    dcs_low(); //Select Data
+    if(!digitalRead(MP3_DREQ)) {
+      dcs_high(); //Deselect Data
+      return;
+    }
+    for(uint8_t room = 32; (midi_tail != midi_head) && (room >= 6); room -= 6) {
+      midi_event_m* event = &midi_queue[midi_tail];
+      midiWrite(event, micros() - event->time);
+      midi_tail = (midi_tail + 1) % MIDI_QUEUE_SIZE;
+    }
+    dcs_high(); //Deselect Data
+  }
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Write a real-time MIDI message to the VSdsp
+ *
+ * \param[in] event the message to be written.
+ * \param[in] latency microseconds the message waited, for the statistics.
+ *
+ * Primative function to write each MIDI byte padded to a 16 bit word on the
+ * data stream, as rtmidi.053 expects. The data stream must be selected with
+ * dcs_low() and DREQ high.
+ */
+void SFEMP3Shield::midiWrite(const midi_event_m* event, uint32_t latency) {
+  uint8_t words[6];
+
+  for(uint8_t i = 0; i < event->length; i++) {
+    words[2 * i] = 0;
+    words[2 * i + 1] = event->msg[i];
+  }
+  sdi_send(words, 2 * event->length);
+
+  if(!midi_stats.sent || (latency < midi_stats.minLatency)) midi_stats.minLatency = latency;
+  if(latency > midi_stats.maxLatency) midi_stats.maxLatency = latency;
+  midi_stats.totalLatency += latency;
+  midi_stats.sent++;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Get the statistics of real-time MIDI messages
+ *
+ * \param[out] stats copy of the statistics since midiBegin() or clearMidiStats().
+ */
+void SFEMP3Shield::getMidiStats(midi_stats_m* stats) {
+  noInterrupts(); // the sequencer's ISR may be adding to them.
+  *stats = midi_stats;
+  interrupts();
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Clear the statistics of real-time MIDI messages
+ */
+void SFEMP3Shield::clearMidiStats() {
+  noInterrupts();
+  memset(&midi_stats, 0, sizeof(midi_stats));
+  interrupts();
+}
+
+#if USE_MIDI_SEQUENCER
+//------------------------------------------------------------------------------
+/**
+ * \brief Play a MIDI sequence file
+ *
+ * \param[in] fileName pointer of a char array (aka string), contianing the filename
+ *
+ * Opens the sequence, as created by plugins/mk_seq.pl, and verifies its
+ * header. Reads ahead the first events, then starts Timer1 dispatching each
+ * at its microsecond from now. Call sequenceAvailable() from loop() to keep
+ * reading ahead, there is no Standard MIDI File to parse.
+ *
+ * Real-time MIDI must be started by midiBegin() prior. Messages of noteOn()
+ * and friends may be sent meanwhile.
+ *
+ * \return Any Value other than zero indicates a problem occured.
+ * - 0 indicates that the sequence was started.
+ * - 1 indicates real-time MIDI was not started or a sequence is playing.
+ * - 2 indicates the file was not found or is not a sequence.
+ * - 3 indicates that the VSdsp is in reset.
+ */
+uint8_t SFEMP3Shield::playSequence(char* fileName) {
+  seq_header_m header;
+
+  if(!digitalRead(MP3_RESET)) return 3;
+  if((playing_state != playRealTimeMIDI) || seq_active) return 1;
+
+  if(!track.open(fileName, O_READ)) return 2;
+  if((track.read(&header, sizeof(header)) != sizeof(header))
+      || memcmp(header.magic, "SSEQ", 4) || (header.version != SEQ_VERSION)) {
+    track.close();
+    return 2;
+  }
+
+  seq_P = NULL;
+  seq_remaining = (track.fileSize() - sizeof(header)) / sizeof(midi_event_m);
+  startSequence();
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Play a MIDI sequence from Flash
+ *
+ * \param[in] events array of midi_event_m in PROGMEM, in order of time.
+ * \param[in] count number of events.
+ *
+ * As playSequence(), but read ahead from Flash. Such as an array printed by
+ * plugins/mk_seq.pl -c.
+ *
+ * \return as playSequence().
+ */
+uint8_t SFEMP3Shield::playSequence_P(const midi_event_m* events, uint32_t count) {
+
+  if(!digitalRead(MP3_RESET)) return 3;
+  if((playing_state != playRealTimeMIDI) || seq_active) return 1;
+
+  seq_P = events;
+  seq_remaining = count;
+  startSequence();
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Start dispatching the sequence
+ *
+ * Primative function to read ahead the first events and start Timer1, as the
+ * sequence's source has been set up by playSequence() or playSequence_P().
+ */
+void SFEMP3Shield::startSequence() {
+  seq_head = 0;
+  seq_tail = 0;
+  seq_active = 1;
+  sequenceAvailable();
+
+  seq_start = micros();
+  Timer1.initialize(MIDI_SEQ_TICK);
+  Timer1.attachInterrupt(sequencerTick);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Stop the sequence
+ *
+ * Stops Timer1 and closes the sequence's file. Notes sounding are not
+ * released, send them noteOff() or controlChange() 123, All Notes Off.
+ * Timer1 is returned to the period of the refill means, if it uses Timer1.
+ */
+void SFEMP3Shield::stopSequence() {
+  if(!seq_active) return;
+
+  Timer1.detachInterrupt();
+  seq_active = 0;
+  if(!seq_P) track.close();
+
+#if defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_Timer1
+  Timer1.initialize(MP3_REFILL_PERIOD);
+#elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog
+  Timer1.initialize(MP3_WATCHDOG_PERIOD);
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Read ahead the sequence
+ *
+ * Call from loop() while isSequencing(). Reads the next events into the buffer,
+ * in blocks of half its size, from the SdCard or Flash. The SdCard is only read
+ * from the main loop, never by the ISR. Stops the sequence once the last event
+ * has been dispatched.
+ */
+void SFEMP3Shield::sequenceAvailable() {
+  if(!seq_active) return;
+
+  while(seq_remaining) {
+    uint8_t head = seq_head;
+    uint8_t space = (seq_tail + MIDI_SEQ_BUFFER - head - 1) % MIDI_SEQ_BUFFER;
+
+    // read in blocks of half the buffer, or whatever remains.
+    if((space < MIDI_SEQ_BUFFER / 2) && (space < seq_remaining)) break;
+    uint8_t n = MIDI_SEQ_BUFFER - head; // up to the end of the buffer.
+    if(n > space) n = space;
+    if(n > seq_remaining) n = seq_remaining;
+    if(!n) break;
+
+    if(seq_P) {
+      memcpy_P(&seq_buffer[head], seq_P, n * sizeof(midi_event_m));
+      seq_P += n;
+    } else if(track.read(&seq_buffer[head], n * sizeof(midi_event_m))
+              != (int16_t)(n * sizeof(midi_event_m))) {
+      seq_remaining = 0; // truncated or unreadable, play what was read.
+      break;
+    }
+    seq_remaining -= n;
+    seq_head = (head + n) % MIDI_SEQ_BUFFER;
+  }
+
+  if(!seq_remaining && (seq_tail == seq_head)) stopSequence();
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Is a sequence playing
+ *
+ * \return true while a sequence started by playSequence() or playSequence_P()
+ * is playing.
+ */
+bool SFEMP3Shield::isSequencing() {
+  return seq_active;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Dispatch the sequenced events that are due
+ *
+ * Called by Timer1 every MIDI_SEQ_TICK. Writes the events read ahead whose
+ * time has come, up to MIDI_SEQ_BURST of them while DREQ is high, bounding
+ * the time spent in the ISR. The latency of each past its time is added to
+ * the statistics. When the SPI bus is busy it is deferred until released, as
+ * refill().
+ *
+ * A deferred tick runs outside Timer1's ISR, so Timer1 is masked meanwhile.
+ * Each event is also taken off seq_buffer before it is written, so no other
+ * tick can dispatch it again.
+ */
+void SFEMP3Shield::sequencerTick() {
 
-  if(!digitalRead(MP3_RESET))
+  if(SdSpiBus::busy()) {
+    SdSpiBus::defer(sequencerTick);
     return;
+  }
 
-  //cancel and store current state to restore after
-  disableRefill();
-  state_m prv_state = playing_state;
-  playing_state = playMIDIbeep;
-  
-  // need to quickly purge the exiting formate of decoder.
-  flush_cancel(none);
-
-  // wait for VS1053 to be available.
-  while(!digitalRead(MP3_DREQ)); 
-
-#if !defined(USE_MP3_REFILL_MEANS) || USE_MP3_REFILL_MEANS == USE_MP3_INTx
-  cli(); // allow transfer to occur with out interruption.
+#if defined(__AVR__)
+  uint8_t oldSREG = SREG;
+  cli();
+  uint8_t oldTOIE1 = TIMSK1 & _BV(TOIE1);
+  TIMSK1 &= ~_BV(TOIE1);
+  SREG = oldSREG;
 #endif
 
-  dcs_low(); //Select Data
-  for(uint8_t y = 0 ; y < sizeof(SingleMIDInoteFile) ; y++) { // sizeof(mp3DataBuffer)
-    // Every 32 check if not ready for next buffer chunk.
-    if ( !(y % 32) ) {
-      while(!digitalRead(MP3_DREQ));
+  uint32_t now = micros() - seq_start;
+  uint8_t selected = 0;
+
+  for(uint8_t burst = MIDI_SEQ_BURST; burst && (seq_tail != seq_head); burst--) {
+    midi_event_m event = seq_buffer[seq_tail];
+    if((int32_t)(now - event.time) < 0) break;
+    if(!selected) {
+      if(!digitalRead(MP3_DREQ)) break;
+      dcs_low(); //Select Data
+      selected = 1;
     }
-    SPI.transfer( pgm_read_byte_near( &(SingleMIDInoteFile[y]))); // Send next byte
+    seq_tail = (seq_tail + 1) % MIDI_SEQ_BUFFER;
+    midiWrite(&event, now - event.time);
   }
-  dcs_high(); //Deselect Data
 
-#if !defined(USE_MP3_REFILL_MEANS) || USE_MP3_REFILL_MEANS == USE_MP3_INTx
-  sei();  // renable interrupts for other processes
-#endif
+  if(selected) dcs_high(); //Deselect Data
 
-  flush_cancel(none); // need to quickly purge the exiting format of decoder.
-  playing_state = prv_state;
-  enableRefill();
+#if defined(__AVR__)
+  oldSREG = SREG;
+  cli();
+  TIMSK1 |= oldTOIE1;
+  SREG = oldSREG;
+#endif
 }
+#endif
 
 //------------------------------------------------------------------------------
 /**
@@ -2081,10 +4418,14 @@ void SFEMP3Shield::SendSingleMIDInote() {
  */
 void SFEMP3Shield::enableRefill() {
   if(playing_state == playback) {
+    SdSpiBus::setIrqUser(MP3_SPI_BUS_ID, true);
     #if defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_Timer1
       Timer1.attachInterrupt( refill );
     #elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer
       timer.enable(timerId_mp3);
+    #elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog
+      attachInterrupt(MP3_DREQINT, refill, RISING);
+      Timer1.attachInterrupt( refillWatchdog );
     #elif !defined(USE_MP3_REFILL_MEANS) || USE_MP3_REFILL_MEANS == USE_MP3_INTx
       attachInterrupt(MP3_DREQINT, refill, RISING);
     #endif
@@ -2103,9 +4444,58 @@ void SFEMP3Shield::disableRefill() {
   Timer1.detachInterrupt();
 #elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer
   timer.disable(timerId_mp3);
+#elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog
+  Timer1.detachInterrupt();
+  detachInterrupt(MP3_DREQINT);
 #elif !defined(USE_MP3_REFILL_MEANS) || USE_MP3_REFILL_MEANS == USE_MP3_INTx
   detachInterrupt(MP3_DREQINT);
 #endif
+  SdSpiBus::setIrqUser(MP3_SPI_BUS_ID, false);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Watchdog for missed DREQ edges.
+ *
+ * Attached to Timer1 when the means is USE_MP3_INTxWatchdog. DREQ found high,
+ * with neither refill() running nor deferred by the SdCard holding the bus,
+ * means its rising edge was missed. As INTx will not fire again until DREQ
+ * falls and rises, refill() is called from here and the rescue counted.
+ */
+void SFEMP3Shield::refillWatchdog() {
+  if(refill_active || SdSpiBus::busy() || !digitalRead(MP3_DREQ))
+    return;
+  refill_rescues++;
+  refill();
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Get the number of watchdog rescues.
+ *
+ * \return the number of times, since clearRefillRescues(), the refill watchdog
+ * found DREQ high without its edge having been serviced, and refilled.
+ *
+ * \note Always 0 unless USE_MP3_REFILL_MEANS is USE_MP3_INTxWatchdog. A count
+ * rising quickly means a sketch blocks interrupts, or detaches refill, for
+ * long periods. A count that never rises may allow a longer MP3_WATCHDOG_PERIOD.
+ */
+uint16_t SFEMP3Shield::getRefillRescues() {
+  uint16_t count;
+  MP3_ATOMIC_BEGIN; // a 16 bit read is not atomic on AVR.
+  count = refill_rescues;
+  MP3_ATOMIC_END;
+  return count;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Reset the count of watchdog rescues.
+ */
+void SFEMP3Shield::clearRefillRescues() {
+  MP3_ATOMIC_BEGIN;
+  refill_rescues = 0;
+  MP3_ATOMIC_END;
 }
 
 //------------------------------------------------------------------------------
@@ -2129,13 +4519,7 @@ void SFEMP3Shield::flush_cancel(flush_m mode) {
   int8_t endFillByte = (int8_t) (Mp3ReadWRAM(para_endFillByte) & 0xFF);
 
   if((mode == post) || (mode == both)) {
-
-    dcs_low(); //Select Data
-    for(int y = 0 ; y < 2052 ; y++) {
-      while(!digitalRead(MP3_DREQ)); // wait until DREQ is or goes high
-      SPI.transfer(endFillByte); // Send SPI byte
-    }
-    dcs_high(); //Deselect Data
+    send_endfill(endFillByte, 2052);
   }
 
   for (int n = 0; n < 64 ; n++)
@@ -2143,23 +4527,13 @@ void SFEMP3Shield::flush_cancel(flush_m mode) {
 //    Mp3WriteRegister(SCI_MODE, SM_LINE1 | SM_SDINEW | SM_CANCEL); // old way of SCI_MODE WRITE.
     Mp3WriteRegister(SCI_MODE, (Mp3ReadRegister(SCI_MODE) | SM_CANCEL));
 
-    dcs_low(); //Select Data
-    for(int y = 0 ; y < 32 ; y++) {
-      while(!digitalRead(MP3_DREQ)); // wait until DREQ is or goes high
-      SPI.transfer(endFillByte); // Send SPI byte
-    }
-    dcs_high(); //Deselect Data
+    send_endfill(endFillByte, 32);
 
     int cancel = Mp3ReadRegister(SCI_MODE) & SM_CANCEL;
     if(cancel == 0) {
       // Cancel has succeeded.
       if((mode == pre) || (mode == both)) {
-        dcs_low(); //Select Data
-        for(int y = 0 ; y < 2052 ; y++) {
-          while(!digitalRead(MP3_DREQ)); // wait until DREQ is or goes high
-          SPI.transfer(endFillByte); // Send SPI byte
-        }
-        dcs_high(); //Deselect Data
+        send_endfill(endFillByte, 2052);
       }
       return;
     }
@@ -2173,6 +4547,151 @@ void SFEMP3Shield::flush_cancel(flush_m mode) {
 }
 
 
+//------------------------------------------------------------------------------
+/**
+ * \brief Send end fill bytes to the VSdsp's data stream
+ *
+ * \param[in] fill is the para_endFillByte value to be sent.
+ * \param[in] len is the number of bytes to be sent.
+ *
+ * Selects the VSdsp's data stream and sends \c len copies of \c fill, in
+ * bursts of 32 with sdi_fill(). Waiting for DREQ ahead of each burst.
+ */
+void SFEMP3Shield::send_endfill(uint8_t fill, uint16_t len) {
+  dcs_low(); //Select Data
+  while(len) {
+    uint16_t n = (len > 32) ? 32 : len;
+    while(!digitalRead(MP3_DREQ)); // wait until DREQ is or goes high
+    sdi_fill(fill, n);
+    len -= n;
+  }
+  dcs_high(); //Deselect Data
+}
+
+#if defined(__AVR__)
+/**
+ * \brief Wait for the byte in SPDR to be shifted out.
+ */
+static inline void sdiWait() {
+  while(!(SPSR & (1 << SPIF)));
+}
+#endif
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Send a burst of bytes from RAM over the SPI.
+ *
+ * \param[in] data pointer to the bytes to be sent.
+ * \param[in] len is the number of bytes to be sent.
+ *
+ * Primative function to quickly send a burst to the VSdsp's data stream. On
+ * AVR loading of the next byte overlaps the shifting out of the current one,
+ * as in SdFat's SdSpi::send(). Rather than waiting for each byte's full
+ * round trip as a SPI.transfer() per byte does. The loop is unrolled by four,
+ * so only every fourth byte pays for the loop's test and pointer update.
+ *
+ * \warning Neither selects the VSdsp nor waits for DREQ. Use between dcs_low()
+ * and dcs_high(), sending no more than 32 bytes per DREQ.
+ */
+void SFEMP3Shield::sdi_send(const uint8_t* data, uint16_t len) {
+#if defined(__AVR__)
+  if(!len) return;
+  const uint8_t* end = data + len;
+  SPDR = *data++;
+  while(end - data >= 4) { // unrolled by four, as refill() sends 32 at a time
+    uint8_t b = data[0];
+    sdiWait(); SPDR = b; b = data[1];
+    sdiWait(); SPDR = b; b = data[2];
+    sdiWait(); SPDR = b; b = data[3];
+    sdiWait(); SPDR = b;
+    data += 4;
+  }
+  while(data != end) {
+    uint8_t b = *data++;
+    sdiWait(); SPDR = b;
+  }
+  sdiWait();
+#else
+  for(uint16_t i = 0 ; i < len ; i++) {
+    SPI.transfer(data[i]);
+  }
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Send a burst of bytes from Flash over the SPI.
+ *
+ * \param[in] data pointer to the PROGMEM bytes to be sent.
+ * \param[in] len is the number of bytes to be sent.
+ *
+ * As sdi_send(), with the bytes read from program memory. Such as the
+ * SingleMIDInoteFile.
+ *
+ * \warning Neither selects the VSdsp nor waits for DREQ. Use between dcs_low()
+ * and dcs_high(), sending no more than 32 bytes per DREQ.
+ */
+void SFEMP3Shield::sdi_send_P(const uint8_t* data, uint16_t len) {
+#if defined(__AVR__)
+  if(!len) return;
+  const uint8_t* end = data + len;
+  SPDR = pgm_read_byte_near(data++);
+  while(end - data >= 4) {
+    uint8_t b = pgm_read_byte_near(data);
+    sdiWait(); SPDR = b; b = pgm_read_byte_near(data + 1);
+    sdiWait(); SPDR = b; b = pgm_read_byte_near(data + 2);
+    sdiWait(); SPDR = b; b = pgm_read_byte_near(data + 3);
+    sdiWait(); SPDR = b;
+    data += 4;
+  }
+  while(data != end) {
+    uint8_t b = pgm_read_byte_near(data++);
+    sdiWait(); SPDR = b;
+  }
+  sdiWait();
+#else
+  for(uint16_t i = 0 ; i < len ; i++) {
+    SPI.transfer(pgm_read_byte_near(&data[i]));
+  }
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Send a burst of one repeated byte over the SPI.
+ *
+ * \param[in] fill is the byte to be sent.
+ * \param[in] len is the number of times it is to be sent.
+ *
+ * As sdi_send(), with the same byte sent \c len times. Such as the
+ * para_endFillByte sent by flush_cancel().
+ *
+ * \warning Neither selects the VSdsp nor waits for DREQ. Use between dcs_low()
+ * and dcs_high(), sending no more than 32 bytes per DREQ.
+ */
+void SFEMP3Shield::sdi_fill(uint8_t fill, uint16_t len) {
+#if defined(__AVR__)
+  if(!len) return;
+  SPDR = fill;
+  len--;
+  while(len >= 4) {
+    sdiWait(); SPDR = fill;
+    sdiWait(); SPDR = fill;
+    sdiWait(); SPDR = fill;
+    sdiWait(); SPDR = fill;
+    len -= 4;
+  }
+  while(len--) {
+    sdiWait(); SPDR = fill;
+  }
+  sdiWait();
+#else
+  while(len--) {
+    SPI.transfer(fill);
+  }
+#endif
+}
+
 //------------------------------------------------------------------------------
 /**
  * \brief Initially load ADMixer patch and configure line/mic mode
@@ -2255,6 +4774,354 @@ void SFEMP3Shield::ADMixerVol(int8_t ADM_volume){
   }
 }
 
+//------------------------------------------------------------------------------
+/**
+ * \brief VS1053b IMA ADPCM recording patch
+ *
+ * Pairs of SCI register and value, as given by section 10.8.1 of the VS1053b
+ * datasheet, correcting the IMA ADPCM encoder of the VS1053b's ROM. Loaded by
+ * startRecording() once the recording mode is active.
+ * \note PROGMEM macro forces to Flash space.
+ */
+PROGMEM const uint16_t adpcm_patch[][2] = {
+  {SCI_WRAMADDR, 0x8010},
+  {SCI_WRAM, 0x3e12}, {SCI_WRAM, 0xb817}, {SCI_WRAM, 0x3e14}, {SCI_WRAM, 0xf812},
+  {SCI_WRAM, 0x3e01}, {SCI_WRAM, 0xb811}, {SCI_WRAM, 0x0007}, {SCI_WRAM, 0x9717},
+  {SCI_WRAM, 0x0020}, {SCI_WRAM, 0xffd2}, {SCI_WRAM, 0x0030}, {SCI_WRAM, 0x11d1},
+  {SCI_WRAM, 0x3111}, {SCI_WRAM, 0x8024}, {SCI_WRAM, 0x3704}, {SCI_WRAM, 0xc024},
+  {SCI_WRAM, 0x3b81}, {SCI_WRAM, 0x8024}, {SCI_WRAM, 0x3101}, {SCI_WRAM, 0x8024},
+  {SCI_WRAM, 0x3b81}, {SCI_WRAM, 0x8024}, {SCI_WRAM, 0x3f04}, {SCI_WRAM, 0xc024},
+  {SCI_WRAM, 0x2808}, {SCI_WRAM, 0x4800}, {SCI_WRAM, 0x36f1}, {SCI_WRAM, 0x9811},
+  {SCI_WRAMADDR, 0x8028},
+  {SCI_WRAM, 0x2a00}, {SCI_WRAM, 0x040e}};
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Start recording to a WAV file
+ *
+ * \param[in] fileName pointer of a char array (aka string), contianing the filename
+ * \param[in] size in bytes to preallocate, the most the recording may hold.
+ * \param[in] sampleRate (optional) in Hz, 8000 through 48000.
+ * \param[in] pcm (optional) true for 16 bit linear PCM, otherwise IMA ADPCM.
+ * \param[in] gain (optional) where 1024 is 1x, and 0 automatic gain control.
+ *
+ * Creates the file contiguous at its full size, replacing any file by that
+ * name, and starts a multiple block write of it with Sd2Card::writeStart().
+ * Then puts the VSdsp in its recording mode, of the left channel of the line
+ * input or microphone as per VS_LINE1_MODE, loading adpcm_patch for IMA
+ * ADPCM.
+ *
+ * Call recordAvailable() from loop(), as to drain the VSdsp's recording
+ * buffer to the SdCard, until stopRecording(). Each block is written with
+ * Sd2Card::writeData(), without a FAT or directory update. The SdSpiBus lock
+ * is only held for each block, so other file operations may be done while
+ * recording. Each ends the multiple block write, through SdSpiBus's preempt
+ * handlers, and the next block restarts it. The player's block buffer and
+ * track are used, so nothing may be played until stopRecording().
+ *
+ * \return Any Value other than zero indicates a problem occured.
+ * - 0 indicates that recording was started.
+ * - 1 indicates recording can not be started while currently streaming music.
+ * - 2 indicates that a contiguous file of the size could not be created.
+ * - 3 indicates that the VSdsp is in reset.
+ * - 4 indicates that the SdCard failed to start the multiple block write.
+ *
+ * \note IMA ADPCM is 4 bits per sample, a quarter the size of linear PCM. At
+ * 8000Hz that is about 4Kbytes per second, as 32Kbytes for linear PCM at 16000Hz.
+ */
+uint8_t SFEMP3Shield::startRecording(char* fileName, uint32_t size, uint16_t sampleRate, bool pcm, uint16_t gain) {
+  uint32_t firstBlock;
+  uint32_t lastBlock;
+  bool started;
+
+  if(!digitalRead(MP3_RESET)) return 3;
+  if(isPlaying() != FALSE) return 1;
+  if(size < 512) return 2;
+
+  if(sd.exists(fileName)) sd.remove(fileName);
+  if(!track.createContiguous(SdBaseFile::cwd(), fileName, size)) return 2;
+  if(!track.contiguousRange(&firstBlock, &lastBlock)) {
+    track.remove();
+    return 2;
+  }
+
+  rec_pcm = pcm;
+  rec_rate = sampleRate;
+  rec_block = firstBlock;
+  rec_lastBlock = lastBlock;
+  memset(&rec_stats, 0, sizeof(rec_stats));
+
+  SdSpiBus::lock();
+  started = sd.card()->writeStart(firstBlock, lastBlock - firstBlock + 1);
+  rec_writing = started;
+  // file operations end the write before using the card.
+  if(started && !SdSpiBus::addPreempt(endRecordWrite)) endRecordWrite();
+  SdSpiBus::unlock();
+  if(!started) {
+    track.remove();
+    return 4;
+  }
+  discardRefillBuffer();
+  rec_fill = recordHeader(mp3BlockBuffer, 0);
+  rec_max = size - rec_fill;
+
+  Mp3WriteRegister(SCI_CLOCKF, MP3_RECORD_CLOCKF);
+  Mp3WriteRegister(SCI_AICTRL0, sampleRate);
+  Mp3WriteRegister(SCI_AICTRL1, gain);
+  Mp3WriteRegister(SCI_AICTRL2, 0); // automatic gain up to its maximum of 64x.
+  Mp3WriteRegister(SCI_AICTRL3, pcm ? 6 : 2); // left channel, +4 for linear PCM.
+
+  // Activate recording with the Input Mode of either Line1 or Microphone.
+#if defined(VS_LINE1_MODE)
+  Mp3WriteRegister(SCI_MODE, SM_SDINEW | SM_ADPCM | SM_RESET | SM_LINE1);
+#else
+  Mp3WriteRegister(SCI_MODE, SM_SDINEW | SM_ADPCM | SM_RESET);
+#endif
+
+  if(!pcm) {
+    for(uint8_t i = 0; i < sizeof(adpcm_patch) / sizeof(adpcm_patch[0]); i++) {
+      Mp3WriteRegister(pgm_read_word(&adpcm_patch[i][0]), pgm_read_word(&adpcm_patch[i][1]));
+    }
+  }
+
+  playing_state = recording;
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Drain the VSdsp's recording buffer to the SdCard
+ *
+ * Call from loop() while recording. Reads SCI_HDAT1 for the number of words
+ * waiting, noting its peak, and counting when it is near full or full. Then
+ * drains them in bursts of
+ * MP3_RECORD_BURST words. Stops the recording once the file is full, or
+ * should the SdCard fail.
+ *
+ * \note The VSdsp's buffer holds 1024 words, about half a second of IMA ADPCM
+ * at 8000Hz. It must be called more often than that, including the time
+ * taken by the SdCard to write.
+ */
+void SFEMP3Shield::recordAvailable() {
+  if(playing_state != recording) return;
+
+  uint16_t words = Mp3ReadRegister(SCI_HDAT1);
+  if(words > rec_stats.peakFill) rec_stats.peakFill = words;
+  if(words >= MP3_RECORD_NEAR_FULL) rec_stats.nearFull++;
+  if(words >= MP3_RECORD_BUFFER) rec_stats.overruns++;
+
+  while(words >= MP3_RECORD_BURST) {
+    if((rec_stats.bytes + 2 * MP3_RECORD_BURST > rec_max)
+        || recordDrain(MP3_RECORD_BURST)) {
+      stopRecording();
+      return;
+    }
+    words -= MP3_RECORD_BURST;
+  }
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Stop recording
+ *
+ * Writes the last, partial, block and ends the multiple block write. Then
+ * resets the VSdsp with vs_init(), as the only way out of recording mode.
+ * Finally truncates the file to what was recorded and rewrites its WAV header
+ * with the final sizes.
+ */
+void SFEMP3Shield::stopRecording() {
+  uint8_t header[60];
+
+  if(playing_state != recording) return;
+
+  if(rec_fill) {
+    memset(&mp3BlockBuffer[rec_fill], 0, sizeof(mp3BlockBuffer) - rec_fill);
+    recordWrite();
+  }
+  SdSpiBus::lock();
+  endRecordWrite();
+  SdSpiBus::removePreempt(endRecordWrite);
+  SdSpiBus::unlock();
+
+  vs_init();
+  playing_state = ready;
+
+  uint8_t n = recordHeader(header, rec_stats.bytes);
+  track.truncate(n + rec_stats.bytes);
+  track.seekSet(0);
+  track.write(header, n);
+  track.close();
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Get the statistics of the recording
+ *
+ * \param[out] stats copy of the statistics since startRecording().
+ */
+void SFEMP3Shield::getRecordStats(record_stats_m* stats) {
+  *stats = rec_stats;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Read words from the VSdsp's recording buffer into the block
+ *
+ * \param[in] words number of words to read, as counted by SCI_HDAT1.
+ *
+ * Primative function to read SCI_HDAT0 repeatedly, selecting the control
+ * channel only once. Each word is stored in the order of the WAV format,
+ * most significant byte first for IMA ADPCM and last for linear PCM. Each
+ * block filled is written by recordWrite().
+ *
+ * \return 0 on success, 1 if the SdCard failed to write.
+ */
+uint8_t SFEMP3Shield::recordDrain(uint16_t words) {
+
+  cs_low(spi_Read_Rate); //Select control, at the slower read rate
+  while(words--) {
+    SPI.transfer(0x03);  //Read instruction
+    SPI.transfer(SCI_HDAT0);
+    uint8_t hi = SPI.transfer(0xFF);
+    uint8_t lo = SPI.transfer(0xFF);
+    digitalWrite(MP3_XCS, HIGH); // each read is ended, as the VSdsp requires.
+
+    mp3BlockBuffer[rec_fill++] = rec_pcm ? lo : hi;
+    mp3BlockBuffer[rec_fill++] = rec_pcm ? hi : lo;
+    rec_stats.bytes += 2;
+
+    if(rec_fill < sizeof(mp3BlockBuffer)) {
+      digitalWrite(MP3_XCS, LOW);
+      continue;
+    }
+
+    cs_high(); //Deselect Control, giving the bus to the SdCard.
+    if(recordWrite()) return 1;
+    rec_fill = 0;
+    cs_low(spi_Read_Rate);
+  }
+  cs_high(); //Deselect Control
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Write the block being recorded to the SdCard
+ *
+ * Writes mp3BlockBuffer as the next block of the recording, timing the
+ * longest. The SdSpiBus lock is held for this block only. The multiple block
+ * write is restarted at this block, with the rest of the file pre-erased,
+ * when a file operation ended it meanwhile.
+ *
+ * \return 0 on success, 1 if the SdCard failed to write.
+ */
+uint8_t SFEMP3Shield::recordWrite() {
+  uint8_t result = 1;
+  uint32_t t0 = micros();
+
+  // keep our own write open through lock(), and end any other.
+  SdSpiBus::removePreempt(endRecordWrite);
+  SdSpiBus::lock();
+  if(!rec_writing) {
+    if(!sd.card()->writeStart(rec_block, rec_lastBlock - rec_block + 1)) goto done;
+    rec_writing = 1;
+  }
+  if(!sd.card()->writeData(mp3BlockBuffer)) {
+    endRecordWrite();
+    goto done;
+  }
+  rec_block++;
+  result = 0;
+  // file operations end the write before using the card.
+  if(!SdSpiBus::addPreempt(endRecordWrite)) endRecordWrite();
+
+ done:
+  SdSpiBus::unlock();
+  uint32_t us = micros() - t0;
+  if(us > rec_stats.maxWriteMicros) rec_stats.maxWriteMicros = us;
+  return result;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief End the recording's multiple block write
+ *
+ * Stops the SdCard's multiple block write, if one is open, so the card may be
+ * used otherwise. Added to SdSpiBus's preempt handlers while recording, so it
+ * is called by the outermost lock() of any file operation.
+ */
+void SFEMP3Shield::endRecordWrite() {
+  if(rec_writing) {
+    rec_writing = 0;
+    sd.card()->writeStop();
+  }
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Store a little-endian value
+ *
+ * \param[out] p where to store the value.
+ * \param[in] value to be stored.
+ * \param[in] n number of bytes, 2 or 4.
+ *
+ * \return p advanced past the value.
+ */
+static uint8_t* putLE(uint8_t* p, uint32_t value, uint8_t n) {
+  while(n--) {
+    *p++ = value;
+    value >>= 8;
+  }
+  return p;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * \brief Build the WAV header of the recording
+ *
+ * \param[out] buf at least 60 bytes for the header.
+ * \param[in] dataBytes of audio recorded.
+ *
+ * Primative function to build the RIFF header of a mono IMA ADPCM, with its
+ * fact chunk, or 16 bit linear PCM WAV file at rec_rate.
+ *
+ * \return the length of the header, 60 for IMA ADPCM or 44 for linear PCM.
+ */
+uint8_t SFEMP3Shield::recordHeader(uint8_t* buf, uint32_t dataBytes) {
+  uint8_t* p = buf;
+  uint8_t n = rec_pcm ? 44 : 60;
+
+  memcpy(p, "RIFF", 4);
+  p = putLE(p + 4, n - 8 + dataBytes, 4);
+  memcpy(p, "WAVEfmt ", 8);
+  p += 8;
+  if(rec_pcm) {
+    p = putLE(p, 16, 4);
+    p = putLE(p, 1, 2);                  // linear PCM
+    p = putLE(p, 1, 2);                  // mono
+    p = putLE(p, rec_rate, 4);
+    p = putLE(p, 2UL * rec_rate, 4);     // bytes per second
+    p = putLE(p, 2, 2);                  // block align
+    p = putLE(p, 16, 2);                 // bits per sample
+  } else {
+    p = putLE(p, 20, 4);
+    p = putLE(p, 0x11, 2);               // IMA ADPCM
+    p = putLE(p, 1, 2);                  // mono
+    p = putLE(p, rec_rate, 4);
+    p = putLE(p, (256UL * rec_rate) / 505, 4); // bytes per second
+    p = putLE(p, 256, 2);                // block align
+    p = putLE(p, 4, 2);                  // bits per sample
+    p = putLE(p, 2, 2);                  // extra format bytes
+    p = putLE(p, 505, 2);                // samples per block
+    memcpy(p, "fact", 4);
+    p = putLE(p + 4, 4, 4);
+    p = putLE(p, (dataBytes / 256) * 505, 4);
+  }
+  memcpy(p, "data", 4);
+  putLE(p + 4, dataBytes, 4);
+  return n;
+}
+
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 // Global Function
@@ -2287,20 +5154,179 @@ char* strip_nonalpha_inplace(char *s) {
  *            that VS10xx can decode.
  *
  * \return boolean true indicating that it is music
+ *
+ * \note Only the name is inspected, the filename is left unchanged. The file
+ * may still be mislabeled, sniffFormat() inspects its content.
  */
 bool isFnMusic(char* filename) {
-  int8_t len = strlen(filename);
-  bool result;
-  if (  strstr(strlwr(filename + (len - 4)), ".mp3")
-     || strstr(strlwr(filename + (len - 4)), ".aac")
-     || strstr(strlwr(filename + (len - 4)), ".wma")
-     || strstr(strlwr(filename + (len - 4)), ".wav")
-     || strstr(strlwr(filename + (len - 4)), ".fla")
-     || strstr(strlwr(filename + (len - 4)), ".mid")
-    ) {
-    result = true;
+  char* extension = strrchr(filename, '.');
+  if(!extension) return false;
+  extension++;
+  return (strcasecmp_P(extension, PSTR("mp3")) == 0)
+      || (strcasecmp_P(extension, PSTR("aac")) == 0)
+      || (strcasecmp_P(extension, PSTR("wma")) == 0)
+      || (strcasecmp_P(extension, PSTR("wav")) == 0)
+      || (strcasecmp_P(extension, PSTR("fla")) == 0)
+      || (strcasecmp_P(extension, PSTR("mid")) == 0)
+      || (strcasecmp_P(extension, PSTR("ogg")) == 0)
+      || (strcasecmp_P(extension, PSTR("mp4")) == 0)
+      || (strcasecmp_P(extension, PSTR("m4a")) == 0);
+}
+
+/**
+ * \brief GUID of an ASF header object, the start of a WMA file.
+ */
+PROGMEM const uint8_t asf_guid[8] = {0x30, 0x26, 0xB2, 0x75, 0x8E, 0x66, 0xCF, 0x11};
+
+/**
+ * \brief Bytes past an ID3v2 tag, or padding, searched for an MPEG frame.
+ */
+#define SNIFF_WINDOW 512
+
+/**
+ * \brief Check for an MPEG audio or ADTS frame header
+ *
+ * \param[in] h pointer to 6 bytes, the first being 0xFF.
+ * \param[out] bitrate Bytes per millisecond of an MP3 frame, from bitrate_table, 0 for ADTS.
+ * \param[out] length Bytes of the frame, to the next frame's header.
+ *
+ * A free format MP3, of bitrate index 0, is not recognized, as its frame
+ * length is unknown. The length of an ADTS frame is the 13 bits of its
+ * header from the fourth byte.
+ *
+ * \return fmt_mp3, fmt_aac for ADTS, or fmt_unknown if not a valid header.
+ */
+static uint8_t sniffFrame(const uint8_t* h, uint8_t* bitrate, uint16_t* length) {
+  uint8_t version = (h[1] >> 3) & 3; // 3 V1, 2 V2, 0 V2.5, 1 reserved
+  uint8_t layer = (h[1] >> 1) & 3;   // 3 L1, 2 L2, 1 L3, 0 ADTS
+  uint8_t index = h[2] >> 4;
+  uint8_t sampling = (h[2] >> 2) & 3;
+
+  if((h[1] & 0xE0) != 0xE0) return fmt_unknown;
+  if(((h[1] & 0xF6) == 0xF0) && (((h[2] >> 2) & 0x0F) < 13)) {
+    *bitrate = 0;
+    *length = ((uint16_t)(h[3] & 3) << 11) | ((uint16_t)h[4] << 3) | (h[5] >> 5);
+    return (*length < 7) ? fmt_unknown : fmt_aac; // shorter than its header.
+  }
+  if((version == 1) || (layer == 0) || (index == 0) || (index == 15) || (sampling == 3))
+    return fmt_unknown;
+
+  // columns of bitrate_table, V1 L1, L2, L3, then V2 and V2.5 L1, L2 and L3.
+  uint8_t column = (version == 3) ? 3 - layer : ((layer == 3) ? 3 : 4);
+  uint16_t kbps = pgm_read_word_near(&(bitrate_table[index][column]));
+  *bitrate = kbps / 8;
+
+  // sample rate of V1, halved for V2 and quartered for V2.5.
+  uint16_t rate = (sampling == 0) ? 44100 : ((sampling == 1) ? 48000 : 32000);
+  rate >>= (version == 3) ? 0 : ((version == 2) ? 1 : 2);
+  uint8_t padding = (h[2] >> 1) & 1;
+  if(layer == 3) {
+    *length = (12000UL * kbps / rate + padding) * 4;
   } else {
-    result = false;
+    *length = (((layer == 1) && (version != 3)) ? 72000UL : 144000UL) * kbps / rate + padding;
   }
-  return result;
+  return fmt_mp3;
+}
+
+/**
+ * \brief Find the audio format of a file from its content
+ *
+ * \param[in] file pointer to the open file.
+ * \param[out] format (optional) pointer to the audio_format_m to be filled in.
+ *
+ * Inspects the first bytes of the file, through SdVolume's cache, for the
+ * magic numbers of the formats the VSdsp decodes. RIFF WAVE or RMID, OggS,
+ * fLaC, MThd, ADIF, the ASF header of WMA and an MP4 ftyp box. Past an ID3v2
+ * tag, and up to SNIFF_WINDOW bytes of padding, also fLaC or an MPEG audio or
+ * ADTS frame header. Either is only taken when the header of the next frame
+ * follows it, of the same version, layer, or ADTS, and sample rate. No
+ * more than a few blocks are read, whatever the file. A directory, or
+ * anything else not a file, is fmt_unknown.
+ *
+ * The duration of a WAV is that of its data chunk at its byte rate, as found
+ * by riffWalk(), jumping from chunk to chunk.
+ *
+ * The file is left at the start of the audio.
+ *
+ * \return the format_m found, fmt_unknown (0) if none.
+ */
+uint8_t sniffFormat(SdBaseFile* file, audio_format_m* format) {
+  uint8_t h[12];
+  uint8_t next[6];
+  uint8_t type = fmt_unknown;
+  uint8_t bitrate = 0;
+  uint8_t nextBitrate;
+  uint16_t length;
+  uint16_t nextLength;
+  uint32_t offset = 0;
+  uint32_t duration = 0;
+  riff_chunks_m riff;
+
+  if(file->isFile() && file->seekSet(0) && (file->read(h, sizeof(h)) == sizeof(h))) {
+    if(!memcmp_P(h, PSTR("ID3"), 3)) {
+      // skip the tag, its size is syncsafe, 7 bits per byte.
+      offset = 10 + (((uint32_t)(h[6] & 0x7F) << 21) | ((uint32_t)(h[7] & 0x7F) << 14)
+                     | ((h[8] & 0x7F) << 7) | (h[9] & 0x7F));
+      if(h[5] & 0x10) offset += 10; // footer
+    } else if(!memcmp_P(h, PSTR("RIFF"), 4)) {
+      if(!memcmp_P(&h[8], PSTR("WAVE"), 4)) type = fmt_wav;
+      else if(!memcmp_P(&h[8], PSTR("RMID"), 4)) type = fmt_midi;
+    } else if(!memcmp_P(h, PSTR("OggS"), 4)) {
+      type = fmt_ogg;
+    } else if(!memcmp_P(h, PSTR("MThd"), 4)) {
+      type = fmt_midi;
+    } else if(!memcmp_P(h, PSTR("ADIF"), 4)) {
+      type = fmt_aac;
+    } else if(!memcmp_P(h, asf_guid, sizeof(asf_guid))) {
+      type = fmt_wma;
+    } else if(!memcmp_P(&h[4], PSTR("ftyp"), 4)) {
+      type = fmt_mp4;
+    }
+
+    // else look for FLAC or the first frame, from past any tag.
+    for(uint16_t scanned = 0; (type == fmt_unknown) && (scanned < SNIFF_WINDOW);
+        scanned += sizeof(h) - 5) {
+      if(!file->seekSet(offset + scanned)) break;
+      int16_t n = file->read(h, sizeof(h));
+      if((scanned == 0) && (n >= 4) && !memcmp_P(h, PSTR("fLaC"), 4)) {
+        type = fmt_flac;
+        break;
+      }
+      for(int16_t i = 0; i + 5 < n; i++) {
+        if((h[i] != 0xFF) || ((type = sniffFrame(&h[i], &bitrate, &length)) == fmt_unknown))
+          continue;
+        // a lone sync word is likely chance, the next frame is where due.
+        // The sample rate bits of MP3, the sampling index of ADTS.
+        uint8_t rate = (type == fmt_mp3) ? 0x0C : 0x3C;
+        if(!file->seekSet(offset + scanned + i + length)
+            || (file->read(next, sizeof(next)) != sizeof(next))
+            || (next[0] != 0xFF) || ((next[1] & 0xFE) != (h[i + 1] & 0xFE))
+            || ((next[2] & rate) != (h[i + 2] & rate))
+            || (sniffFrame(next, &nextBitrate, &nextLength) != type)) {
+          type = fmt_unknown;
+          continue;
+        }
+        offset += scanned + i;
+        break;
+      }
+      if(n < (int16_t)sizeof(h)) break;
+    }
+  }
+
+  if(type == fmt_unknown) {
+    offset = 0;
+    bitrate = 0; // of any frame that was not confirmed.
+  }
+  if((type == fmt_wav) && riffWalk(file, &riff)) {
+    duration = muldiv(riff.dataSize, 1000, riff.byteRate);
+  }
+  file->seekSet(offset);
+  if(format) {
+    format->firstCluster = file->firstCluster();
+    format->offset = offset;
+    format->duration = duration;
+    format->format = type;
+    format->bitrate = bitrate;
+  }
+  return type;
 }
\ No newline at end of file
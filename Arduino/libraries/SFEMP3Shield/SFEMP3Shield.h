@@ -23,6 +23,15 @@
 //Add the SdFat Libraries
 #include <SdFat.h>
 #include <SdFatUtil.h>
+#include <SdSpiBus.h>
+
+#if MP3_REFILL_RAW && !USE_SPI_BUS_ARBITRATION
+#error MP3_REFILL_RAW requires USE_SPI_BUS_ARBITRATION of SdFatConfig.h
+#endif
+
+#if USE_VOLUME_RAMP && !USE_SPI_BUS_ARBITRATION
+#error USE_VOLUME_RAMP requires USE_SPI_BUS_ARBITRATION of SdFatConfig.h
+#endif
 
 
 /** \brief State of the SFEMP3Shield device
@@ -41,6 +50,8 @@ enum state_m {
   paused_playback,
   testing_memory,
   testing_sinewave,
+  playRealTimeMIDI,
+  recording,
   }; //enum state_m
 
 /** \brief How to flush the VSdsp's buffer
@@ -81,6 +92,263 @@ enum flush_m {
   none
   }; //enum flush_m
 
+/** \brief Preloaded location and head of a file, for SFEMP3Shield::playClip()
+ *
+ * Filled in by SFEMP3Shield::preloadClip(), typically in setup(). So that
+ * SFEMP3Shield::playClip() needs neither search the directory by name nor
+ * scan for the first MP3 header, and can send the head to the VSdsp before
+ * the SdCard has been read.
+ *
+ * \warning The locations are only valid for the SdCard and the directory
+ * they were preloaded from.
+ */
+struct clip_m {
+
+/** \brief Index of the file's entry in the current working directory.*/
+  uint16_t dirIndex;
+
+/** \brief First cluster of the file, to verify the entry at dirIndex.*/
+  uint32_t firstCluster;
+
+/** \brief First block of the file if contiguous, otherwise 0. Saves playClip() walking the FAT to check.*/
+  uint32_t firstBlock;
+
+/** \brief Offset of the first audio frame, as start_of_music.*/
+  uint32_t start;
+
+/** \brief Bytes per millisecond of an MP3, otherwise 0.*/
+  uint8_t bitrate;
+
+/** \brief Audio format of the file, a format_m, as sniffed by preloadClip().*/
+  uint8_t format;
+
+/** \brief The first headLength bytes of audio from start, in RAM, or NULL.*/
+  uint8_t* head;
+
+/** \brief Number of bytes held at head.*/
+  uint16_t headLength;
+  }; //struct clip_m
+
+/** \brief Audio format of a clip in a sound bank, or of a file
+ *
+ * Value of bank_entry_m::format, as assigned by plugins/mk_bank.pl from
+ * each file's extension. And of audio_format_m::format, as found by
+ * sniffFormat() from the file's content.
+ */
+enum format_m {
+  fmt_unknown,
+  fmt_mp3,
+  fmt_wav,
+  fmt_ogg,
+  fmt_flac,
+  fmt_midi,
+  fmt_aac,
+  fmt_wma,
+  fmt_mp4
+  }; //enum format_m
+
+/** \brief Format of an audio file, as found from its content
+ *
+ * Filled in by sniffFormat(). May be kept by the sketch for each file and
+ * passed to SFEMP3Shield::playMP3(), which then skips the sniffing for as
+ * long as the file's first cluster matches.
+ */
+struct audio_format_m {
+
+/** \brief First cluster of the file, to verify the format is of the same file.*/
+  uint32_t firstCluster;
+
+/** \brief Offset of the audio data, past any ID3v2 tag or padding, as start_of_music. 0 for a WAV, its RIFF header.*/
+  uint32_t offset;
+
+/** \brief Milliseconds of a WAV, from the size of its data chunk at its byte rate, otherwise 0.*/
+  uint32_t duration;
+
+/** \brief Format of the file, of format_m.*/
+  uint8_t format;
+
+/** \brief Bytes per millisecond of an MP3's first frame, otherwise 0.*/
+  uint8_t bitrate;
+  }; //struct audio_format_m
+
+/** \brief Header of a sound bank file
+ *
+ * A sound bank packs many clips into one contiguous file, as created by
+ * plugins/mk_bank.pl. The 16 byte header is followed by \c count entries of
+ * bank_entry_m, sorted by id, and then the clips themselves. All values are
+ * little-endian.
+ */
+struct bank_header_m {
+
+/** \brief "SBNK", identifying a sound bank.*/
+  char magic[4];
+
+/** \brief Version of the format, BANK_VERSION.*/
+  uint16_t version;
+
+/** \brief Number of bank_entry_m following the header.*/
+  uint16_t count;
+
+/** \brief Reserved, zero.*/
+  uint8_t reserved[8];
+  }; //struct bank_header_m
+
+/** \brief Entry of a clip in a sound bank's table
+ *
+ * 16 bytes, so that 32 entries fit exactly in each block.
+ */
+struct bank_entry_m {
+
+/** \brief Number by which the clip is played, see SFEMP3Shield::playBankClip().*/
+  uint16_t id;
+
+/** \brief Audio format of the clip, a format_m.*/
+  uint8_t format;
+
+/** \brief Bytes per millisecond of an MP3, otherwise 0.*/
+  uint8_t bitrate;
+
+/** \brief Offset of the clip's first byte of audio from the start of the bank.*/
+  uint32_t offset;
+
+/** \brief Length of the clip in bytes.*/
+  uint32_t length;
+
+/** \brief Reserved, zero.*/
+  uint32_t reserved;
+  }; //struct bank_entry_m
+
+/** \brief Version of the sound bank format understood by SFEMP3Shield::openBank().*/
+#define BANK_VERSION 1
+
+/** \brief A real-time MIDI message waiting to be sent
+ *
+ * Entry of the queue between SFEMP3Shield::noteOn() and friends and
+ * SFEMP3Shield::midiFlush().
+ */
+struct midi_event_m {
+
+/** \brief Status byte followed by up to two data bytes.*/
+  uint8_t msg[3];
+
+/** \brief Number of bytes of msg used.*/
+  uint8_t length;
+
+/** \brief micros() when the message was queued, or when sequenced its
+ * microsecond from the start of the sequence.*/
+  uint32_t time;
+  }; //struct midi_event_m
+
+/** \brief Header of a MIDI sequence file
+ *
+ * A sequence, as created by plugins/mk_seq.pl from a Standard MIDI File, is
+ * this 8 byte header followed by midi_event_m in order of time, to the end of
+ * the file. All values are little-endian.
+ */
+struct seq_header_m {
+
+/** \brief "SSEQ", identifying a sequence.*/
+  char magic[4];
+
+/** \brief Version of the format, SEQ_VERSION.*/
+  uint16_t version;
+
+/** \brief Reserved, zero.*/
+  uint16_t reserved;
+  }; //struct seq_header_m
+
+/** \brief Version of the sequence format understood by SFEMP3Shield::playSequence().*/
+#define SEQ_VERSION 1
+
+/** \brief A cue of a cue track
+ *
+ * An action for the sketch, such as to light a LED or switch a relay, due
+ * at a millisecond into the track. The meaning of action, channel and value
+ * is up to the sketch.
+ */
+struct cue_m {
+
+/** \brief Milliseconds into the track the cue is due, as SFEMP3Shield::currentPosition().*/
+  uint32_t time;
+
+/** \brief Action to be taken.*/
+  uint8_t action;
+
+/** \brief Channel, such as the LED or relay, acted upon.*/
+  uint8_t channel;
+
+/** \brief Value of the action, such as a brightness.*/
+  uint16_t value;
+  }; //struct cue_m
+
+/** \brief Header of a cue file
+ *
+ * A cue file, as created by plugins/mk_cue.pl, is this 8 byte header
+ * followed by cue_m in order of time, to the end of the file. All values are
+ * little-endian.
+ */
+struct cue_header_m {
+
+/** \brief "SCUE", identifying a cue file.*/
+  char magic[4];
+
+/** \brief Version of the format, CUE_VERSION.*/
+  uint16_t version;
+
+/** \brief Reserved, zero.*/
+  uint16_t reserved;
+  }; //struct cue_header_m
+
+/** \brief Version of the cue file format understood by SFEMP3Shield::playMP3().*/
+#define CUE_VERSION 1
+
+/** \brief Statistics of a recording
+ *
+ * As returned by SFEMP3Shield::getRecordStats(). Fill is in 16 bit words of
+ * the VSdsp's 1024 word recording buffer, as read from SCI_HDAT1.
+ */
+struct record_stats_m {
+
+/** \brief Bytes of audio written, not including the WAV header.*/
+  uint32_t bytes;
+
+/** \brief Most words found waiting in the VSdsp's recording buffer.*/
+  uint16_t peakFill;
+
+/** \brief Number of times the fill was at or over MP3_RECORD_NEAR_FULL, in danger of overflowing.*/
+  uint16_t nearFull;
+
+/** \brief Number of times the buffer was found full, at MP3_RECORD_BUFFER words, where samples were lost.*/
+  uint16_t overruns;
+
+/** \brief Longest time in microseconds to write a block to the SdCard.*/
+  uint32_t maxWriteMicros;
+  }; //struct record_stats_m
+
+/** \brief Statistics of the real-time MIDI messages sent
+ *
+ * As returned by SFEMP3Shield::getMidiStats(). Latency is the time from a
+ * message being queued until it was sent to the VSdsp. Its jitter is
+ * maxLatency less minLatency, and its average totalLatency divided by sent.
+ */
+struct midi_stats_m {
+
+/** \brief Number of messages sent.*/
+  uint16_t sent;
+
+/** \brief Number of messages that waited for the queue, as it was full.*/
+  uint16_t stalls;
+
+/** \brief Shortest latency in microseconds.*/
+  uint32_t minLatency;
+
+/** \brief Longest latency in microseconds.*/
+  uint32_t maxLatency;
+
+/** \brief Sum of all latencies in microseconds.*/
+  uint32_t totalLatency;
+  }; //struct midi_stats_m
+
 //------------------------------------------------------------------------------
 /** \name External_Variable_Group
  *  External Variables accessed by other files.
@@ -671,6 +939,11 @@ class SFEMP3Shield {
     void setVolume(uint8_t, uint8_t);
     void setVolume(uint16_t);
     void setVolume(uint8_t);
+    void fadeIn(uint16_t);
+    void fadeOut(uint16_t);
+    void fadeTo(uint8_t, uint8_t, uint16_t);
+    static bool isFading();
+    static void volumeTick();
     uint16_t getTrebleFrequency();
     int8_t  getTrebleAmplitude();
     uint16_t getBassFrequency();
@@ -690,7 +963,11 @@ class SFEMP3Shield {
     void setDifferentialOutput(uint16_t);
     uint8_t getDifferentialOutput();
     uint8_t playTrack(uint8_t);
-    uint8_t playMP3(char*, uint32_t timecode = 0);
+    uint8_t playMP3(char*, uint32_t timecode = 0, audio_format_m* format = NULL);
+    uint8_t preloadClip(char*, clip_m*, uint8_t* head = NULL, uint16_t headSize = 0);
+    uint8_t playClip(clip_m*);
+    uint8_t openBank(char*);
+    uint8_t playBankClip(uint16_t);
     void trackTitle(char*);
     void trackArtist(char*);
     void trackAlbum(char*);
@@ -698,7 +975,12 @@ class SFEMP3Shield {
     uint8_t isPlaying();
     uint8_t skip(int32_t);
     uint8_t skipTo(uint32_t);
+    static uint16_t getSeekBlocks();
     uint32_t currentPosition();
+#if USE_CUE_TRACK
+    bool nextCue(cue_m*);
+    static bool hasCues();
+#endif
     void setBitRate(uint16_t);
     void pauseDataStream();
     void resumeDataStream();
@@ -716,13 +998,42 @@ class SFEMP3Shield {
     int8_t setVUmeter(int8_t);
     int16_t getVUlevel();
     void SendSingleMIDInote();
+    uint8_t midiBegin();
+    uint8_t midiEnd();
+    uint8_t noteOn(uint8_t, uint8_t, uint8_t);
+    uint8_t noteOff(uint8_t, uint8_t, uint8_t velocity = 0x40);
+    uint8_t controlChange(uint8_t, uint8_t, uint8_t);
+    uint8_t programChange(uint8_t, uint8_t);
+    static void midiFlush();
+    static void getMidiStats(midi_stats_m*);
+    static void clearMidiStats();
+    uint8_t startRecording(char*, uint32_t, uint16_t sampleRate = 8000, bool pcm = false, uint16_t gain = 0);
+    void recordAvailable();
+    void stopRecording();
+    static void getRecordStats(record_stats_m*);
+#if USE_MIDI_SEQUENCER
+    uint8_t playSequence(char*);
+    uint8_t playSequence_P(const midi_event_m*, uint32_t);
+    static void stopSequence();
+    static void sequenceAvailable();
+    static bool isSequencing();
+#endif
+    static uint16_t getRefillRescues();
+    static void clearRefillRescues();
+
+  protected:
+    static void sdi_send(const uint8_t*, uint16_t);
+    static void sdi_send_P(const uint8_t*, uint16_t);
+    static void sdi_fill(uint8_t, uint16_t);
 
   private:
     static SdFile track;
     static void refill();
     static void flush_cancel(flush_m);
-    static void spiInit();
+    static void send_endfill(uint8_t, uint16_t);
+    static void spiInit(uint16_t);
     static void cs_low();
+    static void cs_low(uint16_t);
     static void cs_high();
     static void dcs_low();
     static void dcs_high();
@@ -734,7 +1045,56 @@ class SFEMP3Shield {
     void getTrackInfo(uint8_t, char*);
     static void enableRefill();
     static void disableRefill();
-    void getBitRateFromMP3File(char*);
+    static void refillWatchdog();
+    static void discardRefillBuffer();
+    bool findBankEntry(uint16_t, bank_entry_m*);
+    uint8_t midiQueue(uint8_t, uint8_t, uint8_t, uint8_t);
+    static void midiWrite(const midi_event_m*, uint32_t);
+    static uint8_t recordDrain(uint16_t);
+    static uint8_t recordWrite();
+    static void endRecordWrite();
+    static uint8_t recordHeader(uint8_t*, uint32_t);
+#if USE_MIDI_SEQUENCER
+    static void sequencerTick();
+    static void startSequence();
+#endif
+    static void fadeGain(uint32_t, uint16_t, uint16_t wait = 0);
+    static void fadeWait();
+    static void writeVolume();
+    static void volumeWrite();
+    static void volumeAvailable();
+    static uint16_t volumeWord();
+    static uint16_t rampTicks(uint16_t);
+    static uint32_t tellTrack();
+    void positionStart(uint32_t, uint32_t);
+    static void positionResync();
+    static uint32_t bytesToMs(uint32_t);
+    uint8_t seekTo(uint32_t, uint16_t fade = VOLUME_RAMP_SEEK);
+    bool seekTime(uint32_t*);
+    static void seekFlush();
+    static bool streamHeaders();
+    static bool seekParse(uint32_t);
+    void wavHeader();
+    static int16_t seekRead(uint32_t, void*, uint16_t);
+    static uint32_t seekSync(uint32_t, uint32_t, uint32_t*);
+    static void seekBisect(uint32_t, uint32_t*, uint32_t*, uint32_t, uint32_t);
+    static bool oggPage(uint32_t, uint32_t*, uint32_t*);
+    static uint32_t oggSeek(uint32_t*);
+    static bool flacFrame(uint32_t, uint32_t*);
+    static uint32_t flacSeek(uint32_t*);
+#if USE_CUE_TRACK
+    static void openCues(char*);
+    static void closeCues();
+    static void cueSeek(uint32_t);
+    static void cueRead();
+#endif
+    bool seekTrack(uint32_t);
+    void openRaw(uint32_t firstBlock = 0);
+    static void endRawRead();
+    static uint16_t fillBlockBuffer();
+#if MP3_REFILL_DMA
+    static void sdi_low();
+#endif
     uint8_t VSLoadUserCode(char*);
 
     //Create the variables to be used by SdFat Library
@@ -746,8 +1106,206 @@ class SFEMP3Shield {
     static uint16_t spi_Read_Rate;
     static uint16_t spi_Write_Rate;
 
-/** \brief Buffer for moving data between Filehandle and VSdsp.*/
-    static uint8_t mp3DataBuffer[32];
+/** \brief Flag indicating refill() is running, as to not re-enter it.*/
+    static volatile uint8_t refill_active;
+
+/** \brief Number of times the watchdog found a missed DREQ edge and refilled.*/
+    static volatile uint16_t refill_rescues;
+
+/** \brief First block of the open sound bank, or 0 if none is open.*/
+    static uint32_t bank_firstBlock;
+
+/** \brief Number of entries in the open sound bank's table.*/
+    static uint16_t bank_count;
+
+/** \brief Queue of real-time MIDI messages waiting for DREQ.*/
+    static midi_event_m midi_queue[MIDI_QUEUE_SIZE];
+
+/** \brief Index of midi_queue where the next message is to be queued.*/
+    static uint8_t midi_head;
+
+/** \brief Index of midi_queue of the next message to be sent.*/
+    static uint8_t midi_tail;
+
+/** \brief Statistics of the real-time MIDI messages sent.*/
+    static midi_stats_m midi_stats;
+
+/** \brief Number of bytes of mp3BlockBuffer filled, of the block being recorded.*/
+    static uint16_t rec_fill;
+
+/** \brief Block of the SdCard the block being recorded is written to.*/
+    static uint32_t rec_block;
+
+/** \brief Last block of the preallocated recording file.*/
+    static uint32_t rec_lastBlock;
+
+/** \brief Flag indicating the recording's multiple block write is open.*/
+    static uint8_t rec_writing;
+
+/** \brief Size of the preallocated recording file, the most bytes it may hold.*/
+    static uint32_t rec_max;
+
+/** \brief Sample rate of the recording.*/
+    static uint16_t rec_rate;
+
+/** \brief Flag indicating linear PCM rather than IMA ADPCM is recorded.*/
+    static uint8_t rec_pcm;
+
+/** \brief Statistics of the recording.*/
+    static record_stats_m rec_stats;
+
+#if USE_MIDI_SEQUENCER
+/** \brief Sequenced events read ahead, waiting for their time.*/
+    static midi_event_m seq_buffer[MIDI_SEQ_BUFFER];
+
+/** \brief Index of seq_buffer where the next event read is to be put.*/
+    static volatile uint8_t seq_head;
+
+/** \brief Index of seq_buffer of the next event to be dispatched.*/
+    static volatile uint8_t seq_tail;
+
+/** \brief Number of events of the sequence not yet read ahead.*/
+    static uint32_t seq_remaining;
+
+/** \brief Next event to be read ahead when in Flash, or NULL when read from the track.*/
+    static const midi_event_m* seq_P;
+
+/** \brief micros() at the start of the sequence.*/
+    static uint32_t seq_start;
+
+/** \brief Flag indicating a sequence is playing.*/
+    static volatile uint8_t seq_active;
+#endif
+
+/** \brief Fade gain, 16.16 fixed point position along the volume curve, from 0 silent to VOLUME_CURVE_STEPS unity.*/
+    static volatile uint32_t fade_pos;
+
+/** \brief Change of fade_pos per tick of the volume ramp.*/
+    static volatile int32_t fade_step;
+
+/** \brief Value of fade_pos at the end of its ramp.*/
+    static volatile uint32_t fade_end;
+
+/** \brief Ticks left of the fade gain's ramp.*/
+    static volatile uint16_t fade_ticks;
+
+/** \brief Ticks left before the fade gain's ramp starts, as seekTo() lets the VSdsp settle.*/
+    static volatile uint16_t fade_wait;
+
+/** \brief Left and right master volume, 16.16 fixed point in -0.5dB steps.*/
+    static volatile uint32_t base_pos[2];
+
+/** \brief Change of base_pos per tick of the volume ramp.*/
+    static volatile int32_t base_step[2];
+
+/** \brief Left and right master volume at the end of its ramp.*/
+    static volatile uint8_t base_end[2];
+
+/** \brief Ticks left of the master volume's ramp.*/
+    static volatile uint16_t base_ticks;
+
+/** \brief SCI_VOL as last written.*/
+    static volatile uint16_t vol_written;
+
+/** \brief Flag set by volumeTick() when SCI_VOL is to be written with a new step.*/
+    static volatile uint8_t vol_pending;
+
+/** \brief Offset of the next byte to be sent to the VSdsp by refill(), as tellTrack().*/
+    static volatile uint32_t pos_fed;
+
+/** \brief Offset of the first byte sent since the track started or was repositioned.*/
+    static uint32_t pos_segment;
+
+/** \brief Milliseconds into the track at pos_segment.*/
+    static uint32_t pos_segment_ms;
+
+/** \brief Estimate of the bytes sent but not yet heard, held in the VSdsp's buffer.*/
+    static volatile uint16_t pos_latency;
+
+/** \brief Flag indicating pos_latency has been taken from the first refill() of the segment.*/
+    static volatile uint8_t pos_primed;
+
+/** \brief Bytes per second of the playing stream, or 0 if not yet known.*/
+    static uint32_t pos_rate;
+
+/** \brief millis() of the last resync of the position tracker.*/
+    static uint32_t pos_synced;
+
+/** \brief Format of the playing track, of format_m, or fmt_unknown for a clip.*/
+    static uint8_t track_format;
+
+/** \brief Flag indicating the track's headers have been parsed by seekParse().*/
+    static uint8_t seek_parsed;
+
+/** \brief Offset of the first frame, page or sample past a WAV, Ogg or FLAC's headers.*/
+    static uint32_t seek_start;
+
+/** \brief Offset just past the audio, the end of a WAV's data chunk, else of the file.*/
+    static uint32_t seek_end;
+
+/** \brief Byte rate of a WAV, or sample rate of an Ogg or FLAC, 0 if not known.*/
+    static uint32_t seek_rate;
+
+/** \brief Block align of a WAV, or fixed block size of a FLAC, else 0.*/
+    static uint16_t seek_align;
+
+/** \brief Offset of a FLAC's SEEKTABLE.*/
+    static uint32_t seek_table;
+
+/** \brief Number of points of a FLAC's SEEKTABLE, 0 if it has none.*/
+    static uint16_t seek_points;
+
+/** \brief Offset of the payload of a WAV's "fmt " chunk, for wavHeader().*/
+    static uint32_t wav_fmt;
+
+/** \brief Size of a WAV's "fmt " chunk, for wavHeader().*/
+    static uint16_t wav_fmtSize;
+
+/** \brief Blocks read by the last seek.*/
+    static uint16_t seek_blocks;
+
+/** \brief Block last read by seekRead().*/
+    static uint32_t seek_lastBlock;
+
+#if USE_CUE_TRACK
+/** \brief Cue file of the playing track.*/
+    static SdFile cues;
+
+/** \brief Cues read ahead, waiting for their time.*/
+    static cue_m cue_buffer[CUE_BUFFER];
+
+/** \brief Index of cue_buffer where the next cue read is to be put.*/
+    static uint8_t cue_head;
+
+/** \brief Index of cue_buffer of the next cue to be taken.*/
+    static uint8_t cue_tail;
+
+/** \brief Number of cues of the file not yet read ahead.*/
+    static uint32_t cue_remaining;
+#endif
+
+/** \brief First block of the contiguous track, or sound bank, read by raw block address.*/
+    static uint32_t raw_firstBlock;
+
+/** \brief Offset from raw_firstBlock of the next byte to be read by refill().*/
+    static uint32_t raw_position;
+
+/** \brief Offset from raw_firstBlock just past the playing track or clip, or 0 if it is read with SdBaseFile::read().*/
+    static uint32_t raw_end;
+
+#if MP3_REFILL_RAW
+/** \brief Block the open multiple block read will receive next, or 0 if none is open.*/
+    static uint32_t raw_nextBlock;
+#endif
+
+/** \brief Block buffer for moving data between Filehandle, or raw blocks, and VSdsp.*/
+    static uint8_t mp3BlockBuffer[512];
+
+/** \brief Index of the next byte of mp3BlockBuffer to be sent to the VSdsp.*/
+    static uint16_t mp3BlockHead;
+
+/** \brief Number of valid bytes in mp3BlockBuffer.*/
+    static uint16_t mp3BlockCount;
 
 /** \brief contains a local value of the beleived current bit-rate.*/
     uint8_t bitrate;
@@ -796,6 +1354,7 @@ union sci_bass_m {
  */
 char* strip_nonalpha_inplace(char *s);
 bool isFnMusic(char*);
+uint8_t sniffFormat(SdBaseFile*, audio_format_m* format = NULL);
 
 //------------------------------------------------------------------------------
 /*
@@ -278,6 +278,9 @@ Support for Arduino Leonardo is afflicted by having the SPI pins not routing the
  * \n USE_MP3_Polled, USE_MP3_Timer1 or USE_MP3_SimpleTimer means.
  * \n Assuming resources are not committed else where.
  *
+ * \note Where a sketch blocks interrupts for long periods, USE_MP3_INTxWatchdog
+ * keeps the INTx refill and adds Timer1 as a safety net for missed DREQ edges.
+ *
  * \warning Remember to restart Arduino IDE for new Libraries to be available.
  * Coping the file is not enough.
  */
@@ -343,13 +346,34 @@ Support for Arduino Leonardo is afflicted by having the SPI pins not routing the
  */
 #define USE_MP3_SimpleTimer 3
 
+/**
+ * \brief A macro of the enumerated value used to select INTx with a Timer1 watchdog as the means to refill the VS10xx
+ *
+ * Where refill() is attached to INTx as with USE_MP3_INTx. In addition Timer1
+ * checks the DREQ every MP3_WATCHDOG_PERIOD. Finding DREQ high with no refill()
+ * underway, the rising edge was missed, then the watchdog calls refill() itself
+ * and counts the rescue. See SFEMP3Shield::getRefillRescues().
+ *
+ * An edge can be missed when arriving as refill() is finishing, or when the
+ * sketch or another library blocks or detaches interrupts. Without the watchdog
+ * the stream then stalls until the next call that refills.
+ *
+ * \note MP3_WATCHDOG_PERIOD is required when using this means.
+ *
+ * \sa The use of USE_MP3_INTxWatchdog also requires the TimerOne.h library, as
+ * with USE_MP3_Timer1.
+ */
+#define USE_MP3_INTxWatchdog 4
+
 #endif
 
 //------------------------------------------------------------------------------
 /*
  * When means other than Polled and INTx are used the following Libraries need to be loaded.
  */
-#if defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_Timer1
+#if defined(USE_MP3_REFILL_MEANS) \
+    && ( (USE_MP3_REFILL_MEANS == USE_MP3_Timer1) \
+    ||   (USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog) )
   #include <TimerOne.h>
 // strange if TimerOne.h is present but not selected it still consums 6 bytes, something to do with Arduino's pre-compiler and Linker.
 #elif defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_SimpleTimer
@@ -370,6 +394,95 @@ Support for Arduino Leonardo is afflicted by having the SPI pins not routing the
 #define MP3_REFILL_PERIOD 100
 #endif
 
+#if defined(USE_MP3_REFILL_MEANS) && USE_MP3_REFILL_MEANS == USE_MP3_INTxWatchdog
+
+/**
+ * \brief A macro used to determine the number of microseconds between watchdog checks of the DREQ.
+ *
+ * The VS10xx's 2048 byte stream buffer lasts about 50ms of a 320Kbps MP3.
+ * The period should be well within that, a longer period costing less CPU
+ * but leaving less margin for a rescue. Tune it using getRefillRescues().
+ */
+#define MP3_WATCHDOG_PERIOD 10000
+#endif
+
+//------------------------------------------------------------------------------
+/**
+ * \def MP3_SPI_BUS_ID
+ * \brief A macro of the SdSpiBus device id used by the VS10xx.
+ *
+ * The SdCard and the VS10xx share the same SPI bus. SdFat's SdSpiBus keeps
+ * track of which device, and at what rate, last used the bus. So that
+ * cs_low() and dcs_low() only reconfigure the SPI when the SdCard was last on
+ * the bus, or the rate changes. And refill() defers itself when it interrupts
+ * an SdCard transaction, running as soon as the SdCard is deselected.
+ *
+ * \note Must not equal SPI_BUS_ID_SD, nor any other driver's id on the bus.
+ * \note Set USE_SPI_BUS_ARBITRATION to 0 in SdFatConfig.h to revert to the
+ * prior behaviour of reconfiguring the SPI on every transaction.
+ */
+#define MP3_SPI_BUS_ID           2
+
+//------------------------------------------------------------------------------
+/**
+ * \def MP3_REFILL_DMA
+ * \brief A macro to enable block buffered DMA refilling on ARM based Arduinos.
+ *
+ * refill() reads whole 512 byte blocks of the track, which on ARM SdFat
+ * receives by DMA (Due) or FIFO (Teensy 3) straight from the SdCard, bypassing
+ * its cache. When set to 1 each 32 byte burst is then sent to the VS10xx's
+ * data stream with SdSpi::send(), as a single DMA transmit or FIFO burst
+ * rather than a byte at a time.
+ *
+ * \note As the SdCard and VS10xx share the one SPI bus the block read can not
+ * overlap the bursts, rather it is amortized over 16 of them.
+ * \note Defaults off on AVR, which has neither DMA nor a FIFO and where
+ * sdi_send() is as quick.
+ */
+#if defined(__arm__)
+  #define MP3_REFILL_DMA           1
+#else
+  #define MP3_REFILL_DMA           0
+#endif
+
+/**
+ * \def MP3_DMA_SCK_DIVISOR
+ * \brief A macro of the SdSpi SCK divisor used for the DMA bursts to the VS10xx.
+ *
+ * The VS10xx's SDI may be clocked up to CLKI/4, about 9.2MHz with the SC_MULT
+ * of 3.0x set by vs_init(), a CLKI of 36.864MHz. 10 yields 8.4MHz on a Due,
+ * whose divisor is exact. A Teensy 3 only divides by 8 or 12, 8 yields 6MHz.
+ */
+#if defined(CORE_TEENSY)
+  #define MP3_DMA_SCK_DIVISOR      8
+#else
+  #define MP3_DMA_SCK_DIVISOR      10
+#endif
+
+/**
+ * \def MP3_REFILL_RAW
+ * \brief A macro to stream contiguous tracks by raw multiple block reads.
+ *
+ * When set to 1 playMP3() and playClip() check once, as the track is opened,
+ * if it is contiguous on the SdCard. If so refill() reads its blocks with
+ * Sd2Card::readStart() and Sd2Card::readData() into the block buffer, leaving
+ * the card in one multiple block read between refills. Neither the FAT nor
+ * SdVolume's cache are touched per block. Sound bank clips are read the same.
+ * Fragmented tracks fall back to SdBaseFile::read().
+ *
+ * Any file operation ends the multiple block read first, by SdSpiBus's
+ * preempt handler, and refill() restarts it at the next block needed.
+ *
+ * When set to 0 contiguous tracks are read with SdBaseFile::read(), and bank
+ * clips by a Sd2Card::readBlock() per block.
+ *
+ * Costs no RAM, the block buffer is used by every refill. Enabled by default.
+ *
+ * \note Requires USE_SPI_BUS_ARBITRATION of SdFatConfig.h, and a free slot
+ * of SPI_BUS_PREEMPT_MAX, else each block is read singly.
+ */
+#define MP3_REFILL_RAW             1
+
 //------------------------------------------------------------------------------
 /**
  * \def MIDI_CHANNEL
@@ -410,6 +523,200 @@ Support for Arduino Leonardo is afflicted by having the SPI pins not routing the
  */
 #define MIDI_INTENSITY         127 // Full scale.
 
+/**
+ * \def MIDI_QUEUE_SIZE
+ * \brief A macro of the number of real-time MIDI messages that may be queued.
+ *
+ * Messages of SFEMP3Shield::noteOn() and friends are queued while DREQ is low,
+ * and sent by SFEMP3Shield::midiFlush() as soon as the VSdsp has room. Each
+ * costs 8 bytes of RAM. One less than the size may be queued at a time.
+ */
+#define MIDI_QUEUE_SIZE          8
+
+//------------------------------------------------------------------------------
+/**
+ * \def USE_MIDI_SEQUENCER
+ * \brief A macro to enable the time-stamped MIDI sequencer.
+ *
+ * When set to 1 SFEMP3Shield::playSequence() and SFEMP3Shield::playSequence_P()
+ * play a list of midi_event_m, each at its microsecond from the start. Events
+ * are dispatched by Timer1 every MIDI_SEQ_TICK, while
+ * SFEMP3Shield::sequenceAvailable() reads ahead from the SdCard in the main loop.
+ *
+ * \sa The use of USE_MIDI_SEQUENCER requires the TimerOne.h library, as with
+ * USE_MP3_Timer1. Timer1 is shared, as refill() is not used in real-time MIDI.
+ * \note Sequences are created from Standard MIDI Files with plugins/mk_seq.pl.
+ */
+#define USE_MIDI_SEQUENCER       0
+
+/**
+ * \def MIDI_SEQ_TICK
+ * \brief A macro of the period in microseconds at which sequenced events are dispatched.
+ *
+ * Being the most an event may be late, less any wait on the SPI bus.
+ */
+#define MIDI_SEQ_TICK          500
+
+/**
+ * \def MIDI_SEQ_BUFFER
+ * \brief A macro of the number of sequenced events read ahead.
+ *
+ * Read from the SdCard in blocks of half as many. Each costs 8 bytes of RAM.
+ */
+#define MIDI_SEQ_BUFFER         16
+
+/**
+ * \def MIDI_SEQ_BURST
+ * \brief A macro of the most events dispatched per tick, bounding the work of the ISR.
+ *
+ * At 6 bytes each, no more than 5 fit in the 32 bytes guaranteed by DREQ.
+ */
+#define MIDI_SEQ_BURST           4
+
+#if USE_MIDI_SEQUENCER
+  #include <TimerOne.h>
+#endif
+
+//------------------------------------------------------------------------------
+/**
+ * \def MP3_RECORD_BURST
+ * \brief A macro of the number of 16 bit words drained from the VSdsp's recording buffer at a time.
+ *
+ * Where SFEMP3Shield::recordAvailable() reads SCI_HDAT0 only once SCI_HDAT1
+ * counts at least this many words, in bursts of this many. 128 words being
+ * one 256 byte IMA ADPCM block, as the VSdsp requires it be read whole.
+ */
+#define MP3_RECORD_BURST       128
+
+/**
+ * \def MP3_RECORD_BUFFER
+ * \brief A macro of the size in 16 bit words of the VSdsp's recording buffer.
+ *
+ * A fill of SCI_HDAT1 this high is counted as an overrun, samples being lost.
+ */
+#define MP3_RECORD_BUFFER     1024
+
+/**
+ * \def MP3_RECORD_NEAR_FULL
+ * \brief A macro of the fill of the VSdsp's recording buffer counted as near full.
+ *
+ * The VSdsp's datasheet warns that beyond 896 words the buffer is in danger
+ * of overflowing.
+ */
+#define MP3_RECORD_NEAR_FULL   896
+
+/**
+ * \def MP3_RECORD_CLOCKF
+ * \brief A macro of the SCI_CLOCKF used while recording.
+ *
+ * The VSdsp's datasheet recommends 4.5x for recording, more than the 3.0x
+ * set by vs_init() for playing.
+ */
+#define MP3_RECORD_CLOCKF   0xC000
+
+//------------------------------------------------------------------------------
+/**
+ * \def USE_VOLUME_RAMP
+ * \brief A macro to enable the volume ramp engine.
+ *
+ * When set to 1 SFEMP3Shield::fadeIn(), SFEMP3Shield::fadeOut() and
+ * SFEMP3Shield::fadeTo() step the volume from Timer0's compare A interrupt,
+ * which is only enabled while a ramp is running. Timer0 keeps millis(), and
+ * runs anyway, so no timer is taken from the sketch. The interrupt only
+ * computes each step, SCI_VOL is written by refill() while playing, else by
+ * available() or isFading().
+ *
+ * Then skip() and skipTo() fade out before seeking and back in after, and
+ * stopTrack() fades out before cutting the stream, in place of muting. With
+ * VOLUME_RAMP_START playMP3() also fades in.
+ *
+ * When 0 the fades are immediate. Disabled by default.
+ *
+ * \note Requires USE_SPI_BUS_ARBITRATION of SdFatConfig.h, and an AVR.
+ * \warning Timer0's compare A interrupt vector, TIMER0_COMPA_vect, is then
+ * defined by the library. It conflicts with any sketch or other library
+ * defining it, such as those using OCR0A, failing to link with a multiple
+ * definition of __vector_14 on the ATmega328. Use either, not both.
+ */
+#define USE_VOLUME_RAMP          0
+
+/**
+ * \def VOLUME_RAMP_TICK_US
+ * \brief A macro of the period in microseconds of the volume ramp's steps.
+ *
+ * That of Timer0's overflow, as set up by the Arduino core. 1024us at 16MHz,
+ * 2048us at 8MHz.
+ */
+#define VOLUME_RAMP_TICK_US    (64UL * 256 * 1000000UL / F_CPU)
+
+/**
+ * \def VOLUME_RAMP_SEEK
+ * \brief A macro of the milliseconds to fade out before, and back in after, skip() and skipTo().
+ */
+#define VOLUME_RAMP_SEEK        20
+
+/**
+ * \def VOLUME_RAMP_STOP
+ * \brief A macro of the milliseconds to fade out before stopTrack() cuts the stream.
+ */
+#define VOLUME_RAMP_STOP        30
+
+/**
+ * \def VOLUME_RAMP_START
+ * \brief A macro of the milliseconds to fade in as playMP3() starts a track.
+ *
+ * 0, by default, starts each track at full volume. A track started at a
+ * timecode fades in only after seekTo() has let the VSdsp settle.
+ */
+#define VOLUME_RAMP_START        0
+
+/**
+ * \def VOLUME_RAMP_SETTLE
+ * \brief A macro of the milliseconds the VSdsp plays silent after a seek, before fading in.
+ *
+ * Where the VSdsp resyncs to the frames of the new position, any noise of
+ * the jump not being heard. Counted by the volume ramp's ticks, seekTo()
+ * returning at once. Without USE_VOLUME_RAMP the volume is restored at once.
+ */
+#define VOLUME_RAMP_SETTLE      50
+
+//------------------------------------------------------------------------------
+/**
+ * \def POSITION_RESYNC_MS
+ * \brief A macro of the milliseconds between resyncs of the position tracker.
+ *
+ * SFEMP3Shield::currentPosition() counts the bytes refill() has sent to the
+ * VSdsp, from RAM. At most this often it also reads SCI_DECODE_TIME and
+ * para_byteRate, to correct the byte rate and the estimate of the bytes held
+ * in the VSdsp's buffer. Shorter converges sooner, at the cost of more SCI
+ * traffic while playing.
+ */
+#define POSITION_RESYNC_MS    1000
+
+//------------------------------------------------------------------------------
+/**
+ * \def USE_CUE_TRACK
+ * \brief A macro to enable cue tracks.
+ *
+ * When set to 1 SFEMP3Shield::playMP3() also opens the track's cue file, of
+ * the same name with the extension ".cue", if there is one. A list of cue_m,
+ * each at its millisecond into the track, in order of time. The first are
+ * read ahead as the track starts, and as it is repositioned. Then
+ * SFEMP3Shield::nextCue(), called from the main loop, takes each as the
+ * position of SFEMP3Shield::currentPosition() reaches it.
+ *
+ * \note Cue files are created from a text list with plugins/mk_cue.pl.
+ */
+#define USE_CUE_TRACK            0
+
+/**
+ * \def CUE_BUFFER
+ * \brief A macro of the number of cues read ahead.
+ *
+ * Read from the SdCard in blocks of half as many. Each costs 8 bytes of RAM.
+ */
+#define CUE_BUFFER              16
+
 
 
 
@@ -147,6 +147,7 @@ The filenames are kept short as SdCard only support 8.3.
 
 \note All plugins should be placed in the root of the SdCard.
 \note \b patches.053 is a cumulative update correcting many known troublesome issues. Hence patches.053 is attempted in SFEMP3Shield::vs_init.
+\note \b rtmidi.053 is loaded by SFEMP3Shield::midiBegin(), for real-time MIDI messages.
 \note VSLI may post periodic updates on there <A HREF = "http://www.vlsi.fi/en/support/software.html">software website</A>
 \note Perl is natively provided on Linux systems, and may be downloaded from <a href="http://www.activestate.com/activeperl/downloads">Active Perl </a> for windows systems.
 \see about Analog to Digital Mixer (e.g. admx____.053) please note \ref limitation
@@ -229,12 +230,43 @@ The following error codes return from the SFEMP3Shield::begin() member function.
 \deprecated Error codes 1,2,3 due to use of \c sd.begin() as global, starting version 1.1.0
 
 \subsection playfunc Playing functions:
-The following error codes return from the SFEMP3Shield::playTrack() or SFEMP3Shield::playMP3() member functions.
+The following error codes return from the SFEMP3Shield::playTrack(), SFEMP3Shield::playMP3(), SFEMP3Shield::preloadClip() or SFEMP3Shield::playClip() member functions.
 <pre>
 0 OK
 1 Already playing track
 2 File not found
 3 indicates that the VSdsp is in reset.
+4 File content is not of a known audio format, see sniffFormat()
+</pre>
+
+\subsection bankfunc Sound bank functions:
+The following error codes return from the SFEMP3Shield::openBank() or SFEMP3Shield::playBankClip() member functions.
+<pre>
+0 OK
+1 Already playing track
+2 File not found, or no clip with that id in the open bank
+3 indicates that the VSdsp is in reset.
+4 Bank is not contiguous on the SdCard
+5 File is not a sound bank of a known version
+</pre>
+
+\subsection midifunc Real-time MIDI functions:
+The following error codes return from the SFEMP3Shield::midiBegin(), SFEMP3Shield::midiEnd(), SFEMP3Shield::noteOn(), SFEMP3Shield::noteOff(), SFEMP3Shield::controlChange(), SFEMP3Shield::programChange(), SFEMP3Shield::playSequence() or SFEMP3Shield::playSequence_P() member functions.
+<pre>
+0 OK
+1 Already playing track, real-time MIDI not started, or already playing a sequence
+2 rtmidi.053 not found, or sequence file not found or not a sequence
+3 indicates that the VSdsp is in reset.
+</pre>
+
+\subsection recordfunc Recording function:
+The following error codes return from the SFEMP3Shield::startRecording() member function.
+<pre>
+0 OK
+1 Already playing track
+2 Contiguous file of the size could not be created
+3 indicates that the VSdsp is in reset.
+4 SdCard failed to start the multiple block write
 </pre>
 
 \subsection skipTofunc Skip function:
@@ -242,7 +274,7 @@ The following error codes return from the SFEMP3Shield::skipTo()member function.
 <pre>
 0 OK
 1 Not Playing track
-2 Failed to skip to new file location
+2 Failed to skip to new file location, such as of a format whose byte rate is not yet known. The track carries on from where it was.
 </pre>
 
 \section comment Support
@@ -0,0 +1,125 @@
+
+#!/usr/bin/perl
+
+#** @file mk_bank.pl
+# @verbatim
+#####################################################################
+# This program is not guaranteed to work at all, and by using this  #
+# program you release the author of any and all liability.          #
+#                                                                   #
+# You may use this code as long as you are in compliance with the   #
+# license (see the LICENSE file) and this notice, disclaimer and    #
+# comment box remain intact and unchanged.                          #
+#                                                                   #
+# Purpose: to pack many short audio clips into one sound bank file  #
+# for SFEMP3Shield::openBank() and SFEMP3Shield::playBankClip().    #
+#                                                                   #
+# example usage: mk_bank.pl .\sounds.bnk .\1door.mp3 .\2bell.wav    #
+#                                                                   #
+# Each clip's id is the number leading its filename, otherwise the  #
+# next number after the highest id so far.                          #
+#                                                                   #
+#####################################################################
+# @endverbatim
+#*
+use strict;
+use warnings;
+
+#** @var $outF
+# Output Arguement of Filename to be created.
+#*
+my $outF = shift @ARGV or die "Need output file.\n";
+@ARGV or die "Need input files.\n";
+
+#** @var %formats
+# format_m values of SFEMP3Shield.h, by file extension.
+#*
+my %formats = (mp3 => 1, wav => 2, ogg => 3, fla => 4, flac => 4,
+               mid => 5, midi => 5, aac => 6, wma => 7, mp4 => 8, m4a => 8);
+
+#** @var @bitrates
+# MP3 bitrate in kbps, as bitrate_table of SFEMP3Shield.cpp.
+# Indexed by the bitrate bits, then V1 L1, V1 L2, V1 L3, V2 L1, V2 L2, V2 L3.
+#*
+my @bitrates = (
+	[  0,   0,   0,   0,   0,   0],
+	[ 32,  32,  32,  32,   8,   8],
+	[ 64,  48,  40,  48,  16,  16],
+	[ 96,  56,  48,  56,  24,  24],
+	[128,  64,  56,  64,  32,  32],
+	[160,  80,  64,  80,  40,  40],
+	[192,  96,  80,  96,  48,  48],
+	[224, 112,  96, 112,  56,  56],
+	[256, 128, 112, 128,  64,  64],
+	[288, 160, 128, 144,  80,  80],
+	[320, 192, 160, 160,  96,  96],
+	[352, 224, 192, 176, 112, 112],
+	[384, 256, 224, 192, 128, 128],
+	[416, 320, 256, 224, 144, 144],
+	[448, 384, 320, 256, 160, 160]);
+
+my @clips;
+my $nextId = 1;
+my %used;
+
+foreach my $inF (@ARGV) {
+	open(my $infile, '<:raw', $inF) or die "Could not open '$inF' $!\n";
+	local $/;
+	my $data = <$infile>;
+	close($infile);
+
+	my ($base) = $inF =~ m/([^\/\\]+)$/;
+	my ($ext) = $base =~ m/\.([^.]+)$/;
+	my $format = $formats{lc($ext || '')} || 0;
+
+	my $id = ($base =~ m/^(\d+)/) ? $1 : $nextId;
+	die "Duplicate id $id for '$inF'\n" if $used{$id}++;
+	die "Id $id of '$inF' is over 65535\n" if $id > 65535;
+	$nextId = $id + 1 if $id >= $nextId;
+
+	my $bitrate = 0;
+	if ($format == 1) {
+		# the VSdsp has no use for the ID3 tags, drop them from the bank.
+		if ($data =~ m/^ID3/) {
+			my @size = unpack('C4', substr($data, 6, 4));
+			my $tag = 10 + (($size[0] << 21) | ($size[1] << 14) | ($size[2] << 7) | $size[3]);
+			$data = substr($data, $tag);
+		}
+		if (length($data) > 128 && substr($data, -128, 3) eq 'TAG') {
+			$data = substr($data, 0, -128);
+		}
+		# look for first MP3 frame (11 1's), as sniffFormat()
+		while ($data =~ m/\xFF([\xE0-\xFF])(.)/gs) {
+			my $b1 = ord($1);
+			my $b2 = ord($2);
+			my $layer = ($b1 >> 1) & 3;
+			next if $layer == 0;
+			my $row = (($b1 & 0x08) ? 0 : 3) + (3 - $layer);
+			$bitrate = int($bitrates[$b2 >> 4][$row] / 8) if ($b2 >> 4) < 15;
+			$data = substr($data, pos($data) - 3);
+			last;
+		}
+	}
+
+	push @clips, {id => $id, format => $format, bitrate => $bitrate, data => $data, name => $inF};
+}
+
+@clips = sort { $a->{id} <=> $b->{id} } @clips;
+
+# header, then the table of entries, then the clips packed one after another.
+my $offset = 16 + 16 * scalar(@clips);
+
+open(my $outfile, '>:raw', $outF) or die "Unable to open: $!";
+print $outfile pack('a4 v v x8', 'SBNK', 1, scalar(@clips));
+foreach my $clip (@clips) {
+	$clip->{offset} = $offset;
+	print $outfile pack('v C C V V x4', $clip->{id}, $clip->{format}, $clip->{bitrate},
+		$offset, length($clip->{data}));
+	$offset += length($clip->{data});
+}
+foreach my $clip (@clips) {
+	print $outfile $clip->{data};
+	printf "%5d %-24s format %d %3d bytes/ms offset %8d length %8d\n", $clip->{id},
+		$clip->{name}, $clip->{format}, $clip->{bitrate}, $clip->{offset}, length($clip->{data});
+}
+close($outfile);
@@ -0,0 +1,68 @@
+#!/usr/bin/perl
+
+#** @file mk_cue.pl
+# @verbatim
+#####################################################################
+# This program is not guaranteed to work at all, and by using this  #
+# program you release the author of any and all liability.          #
+#                                                                   #
+# You may use this code as long as you are in compliance with the   #
+# license (see the LICENSE file) and this notice, disclaimer and    #
+# comment box remain intact and unchanged.                          #
+#                                                                   #
+# Purpose: to convert a text list of cues into the cue file of a    #
+# track, as read by SFEMP3Shield::nextCue().                        #
+#                                                                   #
+# example usage: mk_cue.pl .\show.txt .\track001.cue                #
+#                                                                   #
+# Each line is "time action channel value", where time is ms, or    #
+# m:ss.mmm as shown by an audio editor. Anything after # is a       #
+# comment. The cues are sorted by time, those of the same time      #
+# kept in the order given.                                          #
+#                                                                   #
+#####################################################################
+# @endverbatim
+#*
+use strict;
+use warnings;
+
+#** @var $inF
+# Input Arguement of the text list to be read.
+#*
+my $inF = shift @ARGV or die "Need input file.\n";
+
+#** @var $outF
+# Output Arguement of Filename to be created.
+#*
+my $outF = shift @ARGV or die "Need output file.\n";
+
+open(my $infile, '<', $inF) or die "Could not open '$inF' $!\n";
+
+# cues as [time, order, action, channel, value]
+my @cues;
+while (my $line = <$infile>) {
+	$line =~ s/#.*//;
+	next if $line =~ /^\s*$/;
+	my ($time, $action, $channel, $value) = split(' ', $line);
+	die "Need time, action, channel and value at line $.\n" unless defined $value;
+
+	if ($time =~ /^(\d+):(\d+(?:\.\d*)?)$/) {
+		$time = int(($1 * 60 + $2) * 1000 + 0.5);
+	} elsif ($time !~ /^\d+$/) {
+		die "Bad time '$time' at line $.\n";
+	}
+	die "Action, channel or value out of range at line $.\n"
+		if $action > 255 || $channel > 255 || $value > 65535;
+	push @cues, [$time, scalar(@cues), $action, $channel, $value];
+}
+close($infile);
+
+@cues = sort { $a->[0] <=> $b->[0] || $a->[1] <=> $b->[1] } @cues;
+
+open(my $outfile, '>:raw', $outF) or die "Unable to open: $!";
+print $outfile pack('a4 v v', 'SCUE', 1, 0);
+foreach my $c (@cues) {
+	print $outfile pack('V C C v', $c->[0], $c->[2], $c->[3], $c->[4]);
+}
+close($outfile);
+printf "%d cues, last at %.3f seconds\n", scalar(@cues), @cues ? $cues[-1][0] / 1000 : 0;
@@ -0,0 +1,148 @@
+
+#!/usr/bin/perl
+
+#** @file mk_seq.pl
+# @verbatim
+#####################################################################
+# This program is not guaranteed to work at all, and by using this  #
+# program you release the author of any and all liability.          #
+#                                                                   #
+# You may use this code as long as you are in compliance with the   #
+# license (see the LICENSE file) and this notice, disclaimer and    #
+# comment box remain intact and unchanged.                          #
+#                                                                   #
+# Purpose: to pre-render a Standard MIDI File into a sequence of    #
+# time-stamped events for SFEMP3Shield::playSequence().             #
+#                                                                   #
+# example usage: mk_seq.pl .\score.mid .\score.seq                  #
+#                mk_seq.pl -c jingle .\jingle.mid .\jingle.h        #
+#                                                                   #
+# Tracks are merged and the tempo map applied, so that each event   #
+# carries its microsecond from the start. With -c a C array of      #
+# midi_event_m is written instead, for SFEMP3Shield::playSequence_P #
+#                                                                   #
+#####################################################################
+# @endverbatim
+#*
+use strict;
+use warnings;
+
+#** @var $arrayName
+# Name of the C array to be written, if -c is given.
+#*
+my $arrayName;
+if (@ARGV && $ARGV[0] eq '-c') {
+	shift @ARGV;
+	$arrayName = shift @ARGV or die "Need array name.\n";
+}
+
+#** @var $inF
+# Input Arguement of Standard MIDI Filename to be read.
+#*
+my $inF = shift @ARGV or die "Need input file.\n";
+
+#** @var $outF
+# Output Arguement of Filename to be created.
+#*
+my $outF = shift @ARGV or die "Need output file.\n";
+
+open(my $infile, '<:raw', $inF) or die "Could not open '$inF' $!\n";
+my $data = do { local $/; <$infile> };
+close($infile);
+
+my ($id, $hlen, $format, $ntrks, $division) = unpack('a4 N n n n', $data);
+die "'$inF' is not a Standard MIDI File\n" if $id ne 'MThd';
+die "SMPTE time division is not supported\n" if $division & 0x8000;
+
+# events as [tick, track, order, tempo or undef, bytes of message]
+my @events;
+my $pos = 8 + $hlen;
+for (my $trk = 0; $trk < $ntrks && $pos < length($data); $trk++) {
+	my ($tid, $tlen) = unpack('a4 N', substr($data, $pos, 8));
+	$pos += 8;
+	my $end = $pos + $tlen;
+	if ($tid ne 'MTrk') { $pos = $end; $trk--; next; }
+
+	my $tick = 0;
+	my $status = 0;
+	my $order = 0;
+	while ($pos < $end) {
+		$tick += vlq(\$pos);
+		my $b = ord(substr($data, $pos, 1));
+		if ($b & 0x80) { $status = $b; $pos++; }
+		elsif (!$status) { die "Running status without status in '$inF'\n"; }
+
+		if ($status == 0xFF) {
+			my $type = ord(substr($data, $pos++, 1));
+			my $len = vlq(\$pos);
+			if ($type == 0x51 && $len == 3) {
+				my @t = unpack('C3', substr($data, $pos, 3));
+				push @events, [$tick, $trk, $order++, ($t[0] << 16) | ($t[1] << 8) | $t[2], undef];
+			}
+			$pos += $len;
+			$status = 0;
+		} elsif ($status == 0xF0 || $status == 0xF7) {
+			# the real-time MIDI plugin has no use for SysEx, skip it.
+			$pos += vlq(\$pos);
+			$status = 0;
+		} else {
+			my $n = (($status & 0xE0) == 0xC0) ? 1 : 2;
+			my @msg = ($status, unpack("C$n", substr($data, $pos, $n)));
+			$pos += $n;
+			push @events, [$tick, $trk, $order++, undef, \@msg];
+		}
+	}
+	$pos = $end;
+}
+
+@events = sort { $a->[0] <=> $b->[0] || $a->[1] <=> $b->[1] || $a->[2] <=> $b->[2] } @events;
+
+# apply the tempo map, 500000us per quarter note until told otherwise.
+my $tempo = 500000;
+my $lastTick = 0;
+my $us = 0;
+my @seq;
+foreach my $e (@events) {
+	$us += ($e->[0] - $lastTick) * $tempo / $division;
+	$lastTick = $e->[0];
+	if (defined $e->[3]) {
+		$tempo = $e->[3];
+	} else {
+		push @seq, [int($us + 0.5), $e->[4]];
+	}
+}
+
+open(my $outfile, '>:raw', $outF) or die "Unable to open: $!";
+if (defined $arrayName) {
+	printf $outfile "// %s, %d events, %.3f seconds\n", $inF, scalar(@seq), $us / 1000000;
+	print $outfile "PROGMEM const midi_event_m ${arrayName}[] = {\n";
+	foreach my $s (@seq) {
+		my @m = (@{$s->[1]}, 0, 0);
+		printf $outfile "  {{0x%02X, 0x%02X, 0x%02X}, %d, %luUL},\n", @m[0..2], scalar(@{$s->[1]}), $s->[0];
+	}
+	print $outfile "};\n";
+} else {
+	print $outfile pack('a4 v v', 'SSEQ', 1, 0);
+	foreach my $s (@seq) {
+		my @m = (@{$s->[1]}, 0, 0);
+		print $outfile pack('C3 C V', @m[0..2], scalar(@{$s->[1]}), $s->[0]);
+	}
+}
+close($outfile);
+printf "%d events, %.3f seconds\n", scalar(@seq), $us / 1000000;
+
+#** @function vlq
+# Read a MIDI variable length quantity.
+# @param $p reference to the position in $data, advanced past the quantity.
+# @retval value of the quantity.
+#*
+sub vlq {
+	my ($p) = @_;
+	my $v = 0;
+	my $b;
+	do {
+		$b = ord(substr($data, $$p++, 1));
+		$v = ($v << 7) | ($b & 0x7F);
+	} while ($b & 0x80);
+	return $v;
+}
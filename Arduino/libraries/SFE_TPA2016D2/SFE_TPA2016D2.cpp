@@ -76,6 +76,11 @@
 	unsigned char SFE_TPA2016D2::writeCompressionRatio(unsigned char compressionratio)
 	unsigned char SFE_TPA2016D2::readCompressionRatio(unsigned char *compressionratio)
 
+	unsigned char SFE_TPA2016D2::readConfig()
+	void SFE_TPA2016D2::resetConfig()
+	void SFE_TPA2016D2::beginConfig()
+	unsigned char SFE_TPA2016D2::applyConfig()
+
   License:
   We use the "beerware" license for our firmware. You can do
   ANYTHING you want with this code. If you like it, and we meet
@@ -87,6 +92,7 @@
 
   Revision history:
   version 1.0 2012/07/24 MDG Initial release 
+  version 1.1 shadow register copy, beginConfig()/applyConfig() burst writes
 */
 
 #include <SFE_TPA2016D2.h>
@@ -99,9 +105,17 @@
 #endif
 
 
+// Registers 1-7 as the amplifier powers up (see datasheet)
+static const unsigned char TPA2016D2_defaults[TPA2016D2_REGISTERS] PROGMEM =
+  { 0xC3, 0x05, 0x0B, 0x00, 0x06, 0x3A, 0xC2 };
+
+
 SFE_TPA2016D2::SFE_TPA2016D2()
-// Initialize the library (all we need to do is start up I2C)
+// Initialize the library (start up I2C, nothing is known about the registers yet)
 {
+	known = 0;
+	dirty = 0;
+	deferred = 0;
 	Wire.begin();
 }
 
@@ -110,13 +124,26 @@ unsigned char SFE_TPA2016D2::writeRegister(unsigned char reg, unsigned char valu
 // General-purpose write to a TPA2016D2 register
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char result;
+  unsigned char result, bit;
 
   Wire.beginTransmission(TPA2016D2_ADDR);// I2C address (use 7-bit address, wire library will modify for read/write)
   Wire.write(reg);                       // register to write
   Wire.write(value);                     // value to write
   result = Wire.endTransmission();
 
+  if ((reg >= TPA2016D2_CONTROL_REGISTER) && (reg <= TPA2016D2_AGC2_REGISTER))
+  {
+    bit = 1 << (reg - 1);
+    dirty &= ~bit;
+    if (result == 0)
+    {
+      shadow[reg-1] = value;
+      known |= bit;
+    }
+    else
+      known &= ~bit; // may or may not have been written
+  }
+
   if (result == 0)
      return 1;
   return 0;
@@ -142,55 +169,155 @@ unsigned char SFE_TPA2016D2::readRegister(unsigned char reg, unsigned char *valu
     if (x == 1)
     {
         *value = Wire.read();
+
+        // Refresh the shadow copy, unless a change is waiting for applyConfig()
+        if ((reg >= TPA2016D2_CONTROL_REGISTER) && (reg <= TPA2016D2_AGC2_REGISTER)
+          && !(dirty & (1 << (reg - 1))))
+        {
+          shadow[reg-1] = *value;
+          known |= 1 << (reg - 1);
+        }
         return 1;
     }
   }
   return 0;
 }
 
-unsigned char SFE_TPA2016D2::enableSpeakers()
-// Enable both output channels (unmute)
+
+unsigned char SFE_TPA2016D2::readConfig()
+// Read registers 1-7 into the shadow copy, in one transaction
+// Changes not yet sent by applyConfig() are discarded
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
+  unsigned char result, x;
 
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_CONTROL_REGISTER,&regvalue))
+  Wire.beginTransmission(TPA2016D2_ADDR);
+  Wire.write(TPA2016D2_CONTROL_REGISTER); // first register, the chip steps through the rest
+  result = Wire.endTransmission();
+
+  if (result == 0) // successful setup
   {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_CONTROL_REGISTER,((regvalue | B11000000))));
+    if (Wire.requestFrom(TPA2016D2_ADDR, TPA2016D2_REGISTERS) == TPA2016D2_REGISTERS)
+    {
+      for (x = 0; x < TPA2016D2_REGISTERS; x++)
+        shadow[x] = Wire.read();
+      known = (1 << TPA2016D2_REGISTERS) - 1;
+      dirty = 0;
       return 1;
+    }
   }
   return 0;
 }
 
-unsigned char SFE_TPA2016D2::disableSpeakers()
-// Disable both output channels (mute)
+
+void SFE_TPA2016D2::resetConfig()
+// Set the shadow copy to the power-on defaults, without any I2C traffic
+// Call right after the amplifier is powered up
+{
+  memcpy_P(shadow, TPA2016D2_defaults, TPA2016D2_REGISTERS);
+  known = (1 << TPA2016D2_REGISTERS) - 1;
+  dirty = 0;
+}
+
+
+void SFE_TPA2016D2::beginConfig()
+// Hold the following writes in the shadow copy, until applyConfig()
+{
+  deferred = 1;
+}
+
+
+unsigned char SFE_TPA2016D2::applyConfig()
+// Send the registers changed since beginConfig() in one transaction,
+// from the first changed register to the last, and stop holding writes
+// Nothing is sent if nothing changed
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
+  unsigned char first, last, x, span, regvalue, result;
 
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_CONTROL_REGISTER,&regvalue))
+  deferred = 0;
+  if (dirty == 0)
+    return 1;
+
+  for (first = 0; !(dirty & (1 << first)); first++);
+  for (last = TPA2016D2_REGISTERS - 1; !(dirty & (1 << last)); last--);
+  span = ((1 << (last + 1)) - 1) & ~((1 << first) - 1);
+
+  // Unchanged registers between them are sent again, so they must be known
+  for (x = first; x <= last; x++)
+    if (!((known | dirty) & (1 << x)))
+      if (!SFE_TPA2016D2::readRegister(x + 1,&regvalue))
+        return 0;
+
+  Wire.beginTransmission(TPA2016D2_ADDR);
+  Wire.write(first + 1);                 // first register, the chip steps through the rest
+  for (x = first; x <= last; x++)
+    Wire.write(shadow[x]);
+  result = Wire.endTransmission();
+
+  if (result == 0)
   {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_CONTROL_REGISTER,((regvalue & B00111111))));
-      return 1;
+    known |= span;
+    dirty = 0;
+    return 1;
   }
+  known &= ~span; // may or may not have been written, keep dirty to retry
   return 0;
 }
 
-unsigned char SFE_TPA2016D2::enableRightSpeaker()
-// Enable the right output channel
+
+unsigned char SFE_TPA2016D2::updateRegister(unsigned char reg, unsigned char mask, unsigned char value)
+// Change the bits in mask of a register to the same bits of value
+// The register is only read if the shadow copy doesn't know it, and only
+// written if it changes. Between beginConfig() and applyConfig(), the
+// change is only made to the shadow copy.
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
+  unsigned char bit = 1 << (reg - 1);
   unsigned char regvalue;
 
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_CONTROL_REGISTER,&regvalue))
+  if (!((known | dirty) & bit))
   {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_CONTROL_REGISTER,((regvalue | B10000000))));
-      return 1;
+    if (!SFE_TPA2016D2::readRegister(reg,&regvalue))
+      return 0;
   }
-  return 0;
+
+  regvalue = (shadow[reg-1] & ~mask) | (value & mask);
+  if (!(dirty & bit) && (regvalue == shadow[reg-1]))
+    return 1; // already set
+
+  if (deferred)
+  {
+    shadow[reg-1] = regvalue;
+    dirty |= bit;
+    return 1;
+  }
+  return SFE_TPA2016D2::writeRegister(reg,regvalue);
+}
+
+
+unsigned char SFE_TPA2016D2::enableSpeakers()
+// Enable both output channels (unmute)
+// Returns 1 if successful, 0 if something failed (I2C error)
+{
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_CONTROL_REGISTER,B11000000,B11000000);
+}
+
+unsigned char SFE_TPA2016D2::disableSpeakers()
+// Disable both output channels (mute)
+// Returns 1 if successful, 0 if something failed (I2C error)
+{
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_CONTROL_REGISTER,B11000000,0);
+}
+
+unsigned char SFE_TPA2016D2::enableRightSpeaker()
+// Enable the right output channel
+// Returns 1 if successful, 0 if something failed (I2C error)
+{
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_CONTROL_REGISTER,B10000000,B10000000);
 }
 
 
@@ -198,15 +325,8 @@ unsigned char SFE_TPA2016D2::disableRightSpeaker()
 // Disable the right output channel
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
-
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_CONTROL_REGISTER,&regvalue))
-  {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_CONTROL_REGISTER,((regvalue & B01111111))));
-      return 1;
-  }
-  return 0;
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_CONTROL_REGISTER,B10000000,0);
 }
 
 
@@ -214,15 +334,8 @@ unsigned char SFE_TPA2016D2::enableLeftSpeaker()
 // Enable the left output channel
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
-
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_CONTROL_REGISTER,&regvalue))
-  {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_CONTROL_REGISTER,((regvalue | B01000000))));
-      return 1;
-  }
-  return 0;
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_CONTROL_REGISTER,B01000000,B01000000);
 }
 
 
@@ -230,15 +343,8 @@ unsigned char SFE_TPA2016D2::disableLeftSpeaker()
 // Disable the left output channel
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
-
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_CONTROL_REGISTER,&regvalue))
-  {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_CONTROL_REGISTER,((regvalue & B10111111))));
-      return 1;
-  }
-  return 0;
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_CONTROL_REGISTER,B01000000,0);
 }
 
 
@@ -246,15 +352,8 @@ unsigned char SFE_TPA2016D2::enableShutdown()
 // Shut down the amplifier (overrides external input)
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
-
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_CONTROL_REGISTER,&regvalue))
-  {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_CONTROL_REGISTER,((regvalue | B00100000))));
-      return 1;
-  }
-  return 0;
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_CONTROL_REGISTER,B00100000,B00100000);
 }
 
 
@@ -262,15 +361,8 @@ unsigned char SFE_TPA2016D2::disableShutdown()
 // Enable the amplifier (external input will override this setting)
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
-
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_CONTROL_REGISTER,&regvalue))
-  {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_CONTROL_REGISTER,((regvalue & B11011111))));
-      return 1;
-  }
-  return 0;
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_CONTROL_REGISTER,B00100000,0);
 }
 
 
@@ -300,15 +392,8 @@ unsigned char SFE_TPA2016D2::enableNoiseGate()
 // Note that the noise gate can only be enabled if the compression ratio is not 1:1
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
-
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_CONTROL_REGISTER,&regvalue))
-  {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_CONTROL_REGISTER,((regvalue | B00000001))));
-      return 1;
-  }
-  return 0;
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_CONTROL_REGISTER,B00000001,B00000001);
 }
 
 
@@ -316,15 +401,8 @@ unsigned char SFE_TPA2016D2::disableNoiseGate()
 // Disable the noise gate feature
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
-
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_CONTROL_REGISTER,&regvalue))
-  {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_CONTROL_REGISTER,((regvalue & B11111110))));
-      return 1;
-  }
-  return 0;
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_CONTROL_REGISTER,B00000001,0);
 }
 
 
@@ -332,10 +410,8 @@ unsigned char SFE_TPA2016D2::writeAttack(unsigned char attack)
 // Write the AGC attack time (0-63, see datasheet for units)
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  if (SFE_TPA2016D2::writeRegister(TPA2016D2_ATTACK_REGISTER,(attack & B00111111)))
-    return 1;
-  else
-    return 0;
+	// Write the whole register
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_ATTACK_REGISTER,B11111111,(attack & B00111111));
 }
 
 
@@ -355,10 +431,8 @@ unsigned char SFE_TPA2016D2::writeRelease(unsigned char release)
 // Write the AGC release time (0-63, see datasheet for units)
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  if (SFE_TPA2016D2::writeRegister(TPA2016D2_RELEASE_REGISTER,(release & B00111111)))
-    return 1;
-  else
-    return 0;
+	// Write the whole register
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_RELEASE_REGISTER,B11111111,(release & B00111111));
 }
 
 
@@ -378,10 +452,8 @@ unsigned char SFE_TPA2016D2::writeHold(unsigned char hold)
 // Write the AGC hold time (0-63, see datasheet for units)
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  if (SFE_TPA2016D2::writeRegister(TPA2016D2_HOLD_REGISTER,(hold & B00111111)))
-    return 1;
-  else
-    return 0;
+	// Write the whole register
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_HOLD_REGISTER,B11111111,(hold & B00111111));
 }
 
 
@@ -401,10 +473,8 @@ unsigned char SFE_TPA2016D2::writeFixedGain(char gain)
 // Write the AGC fixed gain (-28 to +30, see datasheet for units)
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  if (SFE_TPA2016D2::writeRegister(TPA2016D2_GAIN_REGISTER,(gain & B00111111)))
-    return 1;
-  else
-    return 0;
+	// Write the whole register
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_GAIN_REGISTER,B11111111,(gain & B00111111));
 }
 
 
@@ -432,19 +502,11 @@ unsigned char SFE_TPA2016D2::disableLimiter()
 // Set the compression ratio to 1:1 (required) and disable the output limiter
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
-
-	// Read the registers, modify only the bits we need, and write back the modified values
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_AGC2_REGISTER,&regvalue))
+	// Modify only the bits we need in both registers
+  if (SFE_TPA2016D2::updateRegister(TPA2016D2_AGC2_REGISTER,B00000011,0)) // set compression ratio to 0
   {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_AGC2_REGISTER,(regvalue & B11111100))) // set compression ratio to 0
-    {
-      if (SFE_TPA2016D2::readRegister(TPA2016D2_AGC1_REGISTER,&regvalue))
-      {
-        if (SFE_TPA2016D2::writeRegister(TPA2016D2_AGC1_REGISTER,(regvalue | B10000000))) // disable limiter
-          return 1;
-      }
-    }
+    if (SFE_TPA2016D2::updateRegister(TPA2016D2_AGC1_REGISTER,B10000000,B10000000)) // disable limiter
+      return 1;
   }
   return 0;
 }
@@ -454,15 +516,8 @@ unsigned char SFE_TPA2016D2::enableLimiter()
 // Enable the output limiter
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
-
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_AGC1_REGISTER,&regvalue))
-  {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_AGC1_REGISTER,(regvalue & B01111111))) // enable limiter
-      return 1;
-  }
-  return 0;
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_AGC1_REGISTER,B10000000,0);
 }
 
 
@@ -470,15 +525,8 @@ unsigned char SFE_TPA2016D2::writeNoiseGateThreshold(unsigned char noisegatethre
 // Write AGC noise gate threshold (0-3, see datasheet for units)
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
-
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_AGC1_REGISTER,&regvalue))
-  {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_AGC1_REGISTER,((regvalue & B10011111) | ((noisegatethreshold << 5) & B01100000))));
-      return 1;
-  }
-  return 0;
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_AGC1_REGISTER,B01100000,(noisegatethreshold << 5));
 }
 
 
@@ -500,15 +548,8 @@ unsigned char SFE_TPA2016D2::writeOutputLimiterLevel(unsigned char outputlimiter
 // Write AGC output limiter level (0-31, see datasheet for units)
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
-
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_AGC1_REGISTER,&regvalue))
-  {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_AGC1_REGISTER,((regvalue & B11100000) | (outputlimiterlevel & B00011111))));
-      return 1;
-  }
-  return 0;
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_AGC1_REGISTER,B00011111,outputlimiterlevel);
 }
 
 
@@ -530,15 +571,8 @@ unsigned char SFE_TPA2016D2::writeMaxGain(unsigned char maxgain)
 // Write AGC max gain (0-15, see datasheet for units)
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
-
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_AGC2_REGISTER,&regvalue))
-  {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_AGC2_REGISTER,((regvalue & B00001111) | ((maxgain << 4) & B11110000))));
-      return 1;
-  }
-  return 0;
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_AGC2_REGISTER,B11110000,(maxgain << 4));
 }
 
 
@@ -560,15 +594,8 @@ unsigned char SFE_TPA2016D2::writeCompressionRatio(unsigned char compressionrati
 // Write AGC compression ratio (0-3, see datasheet for units)
 // Returns 1 if successful, 0 if something failed (I2C error)
 {
-  unsigned char regvalue;
-
-	// Read the register, modify only the bits we need, and write back the modified value
-  if (SFE_TPA2016D2::readRegister(TPA2016D2_AGC2_REGISTER,&regvalue))
-  {
-    if (SFE_TPA2016D2::writeRegister(TPA2016D2_AGC2_REGISTER,((regvalue & B11111100) | (compressionratio & B00000011))));
-      return 1;
-  }
-  return 0;
+	// Modify only the bits we need
+  return SFE_TPA2016D2::updateRegister(TPA2016D2_AGC2_REGISTER,B00000011,compressionratio);
 }
 
 
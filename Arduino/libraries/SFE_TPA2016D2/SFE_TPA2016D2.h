@@ -32,6 +32,23 @@
 	For information on the data sent to and received from the amplifier,
 	refer to the TPA2016D2 datasheet at:
 	http://www.ti.com/lit/ds/symlink/tpa2016d2.pdf
+
+	The library keeps a copy ("shadow") of registers 1-7. Once a register
+	is known, the enable/disable and bit field functions modify the copy
+	instead of reading the chip first, and nothing is sent if the value
+	doesn't change. Call readConfig() to load the copy from the chip, or
+	resetConfig() right after the amplifier is powered up, when it holds
+	its power-on defaults. (Cutting the amplifier's power resets it, so
+	call resetConfig() again whenever you turn it back on.)
+
+	To change several settings at once, call beginConfig(), then any of
+	the write, enable and disable functions, then applyConfig(). Those
+	calls only change the copy; applyConfig() sends every changed
+	register in one I2C transaction, using the chip's auto-increment.
+
+	Register 1's fault bits are written back as they were last read, so
+	call readFaults() before changing register 1 if a fault must stay
+	latched.
 	
   License:
   We use the "beerware" license for our firmware. You can do
@@ -44,11 +61,15 @@
 
   Revision history:
   version 1.0 2012/07/24 MDG Initial release 
+  version 1.1 shadow register copy, beginConfig()/applyConfig() burst writes
 */
 
 #ifndef SFE_TPA2016D2_h
 #define SFE_TPA2016D2_h
 
+// Number of registers (1-7) kept in the shadow copy
+#define TPA2016D2_REGISTERS 7
+
 class SFE_TPA2016D2
 {
 	public:
@@ -114,8 +135,27 @@ class SFE_TPA2016D2
 		unsigned char writeRegister(unsigned char reg, unsigned char value);
 		unsigned char readRegister(unsigned char reg, unsigned char *value);
 
+		// Load the shadow copy of registers 1-7 from the chip
+		unsigned char readConfig();
+
+		// Set the shadow copy to the power-on defaults (call after power-up)
+		void resetConfig();
+
+		// Hold writes in the shadow copy until applyConfig()
+		void beginConfig();
+
+		// Send the changed registers in one transaction
+		unsigned char applyConfig();
+
 	private:
 
+		// Change the bits in mask of a register, through the shadow copy
+		unsigned char updateRegister(unsigned char reg, unsigned char mask, unsigned char value);
+
+		unsigned char shadow[TPA2016D2_REGISTERS];	// copy of registers 1-7
+		unsigned char known;		// bit (reg-1) set if shadow[reg-1] matches the chip
+		unsigned char dirty;		// bit (reg-1) set if shadow[reg-1] is waiting for applyConfig()
+		unsigned char deferred;	// true between beginConfig() and applyConfig()
 };
 
 // I2C address (7-bit format for Wire library)
@@ -19,6 +19,7 @@
  */
 #include <Sd2Card.h>
 #include <SdSpi.h>
+#include <SdSpiBus.h>
 // debug trace macro
 #define SD_TRACE(m, b)
 // #define SD_TRACE(m, b) Serial.print(m);Serial.println(b);
@@ -181,10 +182,14 @@ void Sd2Card::chipSelectHigh() {
   digitalWrite(m_chipSelectPin, HIGH);
   // insure MISO goes high impedance
   m_spi.send(0XFF);
+  SdSpiBus::release(SPI_BUS_ID_SD);
 }
 //------------------------------------------------------------------------------
 void Sd2Card::chipSelectLow() {
-  m_spi.init(m_sckDivisor);
+  // skip SPI setup if the SD was the last device on the bus
+  if (SdSpiBus::acquire(SPI_BUS_ID_SD, m_sckDivisor)) {
+    m_spi.init(m_sckDivisor);
+  }
   digitalWrite(m_chipSelectPin, LOW);
 }
 //------------------------------------------------------------------------------
@@ -269,6 +274,7 @@ bool Sd2Card::begin(uint8_t chipSelectPin, uint8_t sckDivisor) {
 
   // set SCK rate for initialization commands
   m_sckDivisor = SPI_SCK_INIT_DIVISOR;
+  SdSpiBus::acquire(SPI_BUS_ID_SD, m_sckDivisor);
   m_spi.init(m_sckDivisor);
 
   // must supply min of 74 clock cycles with CS high.
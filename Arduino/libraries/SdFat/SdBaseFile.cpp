@@ -100,6 +100,7 @@ dir_t* SdBaseFile::cacheDirEntry(uint8_t action) {
  * Reasons for failure include no file is open or an I/O error.
  */
 bool SdBaseFile::close() {
+  SdSpiBusLock busLock;
   bool rtn = sync();
   m_type = FAT_FILE_TYPE_CLOSED;
   return rtn;
@@ -116,6 +117,7 @@ bool SdBaseFile::close() {
  * or an I/O error occurred.
  */
 bool SdBaseFile::contiguousRange(uint32_t* bgnBlock, uint32_t* endBlock) {
+  SdSpiBusLock busLock;
   // error if no blocks
   if (m_firstCluster == 0) {
     DBG_FAIL_MACRO;
@@ -164,6 +166,7 @@ bool SdBaseFile::contiguousRange(uint32_t* bgnBlock, uint32_t* endBlock) {
  */
 bool SdBaseFile::createContiguous(SdBaseFile* dirFile,
         const char* path, uint32_t size) {
+  SdSpiBusLock busLock;
   uint32_t count;
   // don't allow zero length file
   if (size == 0) {
@@ -202,6 +205,7 @@ bool SdBaseFile::createContiguous(SdBaseFile* dirFile,
  * the value zero, false, is returned for failure.
  */
 bool SdBaseFile::dirEntry(dir_t* dir) {
+  SdSpiBusLock busLock;
   dir_t* p;
   // make sure fields on SD are correct
   if (!sync()) {
@@ -304,6 +308,7 @@ int16_t SdBaseFile::fgets(char* str, int16_t num, char* delim) {
  * the value zero, false, is returned for failure.
  */
 bool SdBaseFile::getFilename(char* name) {
+  SdSpiBusLock busLock;
   dir_t* p;
   if (!isOpen()) {
     DBG_FAIL_MACRO;
@@ -401,6 +406,7 @@ bool SdBaseFile::make83Name(const char* str, uint8_t* name, const char** ptr) {
  * directory, \a path is invalid or already exists in \a parent.
  */
 bool SdBaseFile::mkdir(SdBaseFile* parent, const char* path, bool pFlag) {
+  SdSpiBusLock busLock;
   uint8_t dname[11];
   SdBaseFile dir1, dir2;
   SdBaseFile* sub = &dir1;
@@ -578,6 +584,7 @@ bool SdBaseFile::mkdir(SdBaseFile* parent, const uint8_t dname[11]) {
  * or can't be opened in the access mode specified by oflag.
  */
 bool SdBaseFile::open(SdBaseFile* dirFile, const char* path, uint8_t oflag) {
+  SdSpiBusLock busLock;
   uint8_t dname[11];
   SdBaseFile dir1, dir2;
   SdBaseFile *parent = dirFile;
@@ -745,6 +752,7 @@ bool SdBaseFile::open(SdBaseFile* dirFile,
  * \return true for success or false for failure.
  */
 bool SdBaseFile::open(SdBaseFile* dirFile, uint16_t index, uint8_t oflag) {
+  SdSpiBusLock busLock;
   dir_t* p;
 
   m_vol = dirFile->m_vol;
@@ -847,6 +855,7 @@ bool SdBaseFile::openCachedEntry(uint8_t dirIndex, uint8_t oflag) {
  * \return true for success or false for failure.
  */
 bool SdBaseFile::openNext(SdBaseFile* dirFile, uint8_t oflag) {
+  SdSpiBusLock busLock;
   dir_t* p;
   uint8_t index;
 
@@ -897,6 +906,7 @@ bool SdBaseFile::openNext(SdBaseFile* dirFile, uint8_t oflag) {
  * the value zero, false, is returned for failure.
  */
 bool SdBaseFile::openParent(SdBaseFile* dir) {
+  SdSpiBusLock busLock;
   dir_t entry;
   dir_t* p;
   SdBaseFile file;
@@ -981,6 +991,7 @@ bool SdBaseFile::openParent(SdBaseFile* dir) {
  * not been initialized or it a FAT12 volume.
  */
 bool SdBaseFile::openRoot(SdVolume* vol) {
+  SdSpiBusLock busLock;
   // error if file is already open
   if (isOpen()) {
     DBG_FAIL_MACRO;
@@ -1055,6 +1066,7 @@ int16_t SdBaseFile::read() {
  * or an I/O error occurred.
  */
 int SdBaseFile::read(void* buf, size_t nbyte) {
+  SdSpiBusLock busLock;
   uint8_t blockOfCluster;
   uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
   uint16_t offset;
@@ -1165,6 +1177,7 @@ int SdBaseFile::read(void* buf, size_t nbyte) {
  * a directory file or an I/O error occurred.
  */
 int8_t SdBaseFile::readDir(dir_t* dir) {
+  SdSpiBusLock busLock;
   int16_t n;
   // if not a directory file or miss-positioned return an error
   if (!isDir() || (0X1F & m_curPosition)) return -1;
@@ -1222,6 +1235,7 @@ dir_t* SdBaseFile::readDirCache() {
  * or an I/O error occurred.
  */
 bool SdBaseFile::remove() {
+  SdSpiBusLock busLock;
   dir_t* d;
   // free any clusters - will fail if read-only or directory
   if (!truncate(0)) {
@@ -1266,6 +1280,7 @@ bool SdBaseFile::remove() {
  * or an I/O error occurred.
  */
 bool SdBaseFile::remove(SdBaseFile* dirFile, const char* path) {
+  SdSpiBusLock busLock;
   SdBaseFile file;
   if (!file.open(dirFile, path, O_WRITE)) {
     DBG_FAIL_MACRO;
@@ -1288,6 +1303,7 @@ bool SdBaseFile::remove(SdBaseFile* dirFile, const char* path) {
  * file, newPath is invalid or already exists, or an I/O error occurs.
  */
 bool SdBaseFile::rename(SdBaseFile* dirFile, const char* newPath) {
+  SdSpiBusLock busLock;
   dir_t entry;
   uint32_t dirCluster = 0;
   SdBaseFile file;
@@ -1403,6 +1419,7 @@ bool SdBaseFile::rename(SdBaseFile* dirFile, const char* newPath) {
  * directory, is not empty, or an I/O error occurred.
  */
 bool SdBaseFile::rmdir() {
+  SdSpiBusLock busLock;
   // must be open subdirectory
   if (!isSubDir()) {
     DBG_FAIL_MACRO;
@@ -1452,6 +1469,7 @@ bool SdBaseFile::rmdir() {
  * the value zero, false, is returned for failure.
  */
 bool SdBaseFile::rmRfStar() {
+  SdSpiBusLock busLock;
   uint16_t index;
   SdBaseFile f;
   rewind();
@@ -1533,6 +1551,7 @@ SdBaseFile::SdBaseFile(const char* path, uint8_t oflag) {
  * the value zero, false, is returned for failure.
  */
 bool SdBaseFile::seekSet(uint32_t pos) {
+  SdSpiBusLock busLock;
   uint32_t nCur;
   uint32_t nNew;
   // error if file not open or seek past end of file
@@ -1613,6 +1632,7 @@ void SdBaseFile::setpos(FatPos_t* pos) {
  * opened or an I/O error.
  */
 bool SdBaseFile::sync() {
+  SdSpiBusLock busLock;
   // only allow open files and directories
   if (!isOpen()) {
     DBG_FAIL_MACRO;
@@ -1659,6 +1679,7 @@ bool SdBaseFile::sync() {
  * the value zero, false, is returned for failure.
  */
 bool SdBaseFile::timestamp(SdBaseFile* file) {
+  SdSpiBusLock busLock;
   dir_t* d;
   dir_t dir;
 
@@ -1727,6 +1748,7 @@ bool SdBaseFile::timestamp(SdBaseFile* file) {
  */
 bool SdBaseFile::timestamp(uint8_t flags, uint16_t year, uint8_t month,
          uint8_t day, uint8_t hour, uint8_t minute, uint8_t second) {
+  SdSpiBusLock busLock;
   uint16_t dirDate;
   uint16_t dirTime;
   dir_t* d;
@@ -1787,6 +1809,7 @@ bool SdBaseFile::timestamp(uint8_t flags, uint16_t year, uint8_t month,
  * \a length is greater than the current file size or an I/O error occurs.
  */
 bool SdBaseFile::truncate(uint32_t length) {
+  SdSpiBusLock busLock;
   uint32_t newPos;
   // error if not a normal file or read-only
   if (!isFile() || !(m_flags & O_WRITE)) {
@@ -1867,6 +1890,7 @@ bool SdBaseFile::truncate(uint32_t length) {
  *
  */
 int SdBaseFile::write(const void* buf, size_t nbyte) {
+  SdSpiBusLock busLock;
   // convert void* to uint8_t*  -  must be before goto statements
   const uint8_t* src = reinterpret_cast<const uint8_t*>(buf);
   cache_t* pc;
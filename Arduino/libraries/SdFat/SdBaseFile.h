@@ -50,6 +50,7 @@
 #include <Arduino.h>
 #include <SdFatConfig.h>
 #include <SdVolume.h>
+#include <SdSpiBus.h>
 //------------------------------------------------------------------------------
 /**
  * \struct FatPos_t
@@ -64,6 +64,7 @@ void SdBaseFile::ls(Print* pr, uint8_t flags, uint8_t indent) {
 // saves 32 bytes on stack for ls recursion
 // return 0 - EOF, 1 - normal file, or 2 - directory
 int8_t SdBaseFile::lsPrintNext(Print *pr, uint8_t flags, uint8_t indent) {
+  SdSpiBusLock busLock;
   dir_t dir;
   uint8_t w = 0;
 
@@ -38,6 +38,7 @@ Print* SdFat::m_stdOut = &MiniSerial;
  * the value zero, false, is returned for failure.
  */
 bool SdFat::begin(uint8_t chipSelectPin, uint8_t sckDivisor) {
+  SdSpiBusLock busLock;
   return m_card.begin(chipSelectPin, sckDivisor)
          && m_vol.init(&m_card) && chdir(1);
 }
@@ -36,6 +36,7 @@
 #endif  // ARDUINO < 100
 //------------------------------------------------------------------------------
 #include <SdFile.h>
+#include <SdLogger.h>
 #include <SdStream.h>
 #include <ArduinoStream.h>
 #include <MinimumSerial.h>
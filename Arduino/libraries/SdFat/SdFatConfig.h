@@ -112,6 +112,31 @@
  */
 #define ENDL_CALLS_FLUSH 0
 //------------------------------------------------------------------------------
+/**
+ * Set USE_SPI_BUS_ARBITRATION nonzero to share the SPI bus with other
+ * drivers through the SdSpiBus class.
+ *
+ * The SD then only reprograms the SPI controller when another device, or
+ * another clock rate, used the bus last.  Drivers that access the bus from
+ * an interrupt, like a VS1053 refill ISR, can defer their work until
+ * the SD has deselected.
+ */
+#define USE_SPI_BUS_ARBITRATION 1
+//------------------------------------------------------------------------------
+/**
+ * Number of preempt handlers SdSpiBus holds, one for each driver that may
+ * leave a transaction open between bursts.  SdLogger, the SFEMP3Shield
+ * raw refill and its recorder use one each.
+ */
+#define SPI_BUS_PREEMPT_MAX 3
+//------------------------------------------------------------------------------
+/**
+ * Number of handlers SdSpiBus holds deferred at once, one for each interrupt
+ * routine that may defer().  The SFEMP3Shield refill and MIDI sequencer use
+ * one each.
+ */
+#define SPI_BUS_DEFER_MAX 2
+//------------------------------------------------------------------------------
 /**
  * Allow FAT12 volumes if FAT12_SUPPORT is nonzero.
  * FAT12 has not been well tested.
@@ -26,6 +26,12 @@ extern "C" char* sbrk(int incr);
 #else  // __ARM__
 extern char *__brkval;
 extern char __bss_end;
+// avr-libc's list of chunks returned by free() below the top of the heap
+struct __freelist {
+  size_t sz;
+  struct __freelist *nx;
+};
+extern struct __freelist *__flp;
 #endif  // __arm__
 //------------------------------------------------------------------------------
 /** Amount of free RAM
@@ -40,6 +46,29 @@ int SdFatUtil::FreeRam() {
 #endif  // __arm__
 }
 //------------------------------------------------------------------------------
+/** Amount of RAM in the heap's free list.
+ *
+ * These are holes left by free() below the top of the heap, and are not
+ * counted by FreeRam().  Many small holes, with a small \a largest, mean
+ * a fragmented heap.
+ *
+ * \param[out] largest Size of the largest hole, if not null.
+ *
+ * \return The number of free bytes in holes.  Always zero on ARM.
+ */
+int SdFatUtil::FreeListRam(int* largest) {
+  int total = 0;
+  int big = 0;
+#ifndef __arm__
+  for (struct __freelist* fp = __flp; fp; fp = fp->nx) {
+    total += fp->sz;
+    if (static_cast<int>(fp->sz) > big) big = fp->sz;
+  }
+#endif  // __arm__
+  if (largest) *largest = big;
+  return total;
+}
+//------------------------------------------------------------------------------
 /** %Print a string in flash memory.
  *
  * \param[in] pr Print object for output.
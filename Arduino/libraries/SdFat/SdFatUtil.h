@@ -31,6 +31,7 @@
 
 namespace SdFatUtil {
   int FreeRam();
+  int FreeListRam(int* largest = 0);
   void print_P(Print* pr, PGM_P str);
   void println_P(Print* pr, PGM_P str);
   void SerialPrint_P(PGM_P str);
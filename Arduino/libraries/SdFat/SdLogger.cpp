@@ -0,0 +1,270 @@
+/* Block aligned text logger for SdFat
+ * Copyright (C) the SFEMP3Shield contributors
+ *
+ * This file is distributed with the Arduino SdFat Library, as modified for
+ * the LilyPad MP3 Player and the SFEMP3Shield library, under the same license.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino SdFat Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <SdFat.h>
+//------------------------------------------------------------------------------
+// logger with a multiple block write open
+SdLogger* SdLogger::m_streamer = 0;
+//------------------------------------------------------------------------------
+// true if a block read from the log holds text, false if it is erased
+static bool blockWritten(const uint8_t* buf) {
+  return buf[0] != 0 && buf[0] != 0XFF;
+}
+//------------------------------------------------------------------------------
+/** Open a log, creating it if it does not exist.
+ *
+ * A new log is created contiguous, of \a size rounded up to a whole
+ * block, and erased.  An existing log, left open by a reset or power
+ * loss, is appended after its tail marker.
+ *
+ * \param[in] dirFile An open directory containing the log.
+ *
+ * \param[in] path A path with a valid 8.3 DOS name for the log.
+ *
+ * \param[in] size Bytes to preallocate for a new log.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.  Reasons for failure
+ * include no contiguous free space, a card that can't erase the file or
+ * an existing log that was closed or is full.
+ */
+bool SdLogger::begin(SdBaseFile* dirFile, const char* path, uint32_t size) {
+  SdSpiBusLock busLock;
+  Sd2Card* card;
+  uint32_t lastBlock;
+  uint32_t lo;
+  uint32_t hi;
+  uint8_t* tail;
+
+  if (isOpen()) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  m_block = 0;
+  m_fill = 0;
+  m_dirty = false;
+  m_dropped = 0;
+  m_maxWriteMicros = 0;
+  m_streamBlock = 0;
+
+  if (m_file.open(dirFile, path, O_RDWR)) {
+    if (!m_file.contiguousRange(&m_firstBlock, &lastBlock)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    m_blockCount = m_file.fileSize() >> 9;
+    card = m_file.volume()->sdCard();
+
+    // written blocks precede the erased ones, find the first erased
+    lo = 0;
+    hi = m_blockCount;
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo)/2;
+      if (!card->readBlock(m_firstBlock + mid, m_buf)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      if (blockWritten(m_buf)) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    // resume filling the last written block, if it has a tail marker
+    if (lo) {
+      if (!card->readBlock(m_firstBlock + lo - 1, m_buf)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      tail = reinterpret_cast<uint8_t*>(memchr(m_buf, 0, 512));
+      if (tail) {
+        m_block = lo - 1;
+        m_fill = tail - m_buf;
+      } else {
+        m_block = lo;
+      }
+    }
+    if (m_block >= m_blockCount) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  } else {
+    size = (size + 511) & ~511UL;
+    if (!m_file.createContiguous(dirFile, path, size)
+      || !m_file.contiguousRange(&m_firstBlock, &lastBlock)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    m_blockCount = size >> 9;
+    // erased blocks mark the unwritten end of the log
+    if (!m_file.volume()->sdCard()->erase(m_firstBlock,
+                                          m_firstBlock + m_blockCount - 1)) {
+      m_file.remove();
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+  memset(m_buf + m_fill, 0, 512 - m_fill);
+  return true;
+
+ fail:
+  m_file.close();
+  return false;
+}
+//------------------------------------------------------------------------------
+/** Write the partial block, then set the file's size to the size of the
+ * log, freeing the unused clusters, and close it.
+ *
+ * A closed log can't be appended by begin().
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+bool SdLogger::close() {
+  if (!isOpen()) return true;
+  bool rtn = sync();
+  if (m_streamer == this) endStream();
+  rtn = m_file.truncate(size()) && rtn;
+  return m_file.close() && rtn;
+}
+//------------------------------------------------------------------------------
+// End the multiple block write left open by a logger.  Called by the
+// outermost SdSpiBus::lock() or SdSpiBus::preempt().
+void SdLogger::endStream() {
+  SdLogger* logger = m_streamer;
+  if (!logger) return;
+  m_streamer = 0;
+  logger->m_file.volume()->sdCard()->writeStop();
+}
+//------------------------------------------------------------------------------
+// Write the full buffer and start the next block.
+bool SdLogger::nextBlock() {
+  if (!writeBlock()) return false;
+  m_block++;
+  m_fill = 0;
+  memset(m_buf, 0, 512);
+  return true;
+}
+//------------------------------------------------------------------------------
+/** Write the partial block to the card.
+ *
+ * The text written so far is then kept through a reset or power loss,
+ * the directory entry is not changed.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+bool SdLogger::sync() {
+  if (!isOpen()) return false;
+  return m_dirty ? writeBlock() : true;
+}
+//------------------------------------------------------------------------------
+/** Append a byte to the log.  Required by the Arduino Print class.
+ *
+ * \param[in] b The byte to be written.
+ *
+ * \return 1 for success and 0 for failure.
+ */
+size_t SdLogger::write(uint8_t b) {
+  return write(&b, 1);
+}
+//------------------------------------------------------------------------------
+/** Append data to the log.
+ *
+ * Data is copied to the block buffer.  Only a full block is written to
+ * the card, the rest waits for more data or sync().
+ *
+ * \param[in] buf Pointer to the location of the data to be written.
+ *
+ * \param[in] n Number of bytes to write.
+ *
+ * \return The number of bytes written.  Bytes that don't fit in the
+ * preallocated file, or can't be written, are counted by dropped() and
+ * set the write error.
+ */
+size_t SdLogger::write(const uint8_t* buf, size_t n) {
+  size_t done = 0;
+  if (!isOpen()) goto fail;
+  while (done < n) {
+    // retry a block that failed to write
+    if (m_fill == 512 && !nextBlock()) goto fail;
+    if (m_block >= m_blockCount) goto fail;
+    size_t k = n - done < 512U - m_fill ? n - done : 512U - m_fill;
+    memcpy(m_buf + m_fill, buf + done, k);
+    m_fill += k;
+    m_dirty = true;
+    done += k;
+    if (m_fill == 512 && !nextBlock()) {
+      // keep the block, it is retried by the next write
+      done = n;
+      goto fail;
+    }
+  }
+  return done;
+
+ fail:
+  m_dropped += n - done;
+  setWriteError();
+  return done;
+}
+//------------------------------------------------------------------------------
+// Send m_buf as block m_block of the log.  The multiple block write is
+// only restarted when the block is not the next of the open write, such
+// as after sync() wrote the same block partially, or another driver used
+// the card.
+bool SdLogger::writeBlock() {
+  Sd2Card* card = m_file.volume()->sdCard();
+  uint32_t block = m_firstBlock + m_block;
+  uint32_t t = micros();
+
+  // keep our own write open through lock(), and end any other
+  SdSpiBus::removePreempt(endStream);
+  SdSpiBus::lock();
+  if (m_streamer != this || block != m_streamBlock) {
+    endStream();
+    // the file was erased by begin(), don't pre-erase
+    if (!card->writeStart(block, 1)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    m_streamer = this;
+  }
+  if (!card->writeData(m_buf)) {
+    // leave the card out of the failed write
+    endStream();
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  m_streamBlock = block + 1;
+  m_dirty = false;
+  // end the write now rather than from an interrupt routine's lock(),
+  // which would wait on the card there.  Without a preempt handler nothing
+  // would end the write before the card is used again.
+  if (SdSpiBus::irqUser() || !SdSpiBus::addPreempt(endStream)) endStream();
+  SdSpiBus::unlock();
+
+  t = micros() - t;
+  if (t > m_maxWriteMicros) m_maxWriteMicros = t;
+  return true;
+
+ fail:
+  SdSpiBus::unlock();
+  return false;
+}
@@ -0,0 +1,91 @@
+/* Block aligned text logger for SdFat
+ * Copyright (C) the SFEMP3Shield contributors
+ *
+ * This file is distributed with the Arduino SdFat Library, as modified for
+ * the LilyPad MP3 Player and the SFEMP3Shield library, under the same license.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino SdFat Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+/**
+ * \file
+ * \brief SdLogger class
+ */
+#ifndef SdLogger_h
+#define SdLogger_h
+#include <SdBaseFile.h>
+//------------------------------------------------------------------------------
+/**
+ * \class SdLogger
+ * \brief Block aligned text log, appended to a preallocated contiguous file.
+ *
+ * Text printed to the log is collected in a 512 byte buffer.  Each full
+ * block is written straight to the card, bypassing the FAT and the volume
+ * cache, as the next block of one multiple block write.  The write is left
+ * open between blocks and is ended by the SdSpiBus preempt handler as any
+ * other file operation, or a raw read, needs the card.  While a driver uses
+ * the card from an interrupt, SdSpiBus::irqUser(), such as an MP3 refill,
+ * the write is ended after each block instead, so the interrupt never
+ * waits on it.
+ *
+ * The file is created at its full size and erased, so the unwritten end
+ * of the log reads as 0X00 or 0XFF.  sync() writes the partial block with
+ * the rest of the block filled by zero bytes.  The first zero byte is the
+ * tail marker, a reader stops there.  The directory entry is only set to
+ * the true size by close().  After a reset or power loss, begin() on the
+ * same file finds the tail and appends after it.
+ *
+ * The SdSpiBus lock is held for each block, an MP3 refill arriving
+ * meanwhile is deferred until the block is sent.
+ */
+class SdLogger : public Print {
+ public:
+  SdLogger() : m_blockCount(0) {}
+  bool begin(SdBaseFile* dirFile, const char* path, uint32_t size);
+  bool close();
+  /** \return Bytes lost since begin(), as the log was full or a block
+   * failed to write.
+   */
+  uint32_t dropped() const {return m_dropped;}
+  /** \return true if the log is open. */
+  bool isOpen() const {return m_file.isOpen();}
+  /** \return The longest time in microseconds to write a block, including
+   * any wait for the card to program the previous block.
+   */
+  uint32_t maxWriteMicros() const {return m_maxWriteMicros;}
+  /** \return Size of the log in bytes, up to the tail marker. */
+  uint32_t size() const {return 512UL*m_block + m_fill;}
+  bool sync();
+  using Print::write;
+  size_t write(uint8_t b);
+  size_t write(const uint8_t* buf, size_t n);
+
+ private:
+  bool nextBlock();
+  bool writeBlock();
+  static void endStream();
+  static SdLogger* m_streamer;  // logger with a multiple block write open
+
+  SdBaseFile m_file;
+  uint32_t m_firstBlock;        // first block of the contiguous file
+  uint32_t m_blockCount;        // blocks preallocated
+  uint32_t m_block;             // index of the block being filled
+  uint32_t m_streamBlock;       // next block of the open write
+  uint32_t m_dropped;
+  uint32_t m_maxWriteMicros;
+  uint16_t m_fill;              // bytes in m_buf
+  bool m_dirty;                 // m_buf changed since written
+  uint8_t m_buf[512];
+};
+#endif  // SdLogger_h
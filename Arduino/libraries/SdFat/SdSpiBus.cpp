@@ -0,0 +1,204 @@
+/* SPI bus arbitration for SdFat
+ * Copyright (C) the SFEMP3Shield contributors
+ *
+ * This file is distributed with the Arduino SdFat Library, as modified for
+ * the LilyPad MP3 Player and the SFEMP3Shield library, under the same license.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino SdFat Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <SdSpiBus.h>
+#if USE_SPI_BUS_ARBITRATION
+//------------------------------------------------------------------------------
+volatile uint8_t SdSpiBus::m_owner = SPI_BUS_ID_NONE;
+volatile uint8_t SdSpiBus::m_lockDepth = 0;
+volatile uint8_t SdSpiBus::m_irqUsers = 0;
+uint8_t SdSpiBus::m_lastId = SPI_BUS_ID_NONE;
+uint16_t SdSpiBus::m_lastConfig = 0;
+void (* volatile SdSpiBus::m_deferred[SPI_BUS_DEFER_MAX])();
+void (*SdSpiBus::m_preempt[SPI_BUS_PREEMPT_MAX])();
+volatile uint32_t SdSpiBus::m_deferMicros = 0;
+volatile uint32_t SdSpiBus::m_maxDeferMicros = 0;
+volatile uint16_t SdSpiBus::m_deferCount = 0;
+//------------------------------------------------------------------------------
+#ifdef __AVR__
+#define SPI_BUS_ATOMIC_BEGIN uint8_t sreg = SREG; cli()
+#define SPI_BUS_ATOMIC_END SREG = sreg
+#else  // __AVR__
+#define SPI_BUS_ATOMIC_BEGIN noInterrupts()
+#define SPI_BUS_ATOMIC_END interrupts()
+#endif  // __AVR__
+//------------------------------------------------------------------------------
+/** Take ownership of the bus.
+ *
+ * \param[in] id Device id of the caller.
+ * \param[in] config Opaque SPI settings of the caller, such as the
+ * clock divisor.
+ *
+ * \return true if the caller must reprogram the SPI controller, false if
+ * the controller is still set up for this device and configuration.
+ */
+bool SdSpiBus::acquire(uint8_t id, uint16_t config) {
+  m_owner = id;
+  if (m_lastId == id && m_lastConfig == config) return false;
+  m_lastId = id;
+  m_lastConfig = config;
+  return true;
+}
+//------------------------------------------------------------------------------
+/** Add a handler to be called by the outermost lock() and preempt().
+ *
+ * Adding a handler that was already added does nothing.
+ *
+ * \param[in] handler Function ending the caller's open transaction.
+ *
+ * \return true if the handler was added, false if SPI_BUS_PREEMPT_MAX
+ * handlers are already held.  The caller must then not leave its
+ * transaction open.
+ */
+bool SdSpiBus::addPreempt(void (*handler)()) {
+  uint8_t free = SPI_BUS_PREEMPT_MAX;
+  bool rtn = true;
+  SPI_BUS_ATOMIC_BEGIN;
+  for (uint8_t i = 0; i < SPI_BUS_PREEMPT_MAX; i++) {
+    if (m_preempt[i] == handler) goto done;
+    if (!m_preempt[i] && free == SPI_BUS_PREEMPT_MAX) free = i;
+  }
+  if (free == SPI_BUS_PREEMPT_MAX) {
+    rtn = false;
+  } else {
+    m_preempt[free] = handler;
+  }
+
+ done:
+  SPI_BUS_ATOMIC_END;
+  return rtn;
+}
+//------------------------------------------------------------------------------
+/** Reset the deferral statistics. */
+void SdSpiBus::clearStats() {
+  SPI_BUS_ATOMIC_BEGIN;
+  m_deferCount = 0;
+  m_maxDeferMicros = 0;
+  SPI_BUS_ATOMIC_END;
+}
+//------------------------------------------------------------------------------
+/** Run a handler when the bus is released.
+ *
+ * Deferring a handler that is already pending does nothing.  Each other
+ * handler takes a slot of its own, a handler is dropped only if all
+ * SPI_BUS_DEFER_MAX slots are pending.  The wait is timed from the first
+ * call that finds no handler pending.
+ *
+ * \param[in] handler Function to be called by release() or unlock().
+ */
+void SdSpiBus::defer(void (*handler)()) {
+  uint8_t free = SPI_BUS_DEFER_MAX;
+  bool idle = true;
+  SPI_BUS_ATOMIC_BEGIN;
+  m_deferCount++;
+  for (uint8_t i = 0; i < SPI_BUS_DEFER_MAX; i++) {
+    if (m_deferred[i] == handler) goto done;
+    if (m_deferred[i]) {
+      idle = false;
+    } else if (free == SPI_BUS_DEFER_MAX) {
+      free = i;
+    }
+  }
+  if (free != SPI_BUS_DEFER_MAX) {
+    if (idle) m_deferMicros = micros();
+    m_deferred[free] = handler;
+  }
+
+ done:
+  SPI_BUS_ATOMIC_END;
+}
+//------------------------------------------------------------------------------
+// Call each deferred handler, in the order of their slots, while the bus
+// is idle.
+void SdSpiBus::drain() {
+  for (uint8_t i = 0; i < SPI_BUS_DEFER_MAX; i++) {
+    void (*handler)();
+    uint32_t wait;
+    SPI_BUS_ATOMIC_BEGIN;
+    handler = busy() ? 0 : m_deferred[i];
+    if (handler) {
+      m_deferred[i] = 0;
+      wait = micros() - m_deferMicros;
+      if (wait > m_maxDeferMicros) m_maxDeferMicros = wait;
+    }
+    SPI_BUS_ATOMIC_END;
+    if (handler) handler();
+  }
+}
+//------------------------------------------------------------------------------
+/** End every transaction left open, by calling each preempt handler. */
+void SdSpiBus::preempt() {
+  for (uint8_t i = 0; i < SPI_BUS_PREEMPT_MAX; i++) {
+    void (*handler)();
+    SPI_BUS_ATOMIC_BEGIN;
+    handler = m_preempt[i];
+    SPI_BUS_ATOMIC_END;
+    if (handler) handler();
+  }
+}
+//------------------------------------------------------------------------------
+/** Give up ownership of the bus and run any deferred handler.
+ *
+ * Releasing a bus that is not held by \a id is ignored, so a driver may
+ * deselect more than once.  The deferred handler waits for unlock() if
+ * a file operation is in progress.
+ *
+ * \param[in] id Device id of the caller.
+ */
+void SdSpiBus::release(uint8_t id) {
+  if (m_owner != id) return;
+  m_owner = SPI_BUS_ID_NONE;
+  drain();
+}
+//------------------------------------------------------------------------------
+/** Remove a handler added by addPreempt().
+ *
+ * \param[in] handler Function to be removed.
+ */
+void SdSpiBus::removePreempt(void (*handler)()) {
+  SPI_BUS_ATOMIC_BEGIN;
+  for (uint8_t i = 0; i < SPI_BUS_PREEMPT_MAX; i++) {
+    if (m_preempt[i] == handler) m_preempt[i] = 0;
+  }
+  SPI_BUS_ATOMIC_END;
+}
+//------------------------------------------------------------------------------
+/** Mark a device as using the bus from an interrupt routine, or not.
+ *
+ * \param[in] id Device id of the caller, less than eight.
+ * \param[in] active true while the device's interrupt is attached.
+ */
+void SdSpiBus::setIrqUser(uint8_t id, bool active) {
+  SPI_BUS_ATOMIC_BEGIN;
+  if (active) {
+    m_irqUsers |= 1 << id;
+  } else {
+    m_irqUsers &= ~(1 << id);
+  }
+  SPI_BUS_ATOMIC_END;
+}
+//------------------------------------------------------------------------------
+/** End a file operation started by lock() and run any deferred handler
+ * once the outermost lock is released.
+ */
+void SdSpiBus::unlock() {
+  if (m_lockDepth && --m_lockDepth == 0) drain();
+}
+#endif  // USE_SPI_BUS_ARBITRATION
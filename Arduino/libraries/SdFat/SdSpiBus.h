@@ -0,0 +1,152 @@
+/* SPI bus arbitration for SdFat
+ * Copyright (C) the SFEMP3Shield contributors
+ *
+ * This file is distributed with the Arduino SdFat Library, as modified for
+ * the LilyPad MP3 Player and the SFEMP3Shield library, under the same license.
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino SdFat Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+ /**
+ * \file
+ * \brief SdSpiBus class for sharing the SPI bus with other devices
+ */
+#ifndef SdSpiBus_h
+#define SdSpiBus_h
+#include <Arduino.h>
+#include <SdFatConfig.h>
+//------------------------------------------------------------------------------
+/** Bus owner id when no device is selected. */
+uint8_t const SPI_BUS_ID_NONE = 0;
+/** Bus owner id used by Sd2Card. Other drivers must use a different id. */
+uint8_t const SPI_BUS_ID_SD = 1;
+//------------------------------------------------------------------------------
+/**
+ * \class SdSpiBus
+ * \brief Arbitration for an SPI bus shared by several devices.
+ *
+ * Each driver calls acquire() before it asserts its chip select and
+ * release() after it deasserts it.  acquire() remembers the device id and
+ * an opaque configuration word, such as a clock divisor, of the last
+ * device to use the bus.  The driver only needs to reprogram the SPI
+ * controller when acquire() returns true.
+ *
+ * SdVolume holds the lock while it reads or writes back a cache block, so
+ * a deferred handler never finds the cache half updated.  SdFat::begin(),
+ * the FAT operations of SdVolume and each file operation of SdBaseFile
+ * hold it throughout, since the volume cache must not change between the
+ * SD transactions of one operation.  An application may also hold the
+ * lock across several calls.
+ *
+ * An interrupt routine that finds the bus busy() can defer() a handler.
+ * Each handler deferred is called, once, as soon as the bus is released
+ * and no file operation is in progress.  Up to SPI_BUS_DEFER_MAX different
+ * handlers are held, deferring one does not drop another.  The longest
+ * time a handler waited is kept by maxDeferMicros().
+ *
+ * A driver that leaves a device in the middle of a transaction between
+ * bursts, such as an SD multiple block read, must addPreempt() a handler
+ * before it opens the transaction.  The outermost lock() calls every
+ * handler so any open transaction is ended before the file operation uses
+ * the card.  A handler may stay added, it must do nothing when its driver
+ * has no transaction open.  A driver opening a transaction without lock(),
+ * such as from an interrupt, first calls preempt() to end the others.
+ *
+ * A driver that uses the card from an interrupt routine marks itself by
+ * setIrqUser() while its interrupt is attached.  A driver holding a
+ * transaction open between calls, such as SdLogger's multiple block
+ * write, ends it itself while irqUser() is true, rather than leave it to
+ * a preempt handler run, and waiting on the card, in that interrupt.
+ */
+class SdSpiBus {
+ public:
+#if USE_SPI_BUS_ARBITRATION
+  static bool acquire(uint8_t id, uint16_t config);
+  static void release(uint8_t id);
+  static void defer(void (*handler)());
+  static bool addPreempt(void (*handler)());
+  /** Block deferred handlers until the matching unlock(). */
+  static void lock() {
+    if (!m_lockDepth++) preempt();
+  }
+  static void preempt();
+  static void removePreempt(void (*handler)());
+  static void setIrqUser(uint8_t id, bool active);
+  static void unlock();
+  /** \return true if a device holds the bus or a file operation is
+   * in progress.
+   */
+  static bool busy() {
+    return m_owner != SPI_BUS_ID_NONE || m_lockDepth != 0;
+  }
+  /** Force reconfiguration by the next device to acquire the bus.
+   *
+   * Call this after the SPI controller has been programmed without
+   * the bus manager, for example by another SPI library.
+   */
+  static void invalidate() {m_lastId = SPI_BUS_ID_NONE;}
+  /** \return the id of the device holding the bus. */
+  static uint8_t owner() {return m_owner;}
+  /** \return true if any device uses the bus from an interrupt routine. */
+  static bool irqUser() {return m_irqUsers != 0;}
+  /** \return number of calls to defer() since clearStats(). */
+  static uint16_t deferCount() {return m_deferCount;}
+  /** \return longest time in microseconds from defer() until the
+   * handler ran, since clearStats().
+   */
+  static uint32_t maxDeferMicros() {return m_maxDeferMicros;}
+  static void clearStats();
+
+ private:
+  static void drain();
+  static volatile uint8_t m_owner;
+  static volatile uint8_t m_lockDepth;
+  static volatile uint8_t m_irqUsers;
+  static uint8_t m_lastId;
+  static uint16_t m_lastConfig;
+  static void (* volatile m_deferred[SPI_BUS_DEFER_MAX])();
+  static void (*m_preempt[SPI_BUS_PREEMPT_MAX])();
+  static volatile uint32_t m_deferMicros;
+  static volatile uint32_t m_maxDeferMicros;
+  static volatile uint16_t m_deferCount;
+#else  // USE_SPI_BUS_ARBITRATION
+  static bool acquire(uint8_t id, uint16_t config) {return true;}
+  static void release(uint8_t id) {}
+  static void defer(void (*handler)()) {}
+  static void lock() {}
+  static bool addPreempt(void (*handler)()) {return false;}
+  static void preempt() {}
+  static void removePreempt(void (*handler)()) {}
+  static void setIrqUser(uint8_t id, bool active) {}
+  static void unlock() {}
+  static bool busy() {return false;}
+  static void invalidate() {}
+  static uint8_t owner() {return SPI_BUS_ID_NONE;}
+  static bool irqUser() {return false;}
+  static uint16_t deferCount() {return 0;}
+  static uint32_t maxDeferMicros() {return 0;}
+  static void clearStats() {}
+#endif  // USE_SPI_BUS_ARBITRATION
+};
+//------------------------------------------------------------------------------
+/**
+ * \class SdSpiBusLock
+ * \brief Holds the SdSpiBus lock for the lifetime of the object.
+ */
+class SdSpiBusLock {
+ public:
+  SdSpiBusLock() {SdSpiBus::lock();}
+  ~SdSpiBusLock() {SdSpiBus::unlock();}
+};
+#endif  // SdSpiBus_h
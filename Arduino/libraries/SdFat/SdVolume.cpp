@@ -36,6 +36,7 @@ Sd2Card* SdVolume::m_sdCard;            // pointer to SD card object
 //------------------------------------------------------------------------------
 // find a contiguous group of clusters
 bool SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
+  SdSpiBusLock busLock;
   // start of group
   uint32_t bgnCluster;
   // end of group
@@ -129,6 +130,8 @@ cache_t* SdVolume::cacheFetch(uint32_t blockNumber, uint8_t options) {
 }
 //------------------------------------------------------------------------------
 cache_t* SdVolume::cacheFetchData(uint32_t blockNumber, uint8_t options) {
+  // no deferred handler may use the cache until the block number is set
+  SdSpiBusLock busLock;
   if (m_cacheBlockNumber != blockNumber) {
     if (!cacheWriteData()) {
       DBG_FAIL_MACRO;
@@ -151,6 +154,7 @@ cache_t* SdVolume::cacheFetchData(uint32_t blockNumber, uint8_t options) {
 }
 //------------------------------------------------------------------------------
 cache_t* SdVolume::cacheFetchFat(uint32_t blockNumber, uint8_t options) {
+  SdSpiBusLock busLock;
   if (m_cacheFatBlockNumber != blockNumber) {
     if (!cacheWriteFat()) {
       DBG_FAIL_MACRO;
@@ -177,6 +181,7 @@ bool SdVolume::cacheSync() {
 }
 //------------------------------------------------------------------------------
 bool SdVolume::cacheWriteData() {
+  SdSpiBusLock busLock;
   if (m_cacheStatus & CACHE_STATUS_DIRTY) {
     if (!m_sdCard->writeBlock(m_cacheBlockNumber, m_cacheBuffer.data)) {
       DBG_FAIL_MACRO;
@@ -191,6 +196,7 @@ bool SdVolume::cacheWriteData() {
 }
 //------------------------------------------------------------------------------
 bool SdVolume::cacheWriteFat() {
+  SdSpiBusLock busLock;
   if (m_cacheFatStatus & CACHE_STATUS_DIRTY) {
     if (!m_sdCard->writeBlock(m_cacheFatBlockNumber, m_cacheFatBuffer.data)) {
       DBG_FAIL_MACRO;
@@ -214,6 +220,8 @@ bool SdVolume::cacheWriteFat() {
 #else  // USE_SEPARATE_FAT_CACHE
 //------------------------------------------------------------------------------
 cache_t* SdVolume::cacheFetch(uint32_t blockNumber, uint8_t options) {
+  // no deferred handler may use the cache until the block number is set
+  SdSpiBusLock busLock;
   if (m_cacheBlockNumber != blockNumber) {
     if (!cacheSync()) {
       DBG_FAIL_MACRO;
@@ -240,6 +248,7 @@ cache_t* SdVolume::cacheFetchFat(uint32_t blockNumber, uint8_t options) {
 }
 //------------------------------------------------------------------------------
 bool SdVolume::cacheSync() {
+  SdSpiBusLock busLock;
   if (m_cacheStatus & CACHE_STATUS_DIRTY) {
     if (!m_sdCard->writeBlock(m_cacheBlockNumber, m_cacheBuffer.data)) {
       DBG_FAIL_MACRO;
@@ -278,6 +287,7 @@ uint32_t SdVolume::clusterStartBlock(uint32_t cluster) const {
 //------------------------------------------------------------------------------
 // Fetch a FAT entry
 bool SdVolume::fatGet(uint32_t cluster, uint32_t* value) {
+  SdSpiBusLock busLock;
   uint32_t lba;
   cache_t* pc;
   // error if reserved cluster of beyond FAT
@@ -335,6 +345,7 @@ bool SdVolume::fatGet(uint32_t cluster, uint32_t* value) {
 //------------------------------------------------------------------------------
 // Store a FAT entry
 bool SdVolume::fatPut(uint32_t cluster, uint32_t value) {
+  SdSpiBusLock busLock;
   uint32_t lba;
   cache_t* pc;
   // error if reserved cluster of beyond FAT
@@ -402,6 +413,7 @@ bool SdVolume::fatPut(uint32_t cluster, uint32_t value) {
 //------------------------------------------------------------------------------
 // free a cluster chain
 bool SdVolume::freeChain(uint32_t cluster) {
+  SdSpiBusLock busLock;
   uint32_t next;
 
   do {
@@ -429,6 +441,7 @@ bool SdVolume::freeChain(uint32_t cluster) {
  * \return Count of free clusters for success or -1 if an error occurs.
  */
 int32_t SdVolume::freeClusterCount() {
+  SdSpiBusLock busLock;
   uint32_t free = 0;
   uint32_t lba;
   uint32_t todo = m_clusterCount + 2;
@@ -490,6 +503,7 @@ int32_t SdVolume::freeClusterCount() {
  * FAT file system in the specified partition or an I/O error.
  */
 bool SdVolume::init(Sd2Card* dev, uint8_t part) {
+  SdSpiBusLock busLock;
   uint8_t tmp;
   uint32_t totalBlocks;
   uint32_t volumeStartBlock = 0;